@@ -0,0 +1,384 @@
+#include "synthetic_data.h"
+#include "core/exif_handler.h"
+#include "core/exiftool_writer.h"
+#include "core/fast_exif_probe.h"
+#include "core/gps_kernel.h"
+#include "core/gps_matcher.h"
+#include "core/gpx_parser.h"
+#include <QDir>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimeZone>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace lyp;
+using namespace lyp::bench;
+
+namespace {
+
+// Largest track size run by default; LYP_BENCH_MAX_POINTS raises it
+constexpr int kDefaultMaxPoints = 100000;
+
+// Photos per format used by the per-file metadata benchmarks
+constexpr int kPhotosPerFormat = 32;
+
+int maxPoints() {
+  bool ok = false;
+  const int value = qEnvironmentVariableIntValue("LYP_BENCH_MAX_POINTS", &ok);
+  return ok && value > 0 ? value : kDefaultMaxPoints;
+}
+
+/**
+ * @brief Data rows for every track size within the configured limit.
+ */
+void addTrackSizeRows() {
+  QTest::addColumn<int>("points");
+  for (int points : {1000, 10000, 100000, 1000000}) {
+    if (points <= maxPoints()) {
+      QTest::newRow(qPrintable(QString::number(points))) << points;
+    }
+  }
+}
+
+QString photoSetName(SyntheticPhotoFormat format, bool withGps) {
+  return QString("%1-%2")
+      .arg(format == SyntheticPhotoFormat::Tiff ? "tiff" : "jpeg")
+      .arg(withGps ? "gps" : "plain");
+}
+
+void addPhotoCountRows() {
+  QTest::addColumn<int>("photos");
+  for (int photos : {1000, 10000, 100000}) {
+    QTest::newRow(qPrintable(QString::number(photos))) << photos;
+  }
+}
+
+/**
+ * @brief Random endpoints around Zurich; every third photo has no elevation.
+ */
+InterpolationBatch makeInterpolationBatch(int photos) {
+  QRandomGenerator random(11);
+  InterpolationBatch batch;
+  batch.reserve(photos);
+  for (int i = 0; i < photos; ++i) {
+    const double lat = 47.0 + random.generateDouble();
+    const double lon = 8.0 + random.generateDouble();
+    const double ele = i % 3 == 0 ? std::numeric_limits<double>::quiet_NaN()
+                                  : 400.0 + 100.0 * random.generateDouble();
+    batch.append(random.generateDouble(), lat, lat + 1e-4, lon, lon + 1e-4,
+                 ele, ele + 1.0);
+  }
+  return batch;
+}
+
+void addFormatRows() {
+  QTest::addColumn<int>("format");
+  QTest::newRow("jpeg") << static_cast<int>(SyntheticPhotoFormat::Jpeg);
+  QTest::newRow("tiff") << static_cast<int>(SyntheticPhotoFormat::Tiff);
+}
+
+} // namespace
+
+/**
+ * @brief QTest benchmarks over the core hot paths, on synthetic data.
+ *
+ * Run e.g. `lyp_bench -median 5 parseGpx` or `lyp_bench -callgrind`; see
+ * the QTest documentation for the available measurement back ends.
+ */
+class CoreBenchmarks : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+
+  void parseGpx_data() { addTrackSizeRows(); }
+  void parseGpx();
+  void finalizeTrack_data() { addTrackSizeRows(); }
+  void finalizeTrack();
+  void findGpsForPhoto_data() { addTrackSizeRows(); }
+  void findGpsForPhoto();
+  void findGpsForPhotos_data() { addTrackSizeRows(); }
+  void findGpsForPhotos();
+  void interpolateScalar_data() { addPhotoCountRows(); }
+  void interpolateScalar();
+  void interpolateBatch_data() { addPhotoCountRows(); }
+  void interpolateBatch();
+
+  void probeTimestamp_data() { addFormatRows(); }
+  void probeTimestamp();
+  void exiv2ReadMetadata_data() { addFormatRows(); }
+  void exiv2ReadMetadata();
+  void exiv2WriteGps_data() { addFormatRows(); }
+  void exiv2WriteGps();
+  void patchGpsInPlace_data() { addFormatRows(); }
+  void patchGpsInPlace();
+  void writeSidecar();
+  void exifToolWriteGps();
+  void exifToolBatchWriteGps();
+
+private:
+  QString gpxPath(int points) const;
+  QStringList photos(int format, bool withGps) const;
+
+  QTemporaryDir m_dir;
+  TrackStorePtr m_photoTrack;
+};
+
+QString CoreBenchmarks::gpxPath(int points) const {
+  return m_dir.filePath(QString("track-%1.gpx").arg(points));
+}
+
+QStringList CoreBenchmarks::photos(int format, bool withGps) const {
+  QDir dir(m_dir.filePath(
+      photoSetName(static_cast<SyntheticPhotoFormat>(format), withGps)));
+  QStringList paths;
+  for (const QString &file : dir.entryList(QDir::Files, QDir::Name)) {
+    paths.append(dir.filePath(file));
+  }
+  return paths;
+}
+
+void CoreBenchmarks::initTestCase() {
+  QVERIFY(m_dir.isValid());
+  ExifHandler::initialize();
+
+  for (int points : {1000, 10000, 100000, 1000000}) {
+    if (points > maxPoints())
+      continue;
+    SyntheticTrackOptions options;
+    options.pointCount = points;
+    QVERIFY(writeGpx(gpxPath(points), *makeTrack(options)));
+  }
+
+  SyntheticTrackOptions trackOptions;
+  trackOptions.pointCount = 3600;
+  m_photoTrack = makeTrack(trackOptions);
+
+  for (auto format : {SyntheticPhotoFormat::Jpeg, SyntheticPhotoFormat::Tiff}) {
+    for (bool withGps : {false, true}) {
+      SyntheticPhotoOptions options;
+      options.photoCount = kPhotosPerFormat;
+      options.format = format;
+      options.gpsFraction = withGps ? 1.0 : 0.0;
+      const QString dir = m_dir.filePath(photoSetName(format, withGps));
+      QCOMPARE(int(writePhotoSet(dir, *m_photoTrack, options).size()),
+               kPhotosPerFormat);
+    }
+  }
+}
+
+void CoreBenchmarks::parseGpx() {
+  QFETCH(int, points);
+  const QString path = gpxPath(points);
+
+  TrackStorePtr track;
+  QBENCHMARK { track = GpxParser::parse(path).value(); }
+  QCOMPARE(track->size(), points);
+}
+
+void CoreBenchmarks::finalizeTrack() {
+  QFETCH(int, points);
+  SyntheticTrackOptions options;
+  options.pointCount = points;
+  const TrackStorePtr track = makeTrack(options);
+
+  // Segments and statistics are computed here once per loaded track
+  TrackStats stats;
+  QBENCHMARK {
+    TrackStore copy(*track);
+    copy.finalize();
+    stats = copy.stats();
+  }
+  QCOMPARE(stats.segmentCount, 1);
+  QCOMPARE(qRound(GpxParser::calculateAverageInterval(*track)), 1);
+}
+
+void CoreBenchmarks::findGpsForPhoto() {
+  QFETCH(int, points);
+  SyntheticTrackOptions options;
+  options.pointCount = points;
+  const TrackStorePtr track = makeTrack(options);
+  const GpsMatcher matcher(track, 300.0);
+
+  // Random, unsorted lookups over the whole track
+  QRandomGenerator random(7);
+  const qint64 first = track->timeMs(0);
+  const qint64 span = track->timeMs(track->size() - 1) - first;
+  QVector<QDateTime> times;
+  for (int i = 0; i < 10000; ++i) {
+    times.append(QDateTime::fromMSecsSinceEpoch(
+        first + qint64(random.generateDouble() * span), QTimeZone::utc()));
+  }
+
+  int matched = 0;
+  QBENCHMARK {
+    matched = 0;
+    for (const QDateTime &time : times) {
+      matched += matcher.findGpsForPhoto(time).has_value() ? 1 : 0;
+    }
+  }
+  QCOMPARE(matched, int(times.size()));
+}
+
+void CoreBenchmarks::findGpsForPhotos() {
+  QFETCH(int, points);
+  SyntheticTrackOptions options;
+  options.pointCount = points;
+  const TrackStorePtr track = makeTrack(options);
+  const GpsMatcher matcher(track, 300.0);
+
+  QRandomGenerator random(7);
+  const qint64 first = track->timeMs(0);
+  const qint64 span = track->timeMs(track->size() - 1) - first;
+  QVector<qint64> times;
+  for (int i = 0; i < 10000; ++i) {
+    times.append(first + qint64(random.generateDouble() * span));
+  }
+  std::sort(times.begin(), times.end());
+
+  QVector<std::optional<GpsMatch>> matches;
+  QBENCHMARK { matches = matcher.findGpsForPhotos(times); }
+  QCOMPARE(matches.size(), times.size());
+}
+
+void CoreBenchmarks::interpolateScalar() {
+  QFETCH(int, photos);
+  const InterpolationBatch batch = makeInterpolationBatch(photos);
+
+  // One photo at a time, as the single-photo match path does
+  QVector<GpsMatch> positions(photos);
+  QBENCHMARK {
+    for (int i = 0; i < photos; ++i) {
+      const double t = batch.ratio[i];
+      std::optional<double> elevation;
+      if (!std::isnan(batch.elevationBefore[i])) {
+        elevation = GpsKernel::lerp(batch.elevationBefore[i],
+                                    batch.elevationAfter[i], t);
+      }
+      positions[i] = {GpsKernel::lerp(batch.latitudeBefore[i],
+                                      batch.latitudeAfter[i], t),
+                      GpsKernel::lerp(batch.longitudeBefore[i],
+                                      batch.longitudeAfter[i], t),
+                      elevation};
+    }
+  }
+  QCOMPARE(int(positions.size()), photos);
+}
+
+void CoreBenchmarks::interpolateBatch() {
+  QFETCH(int, photos);
+  const InterpolationBatch batch = makeInterpolationBatch(photos);
+
+  // Whole arrays at once, as findGpsForPhotos() does
+  GpsPositionBatch positions;
+  QBENCHMARK { GpsKernel::interpolate(batch, positions); }
+  QCOMPARE(positions.size(), photos);
+}
+
+void CoreBenchmarks::probeTimestamp() {
+  QFETCH(int, format);
+  const QStringList paths = photos(format, false);
+
+  int found = 0;
+  QBENCHMARK {
+    found = 0;
+    for (const QString &path : paths) {
+      found += FastExifProbe::probe(path).has_value() ? 1 : 0;
+    }
+  }
+  QCOMPARE(found, int(paths.size()));
+}
+
+void CoreBenchmarks::exiv2ReadMetadata() {
+  QFETCH(int, format);
+  const QStringList paths = photos(format, false);
+
+  int found = 0;
+  QBENCHMARK {
+    found = 0;
+    for (const QString &path : paths) {
+      MetadataSession session(path);
+      found += session.timestamp().has_value() ? 1 : 0;
+    }
+  }
+  QCOMPARE(found, int(paths.size()));
+}
+
+void CoreBenchmarks::exiv2WriteGps() {
+  QFETCH(int, format);
+  const QStringList paths = photos(format, false);
+
+  // Rewriting the same files measures steady-state updates
+  QBENCHMARK {
+    for (const QString &path : paths) {
+      MetadataSession session(path);
+      QVERIFY2(session.writeGpsData(47.5, 8.5, 410.0),
+               qPrintable(session.lastError()));
+    }
+  }
+}
+
+void CoreBenchmarks::patchGpsInPlace() {
+  QFETCH(int, format);
+  const QStringList paths = photos(format, true);
+
+  QBENCHMARK {
+    for (const QString &path : paths) {
+      QVERIFY(ExifHandler::patchGpsInPlace(path, 47.5, 8.5, 410.0));
+    }
+  }
+}
+
+void CoreBenchmarks::writeSidecar() {
+  const QStringList paths =
+      photos(static_cast<int>(SyntheticPhotoFormat::Jpeg), false);
+
+  QBENCHMARK {
+    for (const QString &path : paths) {
+      const Status written =
+          ExifHandler::writeGpsSidecar(path, 47.5, 8.5, 410.0);
+      QVERIFY2(written.ok(), qPrintable(written.error()));
+    }
+  }
+}
+
+void CoreBenchmarks::exifToolWriteGps() {
+  if (!ExifToolWriter::isAvailable()) {
+    QSKIP("exiftool not found");
+  }
+  const QStringList paths =
+      photos(static_cast<int>(SyntheticPhotoFormat::Jpeg), false);
+
+  QBENCHMARK {
+    for (const QString &path : paths) {
+      const Status written =
+          ExifToolWriter::writeGpsData(path, 47.5, 8.5, 410.0);
+      QVERIFY2(written.ok(), qPrintable(written.error()));
+    }
+  }
+}
+
+void CoreBenchmarks::exifToolBatchWriteGps() {
+  if (!ExifToolWriter::isAvailable()) {
+    QSKIP("exiftool not found");
+  }
+  const QStringList paths =
+      photos(static_cast<int>(SyntheticPhotoFormat::Jpeg), false);
+  QVector<GpsWriteRequest> requests;
+  for (const QString &path : paths) {
+    requests.append({path, 47.5, 8.5, 410.0});
+  }
+
+  QBENCHMARK {
+    for (const GpsWriteResult &result :
+         ExifToolWriter::writeGpsDataBatch(requests)) {
+      QVERIFY2(result.ok(), qPrintable(result.error()));
+    }
+  }
+}
+
+QTEST_GUILESS_MAIN(CoreBenchmarks)
+#include "bench_core.moc"
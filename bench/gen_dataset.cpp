@@ -0,0 +1,98 @@
+#include "synthetic_data.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QTextStream>
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    app.setApplicationName("lyp-gen-dataset");
+    app.setApplicationVersion("1.0.0");
+    app.setOrganizationName("LocateYourPhoto");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Write a synthetic GPX track and matching photos for benchmarking.\n"
+        "Output is deterministic for a given seed.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("output", "Directory to write track.gpx and photos/ into.");
+
+    QCommandLineOption pointsOption({"p", "points"},
+        "Trackpoints in the GPX track.", "count", "100000");
+    QCommandLineOption intervalOption({"i", "interval"},
+        "Seconds between trackpoints.", "seconds", "1");
+    QCommandLineOption photosOption({"n", "photos"},
+        "Photos to write, spread evenly over the track.", "count", "500");
+    QCommandLineOption formatOption({"f", "format"},
+        "Photo format: jpg or tif.", "format", "jpg");
+    QCommandLineOption offsetOption({"t", "time-offset"},
+        "Camera clock offset from UTC in hours.", "hours", "0");
+    QCommandLineOption gpsOption("gps-fraction",
+        "Share of photos that already have GPS (0-1).", "fraction", "0");
+    QCommandLineOption seedOption("seed",
+        "Random seed for the track shape.", "seed", "1");
+    parser.addOptions({pointsOption, intervalOption, photosOption, formatOption,
+                       offsetOption, gpsOption, seedOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) {
+        err << "Expected exactly one output directory\n";
+        return 1;
+    }
+    const QDir outputDir(positional.first());
+
+    bool ok = true;
+    lyp::bench::SyntheticTrackOptions trackOptions;
+    lyp::bench::SyntheticPhotoOptions photoOptions;
+    trackOptions.pointCount = parser.value(pointsOption).toInt(&ok);
+    if (ok) trackOptions.intervalMs = qRound64(parser.value(intervalOption).toDouble(&ok) * 1000.0);
+    if (ok) trackOptions.seed = parser.value(seedOption).toUInt(&ok);
+    if (ok) photoOptions.photoCount = parser.value(photosOption).toInt(&ok);
+    if (ok) photoOptions.timeOffsetHours = parser.value(offsetOption).toDouble(&ok);
+    if (ok) photoOptions.gpsFraction = parser.value(gpsOption).toDouble(&ok);
+    if (!ok || trackOptions.pointCount < 1 || trackOptions.intervalMs < 1 ||
+        photoOptions.photoCount < 0 || photoOptions.gpsFraction < 0.0 ||
+        photoOptions.gpsFraction > 1.0) {
+        err << "Invalid numeric option\n";
+        return 1;
+    }
+
+    const QString format = parser.value(formatOption).toLower();
+    if (format == "jpg" || format == "jpeg") {
+        photoOptions.format = lyp::bench::SyntheticPhotoFormat::Jpeg;
+    } else if (format == "tif" || format == "tiff") {
+        photoOptions.format = lyp::bench::SyntheticPhotoFormat::Tiff;
+    } else {
+        err << "Unknown format: " << format << "\n";
+        return 1;
+    }
+
+    if (!QDir().mkpath(outputDir.path())) {
+        err << "Cannot create " << outputDir.path() << "\n";
+        return 1;
+    }
+
+    const lyp::TrackStorePtr track = lyp::bench::makeTrack(trackOptions);
+    const QString gpxPath = outputDir.filePath("track.gpx");
+    if (!lyp::bench::writeGpx(gpxPath, *track)) {
+        err << "Failed to write " << gpxPath << "\n";
+        return 1;
+    }
+    out << "Wrote " << track->size() << " trackpoints to " << gpxPath << "\n";
+
+    const QString photoDir = outputDir.filePath("photos");
+    const QStringList photos = lyp::bench::writePhotoSet(photoDir, *track, photoOptions);
+    if (photos.size() != photoOptions.photoCount) {
+        err << "Failed to write photos to " << photoDir << "\n";
+        return 1;
+    }
+    out << "Wrote " << photos.size() << " photo(s) to " << photoDir << "\n";
+    return 0;
+}
@@ -0,0 +1,390 @@
+#include "synthetic_data.h"
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTimeZone>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace lyp::bench {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kMetresPerDegree = 111320.0;
+constexpr double kWalkingSpeed = 1.4; // m/s
+
+// TIFF field types
+constexpr quint16 kByte = 1;
+constexpr quint16 kAscii = 2;
+constexpr quint16 kShort = 3;
+constexpr quint16 kLong = 4;
+constexpr quint16 kRational = 5;
+
+struct TiffEntry {
+  quint16 tag;
+  quint16 type;
+  quint32 count;
+  QByteArray value; // Little-endian value bytes
+};
+
+using TiffIfd = std::vector<TiffEntry>;
+
+void appendU16(QByteArray &out, quint16 value) {
+  uchar bytes[2];
+  qToLittleEndian(value, bytes);
+  out.append(reinterpret_cast<const char *>(bytes), 2);
+}
+
+void appendU32(QByteArray &out, quint32 value) {
+  uchar bytes[4];
+  qToLittleEndian(value, bytes);
+  out.append(reinterpret_cast<const char *>(bytes), 4);
+}
+
+TiffEntry shortEntry(quint16 tag, quint16 value) {
+  QByteArray bytes;
+  appendU16(bytes, value);
+  return {tag, kShort, 1, bytes};
+}
+
+TiffEntry longEntry(quint16 tag, quint32 value) {
+  QByteArray bytes;
+  appendU32(bytes, value);
+  return {tag, kLong, 1, bytes};
+}
+
+TiffEntry asciiEntry(quint16 tag, const QByteArray &text) {
+  QByteArray bytes = text;
+  bytes.append('\0');
+  return {tag, kAscii, static_cast<quint32>(bytes.size()), bytes};
+}
+
+TiffEntry rationalEntry(quint16 tag,
+                        const std::vector<std::pair<quint32, quint32>> &values) {
+  QByteArray bytes;
+  for (const auto &[numerator, denominator] : values) {
+    appendU32(bytes, numerator);
+    appendU32(bytes, denominator);
+  }
+  return {tag, kRational, static_cast<quint32>(values.size()), bytes};
+}
+
+std::vector<std::pair<quint32, quint32>> toDms(double degrees) {
+  degrees = std::abs(degrees);
+  const auto whole = static_cast<quint32>(degrees);
+  const double minutes = (degrees - whole) * 60.0;
+  const auto wholeMinutes = static_cast<quint32>(minutes);
+  const auto seconds = static_cast<quint32>(
+      std::lround((minutes - wholeMinutes) * 60.0 * 10000.0));
+  return {{whole, 1}, {wholeMinutes, 1}, {seconds, 10000}};
+}
+
+void setLong(TiffIfd &ifd, quint16 tag, quint32 value) {
+  for (TiffEntry &entry : ifd) {
+    if (entry.tag == tag) {
+      entry.value.clear();
+      appendU32(entry.value, value);
+    }
+  }
+}
+
+quint32 ifdSize(const TiffIfd &ifd) {
+  return 2 + 12 * static_cast<quint32>(ifd.size()) + 4;
+}
+
+quint32 externalSize(const TiffIfd &ifd) {
+  quint32 size = 0;
+  for (const TiffEntry &entry : ifd) {
+    if (entry.value.size() > 4) {
+      size += static_cast<quint32>((entry.value.size() + 1) & ~1); // Word aligned
+    }
+  }
+  return size;
+}
+
+/**
+ * @brief Serialize IFDs laid out back to back, followed by their values.
+ */
+void appendIfds(QByteArray &out, std::vector<TiffIfd> &ifds,
+                quint32 firstOffset) {
+  quint32 dataOffset = firstOffset;
+  for (const TiffIfd &ifd : ifds) {
+    dataOffset += ifdSize(ifd);
+  }
+
+  QByteArray data;
+  for (TiffIfd &ifd : ifds) {
+    std::sort(ifd.begin(), ifd.end(),
+              [](const TiffEntry &a, const TiffEntry &b) {
+                return a.tag < b.tag;
+              });
+    appendU16(out, static_cast<quint16>(ifd.size()));
+    for (const TiffEntry &entry : ifd) {
+      appendU16(out, entry.tag);
+      appendU16(out, entry.type);
+      appendU32(out, entry.count);
+      if (entry.value.size() <= 4) {
+        QByteArray inlineValue = entry.value;
+        inlineValue.append(4 - inlineValue.size(), '\0');
+        out.append(inlineValue);
+      } else {
+        appendU32(out, dataOffset + static_cast<quint32>(data.size()));
+        data.append(entry.value);
+        if (data.size() & 1) {
+          data.append('\0');
+        }
+      }
+    }
+    appendU32(out, 0); // No next IFD
+  }
+  out.append(data);
+}
+
+/**
+ * @brief Build a little-endian TIFF structure with IFD0, Exif and GPS IFDs.
+ * @param withImage Add a 1x1 greyscale strip (for bare TIFF files)
+ */
+QByteArray buildTiff(const QDateTime &cameraTime,
+                     const std::optional<GpsCoord> &gps, bool withImage) {
+  const QByteArray dateTime =
+      cameraTime.toString("yyyy:MM:dd HH:mm:ss").toLatin1();
+
+  TiffIfd ifd0;
+  if (withImage) {
+    ifd0.push_back(longEntry(0x0100, 1));   // ImageWidth
+    ifd0.push_back(longEntry(0x0101, 1));   // ImageLength
+    ifd0.push_back(shortEntry(0x0102, 8));  // BitsPerSample
+    ifd0.push_back(shortEntry(0x0103, 1));  // Compression: none
+    ifd0.push_back(shortEntry(0x0106, 1));  // PhotometricInterpretation
+    ifd0.push_back(longEntry(0x0111, 0));   // StripOffsets, set below
+    ifd0.push_back(shortEntry(0x0115, 1));  // SamplesPerPixel
+    ifd0.push_back(longEntry(0x0116, 1));   // RowsPerStrip
+    ifd0.push_back(longEntry(0x0117, 1));   // StripByteCounts
+  }
+  ifd0.push_back(asciiEntry(0x0132, dateTime));
+  ifd0.push_back(longEntry(0x8769, 0)); // Exif IFD, set below
+  if (gps) {
+    ifd0.push_back(longEntry(0x8825, 0)); // GPS IFD, set below
+  }
+
+  TiffIfd exif;
+  exif.push_back(asciiEntry(0x9003, dateTime)); // DateTimeOriginal
+  exif.push_back(asciiEntry(0x9004, dateTime)); // DateTimeDigitized
+
+  std::vector<TiffIfd> ifds;
+  const quint32 exifOffset = 8 + ifdSize(ifd0);
+  setLong(ifd0, 0x8769, exifOffset);
+  if (gps) {
+    TiffIfd gpsIfd;
+    gpsIfd.push_back({0x0000, kByte, 4, QByteArray("\x02\x03\x00\x00", 4)});
+    gpsIfd.push_back(asciiEntry(0x0001, gps->latitude < 0 ? "S" : "N"));
+    gpsIfd.push_back(rationalEntry(0x0002, toDms(gps->latitude)));
+    gpsIfd.push_back(asciiEntry(0x0003, gps->longitude < 0 ? "W" : "E"));
+    gpsIfd.push_back(rationalEntry(0x0004, toDms(gps->longitude)));
+    if (gps->elevation) {
+      const double metres = *gps->elevation;
+      gpsIfd.push_back(
+          {0x0005, kByte, 1, QByteArray(1, metres < 0 ? '\x01' : '\x00')});
+      gpsIfd.push_back(rationalEntry(
+          0x0006,
+          {{static_cast<quint32>(std::lround(std::abs(metres) * 100.0)), 100}}));
+    }
+    setLong(ifd0, 0x8825, exifOffset + ifdSize(exif));
+    ifds = {ifd0, exif, gpsIfd};
+  } else {
+    ifds = {ifd0, exif};
+  }
+
+  // The single pixel goes after every IFD and value
+  quint32 pixelOffset = 8;
+  for (const TiffIfd &ifd : ifds) {
+    pixelOffset += ifdSize(ifd) + externalSize(ifd);
+  }
+  if (withImage) {
+    setLong(ifds[0], 0x0111, pixelOffset);
+  }
+
+  QByteArray out("II\x2a\x00", 4);
+  appendU32(out, 8);
+  appendIfds(out, ifds, 8);
+  if (withImage) {
+    out.append('\x80');
+  }
+  return out;
+}
+
+void appendSegment(QByteArray &out, uchar marker, const QByteArray &payload) {
+  out.append('\xff');
+  out.append(static_cast<char>(marker));
+  uchar length[2];
+  qToBigEndian(static_cast<quint16>(payload.size() + 2), length);
+  out.append(reinterpret_cast<const char *>(length), 2);
+  out.append(payload);
+}
+
+/**
+ * @brief Wrap a TIFF structure in a JPEG skeleton.
+ *
+ * Metadata readers stop at the scan, so the entropy-coded data is a stub
+ * and the file is tiny; it is not meant to be decoded.
+ */
+QByteArray buildJpeg(const QByteArray &tiff) {
+  QByteArray out("\xff\xd8", 2);
+  appendSegment(out, 0xe1, QByteArray("Exif\0\0", 6) + tiff);
+  appendSegment(out, 0xdb, QByteArray(1, '\0') + QByteArray(64, '\x01'));
+  appendSegment(out, 0xc0, QByteArray("\x08\x00\x01\x00\x01\x01\x01\x11\x00", 9));
+  appendSegment(out, 0xda, QByteArray("\x01\x01\x00\x00\x3f\x00", 6));
+  out.append(QByteArray("\x00\x00\xff\xd9", 4));
+  return out;
+}
+
+} // namespace
+
+TrackStorePtr makeTrack(const SyntheticTrackOptions &options) {
+  auto track = std::make_shared<TrackStore>();
+  track->reserve(options.pointCount);
+
+  QRandomGenerator random(options.seed);
+  double latitude = options.originLatitude;
+  double longitude = options.originLongitude;
+  double heading = random.bounded(2.0 * kPi);
+  double elevation = 400.0;
+  const double stepMetres = kWalkingSpeed * options.intervalMs / 1000.0;
+
+  for (int i = 0; i < options.pointCount; ++i) {
+    track->append(options.startTimeMs + i * options.intervalMs, latitude,
+                  longitude,
+                  options.withElevation ? std::optional<double>(elevation)
+                                        : std::nullopt);
+
+    // Wander: small heading changes, occasional turns, gentle climbs
+    heading += (random.generateDouble() - 0.5) * 0.35;
+    if (random.bounded(200) == 0) {
+      heading += kPi / 2.0;
+    }
+    latitude += stepMetres * std::cos(heading) / kMetresPerDegree;
+    longitude += stepMetres * std::sin(heading) /
+                 (kMetresPerDegree * std::cos(latitude * kPi / 180.0));
+    latitude = std::clamp(latitude, -89.0, 89.0);
+    if (longitude > 180.0) {
+      longitude -= 360.0;
+    } else if (longitude < -180.0) {
+      longitude += 360.0;
+    }
+    elevation += (random.generateDouble() - 0.5) * 0.8;
+  }
+  track->finalize();
+  return track;
+}
+
+bool writeGpx(const QString &filePath, const TrackStore &track) {
+  QFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+
+  QByteArray out;
+  out.reserve(track.size() * 110 + 256);
+  out.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             "<gpx version=\"1.1\" creator=\"lyp-gen-dataset\" "
+             "xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+             "<trk><name>Synthetic</name><trkseg>\n");
+
+  for (int i = 0; i < track.size(); ++i) {
+    const qint64 timeMs = track.timeMs(i);
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(timeMs, QTimeZone::utc());
+    out.append("<trkpt lat=\"");
+    out.append(QByteArray::number(track.latitude(i), 'f', 7));
+    out.append("\" lon=\"");
+    out.append(QByteArray::number(track.longitude(i), 'f', 7));
+    out.append("\">");
+    if (auto elevation = track.elevation(i)) {
+      out.append("<ele>");
+      out.append(QByteArray::number(*elevation, 'f', 1));
+      out.append("</ele>");
+    }
+    out.append("<time>");
+    out.append(time.toString(timeMs % 1000 ? Qt::ISODateWithMs : Qt::ISODate)
+                   .toLatin1());
+    out.append("</time></trkpt>\n");
+
+    // Keep memory bounded for million-point tracks
+    if (out.size() > (8 << 20)) {
+      if (file.write(out) != out.size()) {
+        return false;
+      }
+      out.clear();
+    }
+  }
+
+  out.append("</trkseg></trk>\n</gpx>\n");
+  return file.write(out) == out.size();
+}
+
+bool writePhoto(const QString &filePath, SyntheticPhotoFormat format,
+                const QDateTime &cameraTime,
+                const std::optional<GpsCoord> &gps) {
+  const bool isTiff = format == SyntheticPhotoFormat::Tiff;
+  const QByteArray tiff = buildTiff(cameraTime, gps, isTiff);
+  const QByteArray bytes = isTiff ? tiff : buildJpeg(tiff);
+
+  QFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+  return file.write(bytes) == bytes.size();
+}
+
+QStringList writePhotoSet(const QString &directory, const TrackStore &track,
+                          const SyntheticPhotoOptions &options) {
+  QStringList paths;
+  if (track.isEmpty() || options.photoCount <= 0 ||
+      !QDir().mkpath(directory)) {
+    return paths;
+  }
+
+  const QString suffix =
+      options.format == SyntheticPhotoFormat::Tiff ? "tif" : "jpg";
+  const qint64 firstMs = track.timeMs(0);
+  const qint64 spanMs = track.timeMs(track.size() - 1) - firstMs;
+  const qint64 offsetMs =
+      static_cast<qint64>(options.timeOffsetHours * 3600.0) * 1000;
+  const int withGps =
+      static_cast<int>(std::lround(options.photoCount * options.gpsFraction));
+
+  for (int i = 0; i < options.photoCount; ++i) {
+    const qint64 utcMs =
+        firstMs + (options.photoCount > 1
+                       ? spanMs * i / (options.photoCount - 1)
+                       : 0);
+    // EXIF holds the camera's wall clock without a zone
+    const QDateTime cameraTime = QDateTime::fromMSecsSinceEpoch(
+        (utcMs + offsetMs) / 1000 * 1000, QTimeZone::utc());
+
+    std::optional<GpsCoord> gps;
+    if (i < withGps) {
+      const auto index = static_cast<int>(
+          std::upper_bound(track.timesMs().begin(), track.timesMs().end(),
+                           utcMs) -
+          track.timesMs().begin() - 1);
+      const int point = std::clamp(index, 0, track.size() - 1);
+      gps = GpsCoord{track.latitude(point), track.longitude(point),
+                     track.elevation(point)};
+    }
+
+    const QString path =
+        QDir(directory).filePath(QString("IMG_%1.%2")
+                                     .arg(i + 1, 5, 10, QChar('0'))
+                                     .arg(suffix));
+    if (!writePhoto(path, options.format, cameraTime, gps)) {
+      break;
+    }
+    paths.append(path);
+  }
+  return paths;
+}
+
+} // namespace lyp::bench
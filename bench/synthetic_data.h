@@ -0,0 +1,86 @@
+#pragma once
+
+#include "core/exif_handler.h"
+#include "models/track_store.h"
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <optional>
+
+namespace lyp::bench {
+
+/**
+ * @brief Shape of a generated GPS track.
+ *
+ * Points follow a seeded random walk, so the same options always produce
+ * the same track and benchmark runs are comparable across machines.
+ */
+struct SyntheticTrackOptions {
+  int pointCount = 10000;
+  qint64 startTimeMs = 1735689600000; // 2025-01-01T00:00:00Z
+  qint64 intervalMs = 1000;
+  double originLatitude = 47.3769;    // Zurich
+  double originLongitude = 8.5417;
+  bool withElevation = true;
+  quint32 seed = 1;
+};
+
+/**
+ * @brief Output format of generated photos.
+ */
+enum class SyntheticPhotoFormat {
+  Jpeg, // SOI, Exif APP1, stub frame and scan; pixels are not decodable
+  Tiff  // Baseline 1x1 greyscale TIFF with the same IFDs
+};
+
+/**
+ * @brief Shape of a generated photo set.
+ */
+struct SyntheticPhotoOptions {
+  int photoCount = 100;
+  SyntheticPhotoFormat format = SyntheticPhotoFormat::Jpeg;
+  double timeOffsetHours = 0.0; // Camera clock ahead of UTC
+  double gpsFraction = 0.0;     // Share of photos that already carry GPS
+};
+
+/**
+ * @brief Build a track in memory.
+ * @param options Track shape
+ * @return Track sorted by time
+ */
+TrackStorePtr makeTrack(const SyntheticTrackOptions &options);
+
+/**
+ * @brief Write a track as a GPX 1.1 file with one <trkseg>.
+ * @param filePath Destination path
+ * @param track Track to write
+ * @return true on success
+ */
+bool writeGpx(const QString &filePath, const TrackStore &track);
+
+/**
+ * @brief Write a minimal photo whose EXIF holds a capture time.
+ *
+ * The IFD layout matches what exiv2 writes, so FastExifProbe, exiv2,
+ * exiftool and the in-place GPS patch all accept the files.
+ * @param filePath Destination path
+ * @param format Container format
+ * @param cameraTime Capture time as shown by the camera clock
+ * @param gps GPS position to embed, if any
+ * @return true on success
+ */
+bool writePhoto(const QString &filePath, SyntheticPhotoFormat format,
+                const QDateTime &cameraTime,
+                const std::optional<GpsCoord> &gps = std::nullopt);
+
+/**
+ * @brief Write photos whose capture times are spread evenly over a track.
+ * @param directory Destination directory (created if missing)
+ * @param track Track the photos were "taken" along
+ * @param options Photo set shape
+ * @return Paths of the written files, in capture order
+ */
+QStringList writePhotoSet(const QString &directory, const TrackStore &track,
+                          const SyntheticPhotoOptions &options);
+
+} // namespace lyp::bench
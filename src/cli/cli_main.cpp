@@ -0,0 +1,291 @@
+#include "core/batch_journal.h"
+#include "core/folder_watcher.h"
+#include "core/mapped_file.h"
+#include "core/perf_trace.h"
+#include "core/photo_processor.h"
+#include "core/watch_daemon.h"
+#include "models/photo_list_model.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief Expand a GPX argument; wildcards are matched within its directory.
+ */
+QStringList expandGpxPattern(const QString& pattern)
+{
+    if (!pattern.contains('*') && !pattern.contains('?') && !pattern.contains('[')) {
+        return {pattern};
+    }
+
+    const QFileInfo info(pattern);
+    QDir dir(info.path());
+    QStringList paths;
+    for (const QString& name : dir.entryList({info.fileName()}, QDir::Files, QDir::Name)) {
+        paths.append(dir.filePath(name));
+    }
+    return paths;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    app.setApplicationName("lyp-cli");
+    app.setApplicationVersion("1.0.0");
+    app.setOrganizationName("LocateYourPhoto");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Geotag photos from GPX tracks without the GUI.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("paths", "Photo files or directories to process.", "<paths...>");
+
+    QCommandLineOption gpxOption({"g", "gpx"},
+        "GPX file or glob pattern (repeatable).", "pattern");
+    QCommandLineOption offsetOption({"t", "time-offset"},
+        "Camera timezone offset from UTC in hours.", "hours", "0");
+    QCommandLineOption maxDiffOption({"m", "max-time-diff"},
+        "Maximum time difference in seconds (0 = adaptive).", "seconds", "300");
+    QCommandLineOption overwriteOption("overwrite",
+        "Overwrite photos that already have GPS data.");
+    QCommandLineOption interpolateOption("force-interpolate",
+        "Always interpolate regardless of time difference.");
+    QCommandLineOption dryRunOption({"n", "dry-run"},
+        "Match photos but do not write any files.");
+    QCommandLineOption sidecarOption("sidecar",
+        "Write GPS to an .xmp sidecar next to each photo instead of the photo.");
+    QCommandLineOption jobsOption({"j", "jobs"},
+        "Reader and writer threads each (0 = one per CPU core); raise on network shares.",
+        "count", "0");
+    QCommandLineOption inFlightOption("in-flight",
+        "Maximum files between read and write (0 = 4 per reader).", "count", "0");
+    QCommandLineOption journalOption("journal",
+        "Resume journal and audit log (default: in the app data directory).", "file");
+    QCommandLineOption noJournalOption("no-journal",
+        "Neither skip photos done by an earlier run nor log this one.");
+    QCommandLineOption noMmapOption("no-mmap",
+        "Read photos with buffered I/O even on local disks.");
+    QCommandLineOption verboseOption({"v", "verbose"},
+        "Log every file as it is processed.");
+    QCommandLineOption statsOption("stats",
+        "Print per-stage timings and throughput after processing.");
+    QCommandLineOption traceOption("trace",
+        "Write a Chrome trace (chrome://tracing, Perfetto) of the run to <file>.", "file");
+    QCommandLineOption watchOption("watch",
+        "Keep running and geotag photos as they arrive in the given directories.");
+    QCommandLineOption settleOption("settle",
+        "With --watch: time a new file must stay unchanged before it is read.",
+        "ms", QString::number(lyp::FolderWatcher::kDefaultSettleMs));
+    QCommandLineOption newOnlyOption("new-only",
+        "With --watch: leave photos already in the directories alone.");
+    parser.addOptions({gpxOption, offsetOption, maxDiffOption, overwriteOption,
+                       interpolateOption, dryRunOption, sidecarOption, jobsOption,
+                       inFlightOption, journalOption, noJournalOption, noMmapOption,
+                       verboseOption, statsOption, traceOption, watchOption,
+                       settleOption, newOnlyOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("default.info=false\ndefault.debug=false");
+    }
+
+    QStringList gpxFiles;
+    for (const QString& pattern : parser.values(gpxOption)) {
+        gpxFiles.append(expandGpxPattern(pattern));
+    }
+    if (gpxFiles.isEmpty()) {
+        err << "No GPX files given; use --gpx <pattern>\n";
+        return 1;
+    }
+
+    // Files are scanned directly; directories are walked recursively
+    QStringList photoPaths;
+    QStringList photoDirs;
+    for (const QString& input : parser.positionalArguments()) {
+        const QFileInfo info(input);
+        if (!info.exists()) {
+            err << "No such file or directory: " << input << "\n";
+            return 1;
+        }
+        if (info.isDir()) {
+            photoDirs.append(info.absoluteFilePath());
+        } else {
+            photoPaths.append(info.absoluteFilePath());
+        }
+    }
+    if (photoPaths.isEmpty() && photoDirs.isEmpty()) {
+        err << "No photo files or directories given\n";
+        return 1;
+    }
+    const bool watch = parser.isSet(watchOption);
+    if (watch && !photoPaths.isEmpty()) {
+        err << "--watch takes directories only\n";
+        return 1;
+    }
+
+    bool ok = true;
+    lyp::ProcessingSettings settings;
+    settings.timeOffsetHours = parser.value(offsetOption).toDouble(&ok);
+    if (ok) settings.maxTimeDiffSeconds = parser.value(maxDiffOption).toDouble(&ok);
+    if (ok) settings.workerCount = parser.value(jobsOption).toInt(&ok);
+    if (ok) settings.maxFilesInFlight = parser.value(inFlightOption).toInt(&ok);
+    int settleMs = 0;
+    if (ok) settleMs = parser.value(settleOption).toInt(&ok);
+    if (!ok || settings.workerCount < 0 || settings.maxFilesInFlight < 0 || settleMs < 0) {
+        err << "Invalid numeric option\n";
+        return 1;
+    }
+    settings.overwriteExistingGps = parser.isSet(overwriteOption);
+    settings.forceInterpolate = parser.isSet(interpolateOption);
+    settings.dryRun = parser.isSet(dryRunOption);
+    settings.outputMode = parser.isSet(sidecarOption) ? lyp::OutputMode::XmpSidecar
+                                                      : lyp::OutputMode::EmbedInFile;
+    settings.traceFilePath = parser.value(traceOption);
+    if (!parser.isSet(noJournalOption)) {
+        settings.journalFilePath = parser.isSet(journalOption)
+                                       ? parser.value(journalOption)
+                                       : lyp::BatchJournal::defaultFilePath();
+    }
+    lyp::MappedFile::setEnabled(!parser.isSet(noMmapOption));
+
+    const bool printStats = parser.isSet(statsOption);
+    lyp::PerfTrace::enableFromEnvironment();
+    if (printStats || !settings.traceFilePath.isEmpty()) {
+        lyp::PerfTrace::setEnabled(true);
+    }
+
+    lyp::PhotoProcessor processor;
+    lyp::PhotoListModel model;
+
+    QElapsedTimer phaseTimer;
+    phaseTimer.start();
+
+    QObject::connect(&processor, &lyp::PhotoProcessor::gpxLoadError,
+                     [&err](const QString& error) {
+        err << "Failed to load GPX: " << error << "\n";
+    });
+    if (!processor.loadGpxFiles(gpxFiles)) {
+        return 1;
+    }
+    out << "Loaded " << processor.track()->size() << " trackpoints from "
+        << gpxFiles.size() << " GPX file(s) in " << phaseTimer.elapsed() << " ms\n";
+    out.flush();
+
+    if (watch) {
+        // One line per photo as batches finish; runs until interrupted
+        lyp::WatchDaemon daemon(&processor, settings);
+        daemon.watcher()->setSettleTime(settleMs);
+        QObject::connect(&daemon, &lyp::WatchDaemon::photoFinished,
+                         [&](const lyp::PhotoItem& photo, bool waiting) {
+            if (photo.state == lyp::PhotoState::Success) {
+                out << photo.filePath << ": "
+                    << QString::number(photo.matchedLat.value_or(0.0), 'f', 6) << ", "
+                    << QString::number(photo.matchedLon.value_or(0.0), 'f', 6)
+                    << (settings.dryRun ? " (dry run)" : "") << "\n";
+                out.flush();
+            } else if (waiting) {
+                out << photo.filePath << ": after the end of the track, waiting for more\n";
+                out.flush();
+            } else {
+                err << photo.filePath << ": " << photo.errorMessage << "\n";
+                err.flush();
+            }
+        });
+        QObject::connect(&daemon, &lyp::WatchDaemon::trackReloaded,
+                         [&out](int trackpointCount) {
+            out << "Reloaded " << trackpointCount << " trackpoints\n";
+            out.flush();
+        });
+
+        if (!daemon.start(photoDirs, gpxFiles, !parser.isSet(newOnlyOption))) {
+            return 1;
+        }
+        out << "Watching " << photoDirs.size() << " director"
+            << (photoDirs.size() == 1 ? "y" : "ies") << "; press Ctrl+C to stop\n";
+        out.flush();
+        return app.exec();
+    }
+
+    qint64 scanMs = 0;
+
+    QObject::connect(&processor, &lyp::PhotoProcessor::photosScanComplete,
+                     [&](int count) {
+        scanMs = phaseTimer.elapsed();
+        out << "Scanned " << count << " photo(s) in " << scanMs << " ms\n";
+        out.flush();
+        phaseTimer.restart();
+        processor.processPhotos(&model, settings);
+    });
+
+    QObject::connect(&processor, &lyp::PhotoProcessor::progressUpdated,
+                     [&err](int current, int total) {
+        err << "\rProcessing " << current << "/" << total;
+        err.flush();
+    });
+
+    QObject::connect(&processor, &lyp::PhotoProcessor::processingComplete,
+                     [&](int successCount, int totalCount) {
+        const qint64 processMs = phaseTimer.elapsed();
+        err << "\n";
+        err.flush();
+
+        int skipped = 0;
+        int errors = 0;
+        for (const lyp::PhotoItem& photo : model.photos()) {
+            if (photo.state == lyp::PhotoState::Skipped) {
+                ++skipped;
+            } else if (photo.state == lyp::PhotoState::Error) {
+                ++errors;
+                err << photo.filePath << ": " << photo.errorMessage << "\n";
+            }
+        }
+
+        const double seconds = std::max<qint64>(processMs, 1) / 1000.0;
+        const int workers = settings.workerCount > 0 ? settings.workerCount
+                                                     : QThread::idealThreadCount();
+        out << successCount << " geotagged, " << skipped << " skipped, "
+            << errors << " failed of " << totalCount << "\n";
+        out << "Processed in " << processMs << " ms with " << workers
+            << " worker(s): " << QString::number(totalCount / seconds, 'f', 1)
+            << " photos/s\n";
+        if (settings.dryRun) {
+            out << "Dry run: no files were modified\n";
+        }
+        if (printStats) {
+            out << "\n" << lyp::PerfTrace::summary(totalCount, processMs) << "\n";
+        }
+        out.flush();
+
+        QCoreApplication::exit(errors > 0 ? 2 : 0);
+    });
+
+    // Start once the event loop runs; results arrive as queued calls. The
+    // walk goes first: with no walk running, scanPhotos() would report the
+    // scan complete as soon as its own files were queued
+    QTimer::singleShot(0, &processor, [&]() {
+        phaseTimer.restart();
+        if (!photoDirs.isEmpty()) {
+            processor.scanDirectories(photoDirs, &model);
+        }
+        if (!photoPaths.isEmpty()) {
+            processor.scanPhotos(photoPaths, &model);
+        }
+    });
+
+    return app.exec();
+}
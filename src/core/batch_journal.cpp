@@ -0,0 +1,306 @@
+#include "batch_journal.h"
+#include "exif_handler.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace lyp {
+
+namespace {
+
+QString stateName(PhotoState state) {
+  switch (state) {
+  case PhotoState::Success:
+    return "success";
+  case PhotoState::Skipped:
+    return "skipped";
+  case PhotoState::Error:
+    return "error";
+  default:
+    return "pending";
+  }
+}
+
+QString nowUtc() {
+  return QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+}
+
+QByteArray toLine(const QJsonObject &object) {
+  return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+}
+
+/**
+ * @brief Flush the OS buffers of an open file to the device.
+ */
+bool syncFile(QFile &file) {
+  if (!file.flush())
+    return false;
+#ifdef Q_OS_WIN
+  return _commit(file.handle()) == 0;
+#else
+  return ::fsync(file.handle()) == 0;
+#endif
+}
+
+bool statFile(const QString &filePath, qint64 &size, qint64 &mtimeMs) {
+  const QFileInfo info(filePath);
+  if (!info.isFile())
+    return false;
+  size = info.size();
+  mtimeMs = info.lastModified().toMSecsSinceEpoch();
+  return true;
+}
+
+QString writtenPathFor(const QString &filePath, OutputMode outputMode) {
+  return outputMode == OutputMode::XmpSidecar
+             ? ExifHandler::sidecarPath(filePath)
+             : filePath;
+}
+
+} // namespace
+
+BatchJournal::BatchJournal(const QString &filePath) : m_filePath(filePath) {}
+
+BatchJournal::~BatchJournal() { flush(); }
+
+QString BatchJournal::defaultFilePath() {
+  return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+         "/batch-journal.jsonl";
+}
+
+QString BatchJournal::fingerprint(const ProcessingSettings &settings,
+                                  double maxTimeDiffSeconds,
+                                  const TrackSet &tracks) {
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  const auto addNumber = [&hash](auto value) {
+    hash.addData(QByteArray::number(value) + ';');
+  };
+  addNumber(settings.timeOffsetHours);
+  addNumber(maxTimeDiffSeconds);
+  addNumber(settings.forceInterpolate ? 1 : 0);
+  addNumber(static_cast<int>(settings.outputMode));
+  for (const TrackSource &source : tracks.sources()) {
+    addNumber(source.track->size());
+    addNumber(source.track->timesMs().front());
+    addNumber(source.track->timesMs().back());
+  }
+  return QString::fromLatin1(hash.result().toHex().left(16));
+}
+
+bool BatchJournal::open(const QString &fingerprint,
+                        const ProcessingSettings &settings,
+                        const QStringList &gpxFiles, int photoCount) {
+  m_fingerprint = fingerprint;
+  load();
+
+  if (!QDir().mkpath(QFileInfo(m_filePath).absolutePath())) {
+    qWarning() << "Cannot create journal directory for" << m_filePath;
+    return false;
+  }
+
+  QJsonObject run;
+  run["type"] = "run";
+  run["time"] = nowUtc();
+  run["run"] = m_fingerprint;
+  run["photos"] = photoCount;
+  run["timeOffsetHours"] = settings.timeOffsetHours;
+  run["maxTimeDiffSeconds"] = settings.maxTimeDiffSeconds;
+  run["forceInterpolate"] = settings.forceInterpolate;
+  run["overwrite"] = settings.overwriteExistingGps;
+  run["sidecar"] = settings.outputMode == OutputMode::XmpSidecar;
+  run["gpx"] = QJsonArray::fromStringList(gpxFiles);
+
+  // The run line is synced at once so every later line has its context
+  QMutexLocker locker(&m_mutex);
+  m_pending.append(toLine(run));
+  ++m_pendingRecords;
+  return flushLocked();
+}
+
+void BatchJournal::load() {
+  m_completed.clear();
+
+  QFile file(m_filePath);
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  // Latest line per photo of this configuration, kept when compacting
+  const QByteArray needle = m_fingerprint.toLatin1();
+  QByteArray runLine;
+  QVector<QByteArray> kept;
+  QHash<QString, int> keptIndex;
+
+  int lines = 0;
+  while (!file.atEnd()) {
+    const QByteArray line = file.readLine();
+    // A torn last line has no newline and usually no closing brace
+    if (!line.endsWith('\n'))
+      break;
+    ++lines;
+
+    // Lines of other configurations are not parsed at all
+    if (!line.contains(needle))
+      continue;
+    const QJsonObject object = QJsonDocument::fromJson(line).object();
+    if (object.value("run").toString() != m_fingerprint)
+      continue;
+    if (object.value("type") == "run") {
+      runLine = line;
+      continue;
+    }
+    if (object.value("type") != "file")
+      continue;
+
+    const QString path = object.value("path").toString();
+    const auto slot = keptIndex.constFind(path);
+    if (slot != keptIndex.constEnd()) {
+      kept[*slot] = line;
+    } else {
+      keptIndex.insert(path, kept.size());
+      kept.append(line);
+    }
+
+    if (object.value("state") != "success" || !object.contains("lat")) {
+      // A later failure supersedes an earlier success
+      m_completed.remove(path);
+      continue;
+    }
+
+    Done done;
+    done.size = object.value("size").toInteger();
+    done.mtimeMs = object.value("mtime").toInteger();
+    done.entry.latitude = object.value("lat").toDouble();
+    done.entry.longitude = object.value("lon").toDouble();
+    if (object.contains("ele")) {
+      done.entry.elevation = object.value("ele").toDouble();
+    }
+    m_completed.insert(path, done);
+  }
+
+  qInfo() << "Journal" << m_filePath << ":" << lines << "line(s),"
+          << m_completed.size() << "photo(s) done with these settings";
+
+  bool tornTail = false;
+  if (file.size() > 0) {
+    file.seek(file.size() - 1);
+    tornTail = file.read(1) != "\n";
+  }
+  file.close();
+
+  // A compacted file ends with a complete line
+  const int keptLines = kept.size() + (runLine.isEmpty() ? 0 : 1);
+  if (lines > keptLines + kCompactionSlack && compact(runLine, kept))
+    return;
+
+  // Start on a fresh line if the last one was torn
+  if (tornTail) {
+    m_pending.append('\n');
+  }
+}
+
+bool BatchJournal::compact(const QByteArray &runLine,
+                           const QVector<QByteArray> &lines) {
+  QByteArray data = runLine;
+  for (const QByteArray &line : lines) {
+    data.append(line);
+  }
+
+  QSaveFile file(m_filePath);
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() ||
+      !file.commit()) {
+    qWarning() << "Failed to compact journal" << m_filePath;
+    return false;
+  }
+  qInfo() << "Compacted journal" << m_filePath << "to"
+          << lines.size() + (runLine.isEmpty() ? 0 : 1) << "line(s)";
+  return true;
+}
+
+std::optional<JournalEntry>
+BatchJournal::completed(const QString &filePath, OutputMode outputMode) const {
+  auto it = m_completed.constFind(filePath);
+  if (it == m_completed.constEnd())
+    return std::nullopt;
+
+  qint64 size = 0;
+  qint64 mtimeMs = 0;
+  if (!statFile(writtenPathFor(filePath, outputMode), size, mtimeMs) ||
+      size != it->size || mtimeMs != it->mtimeMs)
+    return std::nullopt;
+  return it->entry;
+}
+
+void BatchJournal::record(const QString &filePath, const QString &writtenPath,
+                          const PhotoResult &result) {
+  QJsonObject line;
+  line["type"] = "file";
+  line["time"] = nowUtc();
+  line["run"] = m_fingerprint;
+  line["path"] = filePath;
+  line["state"] = stateName(result.state);
+  if (!result.errorMessage.isEmpty()) {
+    line["message"] = result.errorMessage;
+  }
+  if (result.captureTime.isValid()) {
+    line["captured"] = result.captureTime.toString(Qt::ISODateWithMs);
+  }
+  if (result.matchedLat && result.matchedLon) {
+    line["lat"] = *result.matchedLat;
+    line["lon"] = *result.matchedLon;
+    if (result.matchedElevation) {
+      line["ele"] = *result.matchedElevation;
+    }
+  }
+  qint64 size = 0;
+  qint64 mtimeMs = 0;
+  if (statFile(writtenPath, size, mtimeMs)) {
+    line["size"] = size;
+    line["mtime"] = mtimeMs;
+  }
+  const QByteArray encoded = toLine(line);
+
+  QMutexLocker locker(&m_mutex);
+  m_pending.append(encoded);
+  ++m_pendingRecords;
+  if (m_pendingRecords >= kSyncRecords ||
+      m_sinceSync.elapsed() >= kSyncIntervalMs) {
+    flushLocked();
+  }
+}
+
+bool BatchJournal::flush() {
+  QMutexLocker locker(&m_mutex);
+  return flushLocked();
+}
+
+bool BatchJournal::flushLocked() {
+  m_sinceSync.start();
+  if (m_pending.isEmpty())
+    return true;
+
+  QFile file(m_filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append) ||
+      file.write(m_pending) != m_pending.size() || !syncFile(file)) {
+    qWarning() << "Failed to append to journal" << m_filePath;
+    return false;
+  }
+  m_pending.clear();
+  m_pendingRecords = 0;
+  return true;
+}
+
+} // namespace lyp
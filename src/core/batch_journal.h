@@ -0,0 +1,147 @@
+#pragma once
+
+#include "core/photo_processor.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <optional>
+
+namespace lyp {
+
+/**
+ * @brief A photo written by an earlier run with the same settings.
+ */
+struct JournalEntry {
+  double latitude = 0.0;
+  double longitude = 0.0;
+  std::optional<double> elevation;
+};
+
+/**
+ * @brief Append-only log of per-photo outcomes, used to resume batches.
+ *
+ * One JSON object per line: a "run" line with the settings when a batch
+ * starts, then a "file" line per photo with its state, matched coordinates
+ * and the size and modification time of the file written (the photo, or
+ * its sidecar). The file doubles as an audit log of recent runs.
+ *
+ * open() only parses the lines of its own configuration. Once lines of
+ * other configurations and superseded lines outnumber the rest by
+ * kCompactionSlack, it rewrites the file with the last run line and the
+ * last line per photo of the configuration being opened. The file is thus
+ * bounded by the photos of the settings in use rather than by its history.
+ *
+ * Lines are buffered and written with one fsync per batch of kSyncRecords
+ * or kSyncIntervalMs, so a crash loses at most the last batch; those photos
+ * are simply processed again. A torn last line is ignored on load.
+ *
+ * A photo counts as done when the journal has a success line for it from a
+ * run with the same fingerprint, and the written file still has the
+ * recorded size and time, i.e. nobody has touched it since.
+ */
+class BatchJournal {
+public:
+  static constexpr int kSyncRecords = 256;
+  static constexpr qint64 kSyncIntervalMs = 2000;
+  static constexpr int kCompactionSlack = 4096;
+
+  /**
+   * @brief Journal at a path; nothing is read or written until open().
+   */
+  explicit BatchJournal(const QString &filePath);
+
+  /**
+   * @brief Writes buffered lines.
+   */
+  ~BatchJournal();
+
+  BatchJournal(const BatchJournal &) = delete;
+  BatchJournal &operator=(const BatchJournal &) = delete;
+
+  /**
+   * @brief Load earlier results of this configuration and start a run.
+   * @param fingerprint Identifies settings and tracks (see fingerprint())
+   * @param settings Recorded in the run line for auditing
+   * @param gpxFiles Recorded in the run line for auditing
+   * @param photoCount Photos in the batch
+   * @return false if the journal cannot be written
+   */
+  bool open(const QString &fingerprint, const ProcessingSettings &settings,
+            const QStringList &gpxFiles, int photoCount);
+
+  /**
+   * @brief Number of photos known to be done for this fingerprint.
+   */
+  int completedCount() const { return m_completed.size(); }
+
+  /**
+   * @brief Look up a photo finished by an earlier run.
+   *
+   * Thread-safe after open().
+   * @param filePath Photo path
+   * @param outputMode Where that run wrote the coordinates
+   * @return Its coordinates, or nullopt if the photo must be processed
+   */
+  std::optional<JournalEntry> completed(const QString &filePath,
+                                        OutputMode outputMode) const;
+
+  /**
+   * @brief Log the outcome of one photo. Thread-safe.
+   * @param filePath Photo path
+   * @param writtenPath File that was written on success (photo or sidecar)
+   * @param result Outcome
+   */
+  void record(const QString &filePath, const QString &writtenPath,
+              const PhotoResult &result);
+
+  /**
+   * @brief Append buffered lines and sync them to disk.
+   * @return true on success
+   */
+  bool flush();
+
+  const QString &filePath() const { return m_filePath; }
+
+  /**
+   * @brief Fingerprint given to the last open().
+   */
+  const QString &runFingerprint() const { return m_fingerprint; }
+
+  /**
+   * @brief Default journal in the application data directory.
+   */
+  static QString defaultFilePath();
+
+  /**
+   * @brief Hash of everything that decides where photos end up.
+   * @param settings Run settings
+   * @param maxTimeDiffSeconds Effective matching threshold
+   * @param tracks Loaded tracks
+   */
+  static QString fingerprint(const ProcessingSettings &settings,
+                             double maxTimeDiffSeconds, const TrackSet &tracks);
+
+private:
+  struct Done {
+    qint64 size = 0;
+    qint64 mtimeMs = 0;
+    JournalEntry entry;
+  };
+
+  void load();
+  bool compact(const QByteArray &runLine, const QVector<QByteArray> &lines);
+  bool flushLocked();
+
+  const QString m_filePath;
+  QString m_fingerprint;
+  QHash<QString, Done> m_completed; // Read-only once open() returns
+
+  QMutex m_mutex;
+  QByteArray m_pending;
+  int m_pendingRecords = 0;
+  QElapsedTimer m_sinceSync;
+};
+
+} // namespace lyp
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <deque>
+#include <optional>
+
+namespace lyp {
+
+/**
+ * @brief Blocking FIFO of fixed capacity connecting two pipeline stages.
+ *
+ * push() waits while the queue is full, pop() while it is empty. close()
+ * wakes every waiter: further pushes fail, and pops drain what is left
+ * before reporting the end.
+ */
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(int capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  /**
+   * @brief Append an item, waiting for room.
+   * @return false if the queue was closed; the item is dropped
+   */
+  bool push(T item) {
+    QMutexLocker locker(&m_mutex);
+    while (!m_closed && static_cast<int>(m_items.size()) >= m_capacity) {
+      m_notFull.wait(&m_mutex);
+    }
+    if (m_closed)
+      return false;
+    m_items.push_back(std::move(item));
+    m_notEmpty.wakeOne();
+    return true;
+  }
+
+  /**
+   * @brief Take the oldest item, waiting for one.
+   * @return The item, or nullopt once the queue is closed and empty
+   */
+  std::optional<T> pop() {
+    QMutexLocker locker(&m_mutex);
+    while (!m_closed && m_items.empty()) {
+      m_notEmpty.wait(&m_mutex);
+    }
+    if (m_items.empty())
+      return std::nullopt;
+    std::optional<T> item(std::move(m_items.front()));
+    m_items.pop_front();
+    m_notFull.wakeOne();
+    return item;
+  }
+
+  /**
+   * @brief Stop accepting items and wake all waiting threads.
+   */
+  void close() {
+    QMutexLocker locker(&m_mutex);
+    m_closed = true;
+    m_notEmpty.wakeAll();
+    m_notFull.wakeAll();
+  }
+
+private:
+  QMutex m_mutex;
+  QWaitCondition m_notEmpty;
+  QWaitCondition m_notFull;
+  std::deque<T> m_items;
+  const int m_capacity;
+  bool m_closed = false;
+};
+
+} // namespace lyp
@@ -0,0 +1,104 @@
+#include "directory_scanner.h"
+#include "exif_handler.h"
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+
+namespace lyp {
+
+DirectoryScanner::DirectoryScanner(QObject *parent)
+    : QObject(parent), m_pool(new QThreadPool(this)) {
+  // Directory listing is I/O bound; oversubscribe to keep the disk queue full
+  m_pool->setMaxThreadCount(std::max(4, QThread::idealThreadCount() * 2));
+}
+
+DirectoryScanner::~DirectoryScanner() {
+  cancel();
+  m_pool->waitForDone();
+}
+
+void DirectoryScanner::start(const QStringList &directories) {
+  if (!m_walk) {
+    m_walk = std::make_shared<Walk>();
+    m_fileCount = 0;
+  }
+
+  for (const QString &dir : directories) {
+    ++m_pendingDirs;
+    walkDirectory(m_walk, QFileInfo(dir).absoluteFilePath());
+  }
+
+  if (m_pendingDirs == 0) {
+    m_walk.reset();
+    emit finished(0);
+  }
+}
+
+void DirectoryScanner::cancel() {
+  if (m_walk) {
+    m_walk->cancelled = true;
+    m_walk.reset();
+  }
+  m_pendingDirs = 0;
+  m_fileCount = 0;
+}
+
+void DirectoryScanner::walkDirectory(const std::shared_ptr<Walk> &walk,
+                                     const QString &path) {
+  m_pool->start([this, walk, path]() {
+    if (walk->cancelled)
+      return;
+
+    QStringList files;
+    QStringList subdirs;
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+      it.next();
+      const QFileInfo info = it.fileInfo();
+      if (info.isDir()) {
+        if (!info.isSymLink()) {
+          subdirs.append(info.filePath());
+        }
+      } else if (ExifHandler::isSupported(info.fileName())) {
+        files.append(info.filePath());
+      }
+    }
+    std::sort(files.begin(), files.end());
+
+    // Report subdirectories first so the walk never looks finished early
+    QMetaObject::invokeMethod(
+        this,
+        [this, walk, files, subdirs]() {
+          if (walk != m_walk)
+            return;
+          m_pendingDirs += subdirs.size();
+          for (const QString &subdir : subdirs) {
+            walkDirectory(walk, subdir);
+          }
+          onDirectoryDone(walk, files);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void DirectoryScanner::onDirectoryDone(const std::shared_ptr<Walk> &walk,
+                                       const QStringList &files) {
+  if (!files.isEmpty()) {
+    m_fileCount += files.size();
+    emit filesFound(files);
+  }
+
+  // A slot connected to filesFound may have cancelled or restarted us
+  if (walk != m_walk)
+    return;
+
+  if (--m_pendingDirs == 0) {
+    const int count = m_fileCount;
+    m_walk.reset();
+    m_fileCount = 0;
+    emit finished(count);
+  }
+}
+
+} // namespace lyp
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+namespace lyp {
+
+/**
+ * @brief Parallel recursive walk of directory trees for supported photos.
+ *
+ * Every directory is listed by its own pool task and subdirectories are
+ * queued as they are found, so wide trees are read concurrently. Matching
+ * files are delivered in batches through filesFound() while the walk is
+ * still running. Hidden entries and symlinked directories are skipped.
+ */
+class DirectoryScanner : public QObject {
+  Q_OBJECT
+
+public:
+  explicit DirectoryScanner(QObject *parent = nullptr);
+  ~DirectoryScanner() override;
+
+  /**
+   * @brief Start walking the given directories.
+   *
+   * May be called while a walk is running; the new roots join it.
+   * @param directories Root directories
+   */
+  void start(const QStringList &directories);
+
+  /**
+   * @brief Abandon the current walk; no further signals are emitted for it.
+   */
+  void cancel();
+
+  /**
+   * @brief Check if a walk is in progress.
+   */
+  bool isRunning() const { return m_pendingDirs > 0; }
+
+signals:
+  /**
+   * @brief Emitted with a batch of supported photo files.
+   * @param filePaths Absolute file paths, sorted within each directory
+   */
+  void filesFound(const QStringList &filePaths);
+
+  /**
+   * @brief Emitted when every directory has been listed.
+   * @param fileCount Number of supported files found
+   */
+  void finished(int fileCount);
+
+private:
+  // Shared with pool tasks, which may outlive a cancelled walk
+  struct Walk {
+    std::atomic<bool> cancelled{false};
+  };
+
+  void walkDirectory(const std::shared_ptr<Walk> &walk, const QString &path);
+  void onDirectoryDone(const std::shared_ptr<Walk> &walk,
+                       const QStringList &files);
+
+  QThreadPool *m_pool;
+  std::shared_ptr<Walk> m_walk;
+  int m_pendingDirs = 0;
+  int m_fileCount = 0;
+};
+
+} // namespace lyp
@@ -1,15 +1,25 @@
 #include "exif_handler.h"
+#include "fast_exif_probe.h"
+#include "gps_kernel.h"
+#include "mapped_file.h"
+#include "perf_trace.h"
 #include <QDebug>
+#include <QDir>
 #include <QFileInfo>
 #include <QHash>
+#include <QSet>
 #include <QTimeZone>
+#include <QVector>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <exiv2/exiv2.hpp>
 
 namespace lyp {
 
-QString ExifHandler::s_lastError;
-
 // Format support database based on exiv2 manual
 // Key: extension (lowercase), Value: {level, warning}
 static const QHash<QString, FormatInfo> &getFormatDatabase() {
@@ -73,6 +83,11 @@ static const QHash<QString, FormatInfo> &getFormatDatabase() {
   return db;
 }
 
+void ExifHandler::initialize() {
+  // The XMP toolkit is not thread-safe until explicitly initialized
+  Exiv2::XmpParser::initialize();
+}
+
 const QStringList &ExifHandler::supportedExtensions() {
   static const QStringList extensions = {
       // JPEG - Full support
@@ -89,79 +104,163 @@ const QStringList &ExifHandler::supportedExtensions() {
 }
 
 bool ExifHandler::isSupported(const QString &path) {
-  QString ext = QFileInfo(path).suffix().toLower();
-  return supportedExtensions().contains(ext);
+  // Plain string scan; avoids a QFileInfo per path during bulk ingest
+  const qsizetype dot = path.lastIndexOf(QLatin1Char('.'));
+  const qsizetype slash = std::max(path.lastIndexOf(QLatin1Char('/')),
+                                   path.lastIndexOf(QLatin1Char('\\')));
+  if (dot < 0 || dot < slash)
+    return false;
+  return isSupportedExtension(QStringView(path).mid(dot + 1));
 }
 
-std::optional<QDateTime>
-ExifHandler::getPhotoTimestamp(const QString &filePath,
-                               double timeOffsetSeconds) {
-  s_lastError.clear();
+bool ExifHandler::isSupportedExtension(QStringView suffix) {
+  static const QSet<QString> extensions(supportedExtensions().begin(),
+                                        supportedExtensions().end());
+  return extensions.contains(suffix.toString().toLower());
+}
 
-  try {
-    auto image = Exiv2::ImageFactory::open(filePath.toStdString());
-    image->readMetadata();
+namespace {
 
-    const Exiv2::ExifData &exifData = image->exifData();
-    if (exifData.empty()) {
-      s_lastError = "No EXIF data found";
-      return std::nullopt;
-    }
+using URational = std::pair<uint32_t, uint32_t>;
 
-    // Try DateTimeOriginal first, then CreateDate
-    QStringList dateKeys = {
-        "Exif.Photo.DateTimeOriginal", "Exif.Image.DateTimeOriginal",
-        "Exif.Photo.DateTimeDigitized", "Exif.Image.DateTime"};
+/**
+ * @brief Convert decimal degrees to the DMS rationals written to EXIF.
+ */
+std::array<URational, 3> toDmsRationals(double decimal) {
+  const GpsKernel::Dms dms = GpsKernel::toDms(decimal);
+  return {URational(dms.degrees, 1), URational(dms.minutes, 1),
+          URational(dms.seconds, GpsKernel::kSecondsDenominator)};
+}
 
-    for (const QString &key : dateKeys) {
-      auto it = exifData.findKey(Exiv2::ExifKey(key.toStdString()));
-      if (it != exifData.end()) {
-        QString dateStr = QString::fromStdString(it->toString());
-        // EXIF format: "YYYY:MM:DD HH:MM:SS"
-        QDateTime dt = QDateTime::fromString(dateStr, "yyyy:MM:dd HH:mm:ss");
-        if (dt.isValid()) {
-          // Convert from local camera time to UTC
-          dt.setTimeZone(QTimeZone::utc());
-          if (timeOffsetSeconds != 0.0) {
-            dt = dt.addSecs(static_cast<qint64>(-timeOffsetSeconds));
-          }
-          return dt;
+/**
+ * @brief Convert an elevation to the altitude rational (centimetres).
+ */
+URational toAltitudeRational(double elevation) {
+  return URational(GpsKernel::toAltitude(elevation),
+                   GpsKernel::kAltitudeDenominator);
+}
+
+/**
+ * @brief Build a user-facing write error that explains format risks.
+ */
+QString describeWriteError(const QString &filePath,
+                           const FormatInfo &formatInfo,
+                           const QString &errorMsg) {
+  if (formatInfo.level == FormatSupportLevel::DangerousRAW) {
+    return QString("Failed to write GPS to %1 RAW: %2\n%3")
+        .arg(QFileInfo(filePath).suffix().toUpper())
+        .arg(errorMsg)
+        .arg(formatInfo.warning);
+  }
+  if (formatInfo.level == FormatSupportLevel::Minimal) {
+    return QString("Cannot write metadata to %1 format: %2")
+        .arg(QFileInfo(filePath).suffix().toUpper())
+        .arg(formatInfo.warning);
+  }
+  return QString("Failed to write GPS: %1").arg(errorMsg);
+}
+
+} // namespace
+
+MetadataSession::MetadataSession(const QString &filePath)
+    : m_filePath(filePath), m_formatInfo(ExifHandler::getFormatInfo(filePath)) {
+  try {
+    {
+      ScopedTimer timer(PerfStage::Open);
+      m_mapping = MappedFile::open(filePath, -1, true);
+      if (m_mapping) {
+        // MemIo reads the mapped pages in place; exiv2 only copies on write
+        m_image = Exiv2::ImageFactory::open(std::make_unique<Exiv2::MemIo>(
+            m_mapping->data(), static_cast<size_t>(m_mapping->size())));
+        if (!m_image) {
+          throw Exiv2::Error(Exiv2::ErrorCode::kerFileContainsUnknownImageType,
+                             filePath.toStdString());
         }
+      } else {
+        m_image = Exiv2::ImageFactory::open(filePath.toStdString());
       }
     }
+    ScopedTimer timer(PerfStage::ReadMetadata);
+    m_image->readMetadata();
+    PerfTrace::addBytesRead(static_cast<qint64>(m_image->io().size()));
+  } catch (const Exiv2::Error &e) {
+    m_image.reset();
+    m_mapping.reset();
+    m_openError = QString::fromStdString(e.what());
+    m_lastError = QString("Exiv2 error: %1").arg(m_openError);
+  }
+}
+
+MetadataSession::~MetadataSession() = default;
 
-    s_lastError = "No valid timestamp found in EXIF";
+std::optional<QDateTime>
+MetadataSession::timestamp(double timeOffsetSeconds) const {
+  if (!m_image) {
     return std::nullopt;
+  }
 
-  } catch (const Exiv2::Error &e) {
-    s_lastError = QString("Exiv2 error: %1").arg(e.what());
-    qWarning() << s_lastError;
+  const Exiv2::ExifData &exifData = m_image->exifData();
+  if (exifData.empty()) {
+    m_lastError = "No EXIF data found";
     return std::nullopt;
   }
-}
 
-bool ExifHandler::hasGpsData(const QString &filePath) {
+  // Try DateTimeOriginal first, then CreateDate
+  static const char *const dateKeys[] = {
+      "Exif.Photo.DateTimeOriginal", "Exif.Image.DateTimeOriginal",
+      "Exif.Photo.DateTimeDigitized", "Exif.Image.DateTime"};
+
   try {
-    auto image = Exiv2::ImageFactory::open(filePath.toStdString());
-    image->readMetadata();
+    for (const char *key : dateKeys) {
+      auto it = exifData.findKey(Exiv2::ExifKey(key));
+      if (it != exifData.end()) {
+        // Sub-second digits only accompany the primary key
+        QString subSec;
+        if (key == dateKeys[0]) {
+          auto subSecIt = exifData.findKey(
+              Exiv2::ExifKey("Exif.Photo.SubSecTimeOriginal"));
+          if (subSecIt != exifData.end()) {
+            subSec = QString::fromStdString(subSecIt->toString());
+          }
+        }
 
-    const Exiv2::ExifData &exifData = image->exifData();
-    auto latIt = exifData.findKey(Exiv2::ExifKey("Exif.GPSInfo.GPSLatitude"));
-    auto lonIt = exifData.findKey(Exiv2::ExifKey("Exif.GPSInfo.GPSLongitude"));
+        auto dt = ExifHandler::parseExifDateTime(
+            QString::fromStdString(it->toString()), subSec,
+            timeOffsetSeconds);
+        if (dt.has_value()) {
+          return dt;
+        }
+      }
+    }
+  } catch (const Exiv2::Error &e) {
+    m_lastError = QString("Exiv2 error: %1").arg(e.what());
+    qWarning() << m_lastError;
+    return std::nullopt;
+  }
 
-    return latIt != exifData.end() && lonIt != exifData.end();
+  m_lastError = "No valid timestamp found in EXIF";
+  return std::nullopt;
+}
 
-  } catch (const Exiv2::Error &) {
+bool MetadataSession::hasGpsData() const {
+  if (!m_image) {
     return false;
   }
+
+  const Exiv2::ExifData &exifData = m_image->exifData();
+  auto latIt = exifData.findKey(Exiv2::ExifKey("Exif.GPSInfo.GPSLatitude"));
+  auto lonIt = exifData.findKey(Exiv2::ExifKey("Exif.GPSInfo.GPSLongitude"));
+
+  return latIt != exifData.end() && lonIt != exifData.end();
 }
 
-std::optional<GpsCoord> ExifHandler::readGpsData(const QString &filePath) {
-  try {
-    auto image = Exiv2::ImageFactory::open(filePath.toStdString());
-    image->readMetadata();
+std::optional<GpsCoord> MetadataSession::gpsData() const {
+  if (!m_image) {
+    return std::nullopt;
+  }
 
-    const Exiv2::ExifData &exifData = image->exifData();
+  try {
+    const Exiv2::ExifData &exifData = m_image->exifData();
 
     auto latIt = exifData.findKey(Exiv2::ExifKey("Exif.GPSInfo.GPSLatitude"));
     auto lonIt = exifData.findKey(Exiv2::ExifKey("Exif.GPSInfo.GPSLongitude"));
@@ -214,33 +313,69 @@ std::optional<GpsCoord> ExifHandler::readGpsData(const QString &filePath) {
     return coord;
 
   } catch (const Exiv2::Error &e) {
-    s_lastError = QString("Exiv2 error: %1").arg(e.what());
+    m_lastError = QString("Exiv2 error: %1").arg(e.what());
     return std::nullopt;
   }
 }
 
-bool ExifHandler::writeGpsData(const QString &filePath, double latitude,
-                               double longitude,
-                               std::optional<double> elevation) {
-  s_lastError.clear();
+int MetadataSession::orientation() const {
+  if (!m_image) {
+    return 1;
+  }
 
   try {
-    auto image = Exiv2::ImageFactory::open(filePath.toStdString());
-    image->readMetadata();
-
-    Exiv2::ExifData &exifData = image->exifData();
-
-    // Helper to convert decimal degrees to DMS rational
-    auto toRational = [](double decimal) -> std::vector<Exiv2::Rational> {
-      decimal = std::abs(decimal);
-      int deg = static_cast<int>(decimal);
-      double minDecimal = (decimal - deg) * 60.0;
-      int min = static_cast<int>(minDecimal);
-      double sec = (minDecimal - min) * 60.0;
-      // Use high precision for seconds (multiply by 10000)
-      int secNumerator = static_cast<int>(sec * 10000);
-      return {{deg, 1}, {min, 1}, {secNumerator, 10000}};
-    };
+    const Exiv2::ExifData &exifData = m_image->exifData();
+    auto it = exifData.findKey(Exiv2::ExifKey("Exif.Image.Orientation"));
+    if (it == exifData.end() || it->count() == 0) {
+      return 1;
+    }
+    const auto value = it->toInt64();
+    return value >= 1 && value <= 8 ? static_cast<int>(value) : 1;
+  } catch (const Exiv2::Error &e) {
+    m_lastError = QString("Exiv2 error: %1").arg(e.what());
+    return 1;
+  }
+}
+
+QByteArray MetadataSession::embeddedPreview(int minWidth) const {
+  if (!m_image) {
+    return QByteArray();
+  }
+
+  try {
+    Exiv2::PreviewManager manager(*m_image);
+    // Sorted by size, smallest first
+    const Exiv2::PreviewPropertiesList previews =
+        manager.getPreviewProperties();
+    if (previews.empty()) {
+      return QByteArray();
+    }
+    auto it = std::find_if(previews.begin(), previews.end(),
+                           [minWidth](const Exiv2::PreviewProperties &p) {
+                             return p.width_ >= static_cast<size_t>(minWidth);
+                           });
+    const Exiv2::PreviewImage preview =
+        manager.getPreviewImage(it != previews.end() ? *it : previews.back());
+    return QByteArray(reinterpret_cast<const char *>(preview.pData()),
+                      static_cast<qsizetype>(preview.size()));
+  } catch (const Exiv2::Error &e) {
+    m_lastError = QString("Exiv2 error: %1").arg(e.what());
+    return QByteArray();
+  }
+}
+
+bool MetadataSession::writeGpsData(double latitude, double longitude,
+                                   std::optional<double> elevation) {
+  m_lastError.clear();
+
+  if (!m_image) {
+    m_lastError = describeWriteError(m_filePath, m_formatInfo, m_openError);
+    qWarning() << m_lastError;
+    return false;
+  }
+
+  try {
+    Exiv2::ExifData &exifData = m_image->exifData();
 
     // Set GPS Version ID
     Exiv2::Value::UniquePtr versionValue =
@@ -249,22 +384,20 @@ bool ExifHandler::writeGpsData(const QString &filePath, double latitude,
     exifData["Exif.GPSInfo.GPSVersionID"] = *versionValue;
 
     // Set latitude
-    auto latRationals = toRational(latitude);
+    auto latRationals = toDmsRationals(latitude);
     exifData["Exif.GPSInfo.GPSLatitudeRef"] = (latitude >= 0) ? "N" : "S";
     Exiv2::URationalValue latValue;
     for (const auto &r : latRationals) {
-      latValue.value_.push_back(std::make_pair(
-          static_cast<uint32_t>(r.first), static_cast<uint32_t>(r.second)));
+      latValue.value_.push_back(r);
     }
     exifData["Exif.GPSInfo.GPSLatitude"] = latValue;
 
     // Set longitude
-    auto lonRationals = toRational(longitude);
+    auto lonRationals = toDmsRationals(longitude);
     exifData["Exif.GPSInfo.GPSLongitudeRef"] = (longitude >= 0) ? "E" : "W";
     Exiv2::URationalValue lonValue;
     for (const auto &r : lonRationals) {
-      lonValue.value_.push_back(std::make_pair(
-          static_cast<uint32_t>(r.first), static_cast<uint32_t>(r.second)));
+      lonValue.value_.push_back(r);
     }
     exifData["Exif.GPSInfo.GPSLongitude"] = lonValue;
 
@@ -272,42 +405,271 @@ bool ExifHandler::writeGpsData(const QString &filePath, double latitude,
     if (elevation.has_value()) {
       double alt = elevation.value();
       exifData["Exif.GPSInfo.GPSAltitudeRef"] = (alt >= 0) ? "0" : "1";
-      int altNumerator = static_cast<int>(std::abs(alt) * 100);
       Exiv2::URationalValue altValue;
-      altValue.value_.push_back(
-          std::make_pair(static_cast<uint32_t>(altNumerator), 100u));
+      altValue.value_.push_back(toAltitudeRational(alt));
       exifData["Exif.GPSInfo.GPSAltitude"] = altValue;
     }
 
-    image->writeMetadata();
+    {
+      ScopedTimer timer(PerfStage::Write);
+      m_image->writeMetadata();
+      PerfTrace::addBytesWritten(static_cast<qint64>(m_image->io().size()));
+      if (m_mapping && !saveMappedImage()) {
+        qWarning() << m_lastError;
+        return false;
+      }
+    }
 
-    qInfo() << "Wrote GPS to" << filePath << ":" << latitude << ","
+    qInfo() << "Wrote GPS to" << m_filePath << ":" << latitude << ","
             << longitude;
     return true;
 
   } catch (const Exiv2::Error &e) {
     // Provide more helpful error messages based on format
-    FormatInfo formatInfo = getFormatInfo(filePath);
-    QString errorMsg = QString::fromStdString(e.what());
-
-    if (formatInfo.level == FormatSupportLevel::DangerousRAW) {
-      s_lastError = QString("Failed to write GPS to %1 RAW: %2\n%3")
-                        .arg(QFileInfo(filePath).suffix().toUpper())
-                        .arg(errorMsg)
-                        .arg(formatInfo.warning);
-    } else if (formatInfo.level == FormatSupportLevel::Minimal) {
-      s_lastError = QString("Cannot write metadata to %1 format: %2")
-                        .arg(QFileInfo(filePath).suffix().toUpper())
-                        .arg(formatInfo.warning);
+    m_lastError = describeWriteError(m_filePath, m_formatInfo,
+                                     QString::fromStdString(e.what()));
+    qWarning() << m_lastError;
+    return false;
+  }
+}
+
+bool MetadataSession::saveMappedImage() {
+  // writeMetadata() left the new file contents in the MemIo
+  Exiv2::BasicIo &io = m_image->io();
+  QSaveFile out(m_filePath);
+  bool written = out.open(QIODevice::WriteOnly) && io.open() == 0;
+  if (written) {
+    const qint64 size = static_cast<qint64>(io.size());
+    written = out.write(reinterpret_cast<const char *>(io.mmap()), size) == size;
+    io.munmap();
+    io.close();
+  }
+
+  // The image may still point into the mapping, and a mapped file cannot be
+  // replaced on every platform
+  m_image.reset();
+  m_mapping.reset();
+  if (!written || !out.commit()) {
+    m_lastError = describeWriteError(m_filePath, m_formatInfo, out.errorString());
+    return false;
+  }
+  return true;
+}
+
+Result<QDateTime> ExifHandler::getPhotoTimestamp(const QString &filePath,
+                                                 double timeOffsetSeconds) {
+  // Header-only probe first; full decode only for layouts it can't read
+  if (auto probe = FastExifProbe::probe(filePath)) {
+    if (auto timestamp = probe->captureTime(timeOffsetSeconds)) {
+      return *timestamp;
+    }
+    return Result<QDateTime>::failure("No valid timestamp found in EXIF");
+  }
+
+  MetadataSession session(filePath);
+  if (!session.isOpen()) {
+    qWarning() << session.lastError();
+    return Result<QDateTime>::failure(session.lastError());
+  }
+
+  if (auto timestamp = session.timestamp(timeOffsetSeconds)) {
+    return *timestamp;
+  }
+  return Result<QDateTime>::failure(session.lastError());
+}
+
+std::optional<QDateTime>
+ExifHandler::parseExifDateTime(const QString &value, const QString &subSec,
+                               double timeOffsetSeconds) {
+  // EXIF format: "YYYY:MM:DD HH:MM:SS"
+  QDateTime dt = QDateTime::fromString(value, "yyyy:MM:dd HH:mm:ss");
+  if (!dt.isValid()) {
+    return std::nullopt;
+  }
+
+  // Convert from local camera time to UTC
+  dt.setTimeZone(QTimeZone::utc());
+  if (timeOffsetSeconds != 0.0) {
+    dt = dt.addSecs(static_cast<qint64>(-timeOffsetSeconds));
+  }
+
+  // SubSecTime holds the leading decimal digits of the second
+  const QString fraction = subSec.trimmed();
+  if (!fraction.isEmpty()) {
+    bool ok = false;
+    const int millis = fraction.left(3).leftJustified(3, '0').toInt(&ok);
+    if (ok) {
+      dt = dt.addMSecs(millis);
+    }
+  }
+  return dt;
+}
+
+bool ExifHandler::hasGpsData(const QString &filePath) {
+  if (auto probe = FastExifProbe::probe(filePath)) {
+    return probe->hasGps;
+  }
+  return MetadataSession(filePath).hasGpsData();
+}
+
+Result<std::optional<GpsCoord>>
+ExifHandler::readGpsData(const QString &filePath) {
+  MetadataSession session(filePath);
+  auto coord = session.gpsData();
+  if (!coord.has_value() && !session.lastError().isEmpty()) {
+    return Result<std::optional<GpsCoord>>::failure(session.lastError());
+  }
+  return coord;
+}
+
+Status ExifHandler::writeGpsData(const QString &filePath, double latitude,
+                                 double longitude,
+                                 std::optional<double> elevation) {
+  MetadataSession session(filePath);
+  if (!session.writeGpsData(latitude, longitude, elevation)) {
+    return Status::failure(session.lastError());
+  }
+  return Status::success();
+}
+
+namespace {
+
+/**
+ * @brief Format a coordinate as XMP GPSCoordinate "DDD,MM.mmmmmmR".
+ */
+std::string toXmpCoordinate(double decimal, char positiveRef,
+                            char negativeRef) {
+  const char ref = decimal >= 0 ? positiveRef : negativeRef;
+  // Round once, in whole millionths of a minute, so 59.9999996' carries
+  // into the degrees instead of printing as 60.000000
+  constexpr qint64 kMicroMinutesPerDegree = 60 * 1000000;
+  const qint64 microMinutes = std::llround(std::abs(decimal) * 60e6);
+  const qint64 deg = microMinutes / kMicroMinutesPerDegree;
+  const double minutes = (microMinutes % kMicroMinutesPerDegree) / 1e6;
+  return QString("%1,%2%3")
+      .arg(deg)
+      .arg(minutes, 0, 'f', 6)
+      .arg(QLatin1Char(ref))
+      .toStdString();
+}
+
+} // namespace
+
+QString ExifHandler::sidecarPath(const QString &filePath) {
+  const QFileInfo info(filePath);
+  return info.dir().filePath(info.completeBaseName() + ".xmp");
+}
+
+Status ExifHandler::writeGpsSidecar(const QString &filePath, double latitude,
+                                    double longitude,
+                                    std::optional<double> elevation) {
+  const QString xmpPath = sidecarPath(filePath);
+  ScopedTimer timer(PerfStage::Write);
+
+  try {
+    Exiv2::Image::UniquePtr sidecar;
+    if (QFileInfo::exists(xmpPath)) {
+      sidecar = Exiv2::ImageFactory::open(xmpPath.toStdString());
+      sidecar->readMetadata();
     } else {
-      s_lastError = QString("Failed to write GPS: %1").arg(errorMsg);
+      sidecar = Exiv2::ImageFactory::create(Exiv2::ImageType::xmp,
+                                            xmpPath.toStdString());
     }
-    qWarning() << s_lastError;
-    return false;
+
+    Exiv2::XmpData &xmpData = sidecar->xmpData();
+    xmpData["Xmp.exif.GPSVersionID"] = "2.3.0.0";
+    xmpData["Xmp.exif.GPSLatitude"] = toXmpCoordinate(latitude, 'N', 'S');
+    xmpData["Xmp.exif.GPSLongitude"] = toXmpCoordinate(longitude, 'E', 'W');
+
+    if (elevation.has_value()) {
+      double alt = elevation.value();
+      xmpData["Xmp.exif.GPSAltitudeRef"] = (alt >= 0) ? "0" : "1";
+      xmpData["Xmp.exif.GPSAltitude"] =
+          QString("%1/%2")
+              .arg(GpsKernel::toAltitude(alt))
+              .arg(GpsKernel::kAltitudeDenominator)
+              .toStdString();
+    }
+
+    sidecar->writeMetadata();
+    PerfTrace::addBytesWritten(static_cast<qint64>(sidecar->io().size()));
+
+    qInfo() << "Wrote GPS sidecar" << xmpPath << ":" << latitude << ","
+            << longitude;
+    return Status::success();
+
+  } catch (const Exiv2::Error &e) {
+    const QString error = QString("Failed to write XMP sidecar %1: %2")
+                              .arg(QFileInfo(xmpPath).fileName())
+                              .arg(e.what());
+    qWarning() << error;
+    return Status::failure(error);
   }
 }
 
-QString ExifHandler::lastError() { return s_lastError; }
+bool ExifHandler::patchGpsInPlace(const QString &filePath, double latitude,
+                                  double longitude,
+                                  std::optional<double> elevation) {
+  auto probe = FastExifProbe::probe(filePath);
+  if (!probe || !probe->gpsLayout.canPatch(elevation.has_value())) {
+    return false;
+  }
+  const GpsValueLayout &layout = probe->gpsLayout;
+
+  auto putRational = [&layout](QByteArray &out, const URational &r) {
+    uchar bytes[8];
+    if (layout.littleEndian) {
+      qToLittleEndian<quint32>(r.first, bytes);
+      qToLittleEndian<quint32>(r.second, bytes + 4);
+    } else {
+      qToBigEndian<quint32>(r.first, bytes);
+      qToBigEndian<quint32>(r.second, bytes + 4);
+    }
+    out.append(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+  };
+  auto dms = [&putRational](double decimal) {
+    QByteArray out;
+    for (const URational &r : toDmsRationals(decimal)) {
+      putRational(out, r);
+    }
+    return out;
+  };
+
+  // Same values the exiv2 path writes; refs are "N\0" style ASCII
+  QVector<QPair<qint64, QByteArray>> patches = {
+      {layout.latitudeRef, QByteArray(latitude >= 0 ? "N" : "S", 2)},
+      {layout.latitude, dms(latitude)},
+      {layout.longitudeRef, QByteArray(longitude >= 0 ? "E" : "W", 2)},
+      {layout.longitude, dms(longitude)}};
+  if (elevation.has_value()) {
+    QByteArray altitude;
+    putRational(altitude, toAltitudeRational(elevation.value()));
+    patches.append({layout.altitudeRef,
+                    QByteArray(1, elevation.value() >= 0 ? '\0' : '\1')});
+    patches.append({layout.altitude, altitude});
+  }
+
+  ScopedTimer timer(PerfStage::Write);
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadWrite)) {
+    return false;
+  }
+  for (const auto &[offset, bytes] : patches) {
+    PerfTrace::addBytesWritten(bytes.size());
+    if (!file.seek(offset) || file.write(bytes) != bytes.size()) {
+      // Values are rewritten whole by the exiv2 fallback
+      qWarning() << "In-place GPS patch failed for" << filePath;
+      return false;
+    }
+  }
+  if (!file.flush()) {
+    return false;
+  }
+
+  qInfo() << "Patched GPS in place for" << filePath << ":" << latitude << ","
+          << longitude;
+  return true;
+}
 
 FormatInfo ExifHandler::getFormatInfo(const QString &path) {
   QString ext = QFileInfo(path).suffix().toLower();
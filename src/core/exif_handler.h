@@ -1,12 +1,21 @@
 #pragma once
 
+#include "core/result.h"
+#include <QByteArray>
 #include <QDateTime>
 #include <QString>
 #include <QStringList>
+#include <memory>
 #include <optional>
 
+namespace Exiv2 {
+class Image;
+} // namespace Exiv2
+
 namespace lyp {
 
+class MappedFile;
+
 /**
  * @brief GPS coordinate result from EXIF operations.
  */
@@ -41,6 +50,13 @@ struct FormatInfo {
  */
 class ExifHandler {
 public:
+  /**
+   * @brief Prepare exiv2 for use from multiple threads.
+   *
+   * Must be called once on the main thread before any worker touches exiv2.
+   */
+  static void initialize();
+
   /**
    * @brief Supported photo file extensions.
    */
@@ -53,15 +69,33 @@ public:
    */
   static bool isSupported(const QString &path);
 
+  /**
+   * @brief Check a bare extension against a precomputed hash set.
+   * @param suffix Extension without the dot, any case
+   * @return true if the extension is supported
+   */
+  static bool isSupportedExtension(QStringView suffix);
+
   /**
    * @brief Extract capture timestamp from photo EXIF.
    * @param filePath Path to the photo file
    * @param timeOffsetSeconds Timezone offset in seconds to apply (positive =
    * camera ahead of UTC)
-   * @return Capture time in UTC, or invalid QDateTime on failure
+   * @return Capture time in UTC, or why it could not be read
    */
-  static std::optional<QDateTime>
-  getPhotoTimestamp(const QString &filePath, double timeOffsetSeconds = 0.0);
+  static Result<QDateTime> getPhotoTimestamp(const QString &filePath,
+                                             double timeOffsetSeconds = 0.0);
+
+  /**
+   * @brief Convert an EXIF "YYYY:MM:DD HH:MM:SS" value to UTC.
+   * @param value Date/time string
+   * @param subSec Optional SubSecTime digits (fraction of a second)
+   * @param timeOffsetSeconds Camera offset from UTC to subtract
+   * @return Time in UTC, or nullopt if value is malformed
+   */
+  static std::optional<QDateTime> parseExifDateTime(const QString &value,
+                                                    const QString &subSec,
+                                                    double timeOffsetSeconds);
 
   /**
    * @brief Check if photo already has GPS data in EXIF.
@@ -73,9 +107,10 @@ public:
   /**
    * @brief Read existing GPS coordinates from photo.
    * @param filePath Path to the photo file
-   * @return GPS coordinates or nullopt if not present
+   * @return GPS coordinates, nullopt if not present, or why the file could
+   *         not be read
    */
-  static std::optional<GpsCoord> readGpsData(const QString &filePath);
+  static Result<std::optional<GpsCoord>> readGpsData(const QString &filePath);
 
   /**
    * @brief Write GPS coordinates to photo EXIF.
@@ -83,17 +118,51 @@ public:
    * @param latitude GPS latitude
    * @param longitude GPS longitude
    * @param elevation GPS elevation (optional)
-   * @return true on success
+   * @return Success or the write error
    */
-  static bool writeGpsData(const QString &filePath, double latitude,
-                           double longitude,
-                           std::optional<double> elevation = std::nullopt);
+  static Status writeGpsData(const QString &filePath, double latitude,
+                             double longitude,
+                             std::optional<double> elevation = std::nullopt);
 
   /**
-   * @brief Get the last error message.
-   * @return Error message or empty string
+   * @brief Overwrite existing GPS values in place, without exiv2.
+   *
+   * Only applies to JPEG/TIFF-style files whose GPS IFD already holds the
+   * reference, coordinate and (if given) altitude tags in the layout the
+   * writer produces; the values are then replaced by small positional
+   * writes. Returns false without changing the file otherwise, and the
+   * caller should fall back to writeGpsData().
+   * @param filePath Path to the photo file
+   * @param latitude GPS latitude
+   * @param longitude GPS longitude
+   * @param elevation GPS elevation (optional)
+   * @return true if the values were patched
    */
-  static QString lastError();
+  static bool patchGpsInPlace(const QString &filePath, double latitude,
+                              double longitude,
+                              std::optional<double> elevation = std::nullopt);
+
+  /**
+   * @brief Write GPS coordinates to an XMP sidecar next to the photo.
+   *
+   * The photo itself is neither read nor modified. An existing sidecar is
+   * updated in place, keeping its other properties.
+   * @param filePath Path to the photo file
+   * @param latitude GPS latitude
+   * @param longitude GPS longitude
+   * @param elevation GPS elevation (optional)
+   * @return Success or the write error
+   */
+  static Status writeGpsSidecar(const QString &filePath, double latitude,
+                                double longitude,
+                                std::optional<double> elevation = std::nullopt);
+
+  /**
+   * @brief Sidecar path for a photo ("IMG_0001.ARW" -> "IMG_0001.xmp").
+   *
+   * A RAW+JPEG pair shares one sidecar; see PhotoPipeline for who writes it.
+   */
+  static QString sidecarPath(const QString &filePath);
 
   /**
    * @brief Get detailed format support info for a file.
@@ -122,9 +191,104 @@ public:
    * @return true if file is a RAW format
    */
   static bool isRawFormat(const QString &path);
+};
+
+/**
+ * @brief Metadata of a single photo, opened and parsed once.
+ *
+ * Timestamp, existing GPS and format queries are answered from one
+ * readMetadata() pass, and the GPS write is applied to the same parsed image.
+ * Large files on local disks are parsed from a memory mapping (see
+ * MappedFile); others through exiv2's buffered file I/O.
+ * Not thread-safe; use one session per thread.
+ */
+class MetadataSession {
+public:
+  /**
+   * @brief Open and parse the metadata of a photo.
+   * @param filePath Path to the photo file
+   */
+  explicit MetadataSession(const QString &filePath);
+  ~MetadataSession();
+
+  MetadataSession(const MetadataSession &) = delete;
+  MetadataSession &operator=(const MetadataSession &) = delete;
+
+  /**
+   * @brief Check if the file was opened and parsed successfully.
+   */
+  bool isOpen() const { return m_image != nullptr; }
+
+  const QString &filePath() const { return m_filePath; }
+
+  /**
+   * @brief Format support info for the session's file.
+   */
+  const FormatInfo &formatInfo() const { return m_formatInfo; }
+
+  /**
+   * @brief Extract capture timestamp.
+   * @param timeOffsetSeconds Timezone offset in seconds to apply (positive =
+   * camera ahead of UTC)
+   * @return Capture time in UTC, or nullopt on failure
+   */
+  std::optional<QDateTime> timestamp(double timeOffsetSeconds = 0.0) const;
+
+  /**
+   * @brief Check if the file already has GPS coordinates.
+   */
+  bool hasGpsData() const;
+
+  /**
+   * @brief Read existing GPS coordinates.
+   * @return GPS coordinates or nullopt if not present
+   */
+  std::optional<GpsCoord> gpsData() const;
+
+  /**
+   * @brief Embedded preview image as stored in the file (usually JPEG).
+   * @param minWidth Smallest useful width; the smallest preview at least this
+   *        wide is picked, otherwise the largest one
+   * @return Encoded image, or empty if the file has none
+   */
+  QByteArray embeddedPreview(int minWidth) const;
+
+  /**
+   * @brief EXIF orientation of the main image (1-8).
+   *
+   * Embedded previews are stored the way the sensor saw them, so this is
+   * what turns them upright.
+   * @return Orientation, or 1 (upright) if unknown
+   */
+  int orientation() const;
+
+  /**
+   * @brief Write GPS coordinates to the parsed image and save it.
+   *
+   * A mapped image is saved to a temporary file that then replaces the
+   * original, and the session is closed afterwards.
+   * @param latitude GPS latitude
+   * @param longitude GPS longitude
+   * @param elevation GPS elevation (optional)
+   * @return true on success
+   */
+  bool writeGpsData(double latitude, double longitude,
+                    std::optional<double> elevation = std::nullopt);
+
+  /**
+   * @brief Get the last error message of this session.
+   */
+  QString lastError() const { return m_lastError; }
 
 private:
-  static QString s_lastError;
+  bool saveMappedImage();
+
+  QString m_filePath;
+  FormatInfo m_formatInfo;
+  std::unique_ptr<MappedFile> m_mapping; // Must outlive m_image
+  std::unique_ptr<Exiv2::Image> m_image;
+  QString m_openError;
+  mutable QString m_lastError;
 };
 
 } // namespace lyp
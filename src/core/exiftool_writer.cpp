@@ -1,44 +1,233 @@
 #include "exiftool_writer.h"
+#include "perf_trace.h"
 #include <QDebug>
 #include <QProcess>
 #include <QStandardPaths>
+#include <QThreadPool>
+#include <algorithm>
 
 namespace lyp {
 
-QString ExifToolWriter::s_lastError;
-bool ExifToolWriter::s_availabilityChecked = false;
-bool ExifToolWriter::s_isAvailable = false;
+namespace {
 
-bool ExifToolWriter::isAvailable() {
-  if (!s_availabilityChecked) {
-    s_availabilityChecked = true;
+// Per-command timeout, matching the one-shot path
+constexpr int kCommandTimeoutMs = 30000;
 
-    // Try to find exiftool in PATH
-    QString exiftoolPath = QStandardPaths::findExecutable("exiftool");
-    s_isAvailable = !exiftoolPath.isEmpty();
+// Commands written before their responses are collected; keeps exiftool's
+// stdout pipe from filling up while we are still writing
+constexpr int kPipelineDepth = 64;
 
-    if (s_isAvailable) {
-      qInfo() << "Found exiftool at:" << exiftoolPath;
-    } else {
-      qWarning() << "exiftool not found in PATH";
+constexpr char kNotInstalled[] = "exiftool is not installed or not in PATH";
+
+// Persistent session of the calling thread
+thread_local std::unique_ptr<ExifToolSession> t_session;
+
+ExifToolSession *threadSession() {
+  if (!t_session) {
+    t_session = std::make_unique<ExifToolSession>();
+  }
+  return t_session.get();
+}
+
+/**
+ * @brief Interpret the output of one exiftool write command.
+ */
+GpsWriteResult parseWriteOutput(const QString &output) {
+  QStringList errors;
+  const QStringList lines = output.split('\n', Qt::SkipEmptyParts);
+  for (const QString &line : lines) {
+    QString trimmed = line.trimmed();
+    if (trimmed.startsWith("Error")) {
+      errors << trimmed;
+    } else if (trimmed.endsWith("image files updated") &&
+               !trimmed.startsWith("0 ")) {
+      return Status::success();
     }
   }
-  return s_isAvailable;
+
+  return Status::failure(
+      errors.isEmpty() ? QString("exiftool failed: %1").arg(output.trimmed())
+                       : QString("exiftool failed: %1").arg(errors.join("; ")));
+}
+
+/**
+ * @brief Path of exiftool, searched once per process.
+ *
+ * A function-local static is initialised exactly once even when several
+ * workers ask at the same time; later calls are a plain read.
+ */
+const QString &discoveredExecutable() {
+  static const QString path = []() {
+    const QString found = QStandardPaths::findExecutable("exiftool");
+    if (found.isEmpty()) {
+      qWarning() << "exiftool not found in PATH";
+    } else {
+      qInfo() << "Found exiftool at:" << found;
+    }
+    return found;
+  }();
+  return path;
 }
 
-bool ExifToolWriter::writeGpsData(const QString &filePath, double latitude,
-                                  double longitude,
-                                  std::optional<double> elevation) {
-  s_lastError.clear();
+} // namespace
 
-  if (!isAvailable()) {
-    s_lastError = "exiftool is not installed or not in PATH";
+ExifToolSession::ExifToolSession() = default;
+
+ExifToolSession::~ExifToolSession() { stop(); }
+
+bool ExifToolSession::start() {
+  if (isRunning()) {
+    return true;
+  }
+
+  if (!ExifToolWriter::isAvailable()) {
     return false;
   }
 
-  // Build exiftool command arguments
+  m_process = std::make_unique<QProcess>();
+  // stderr is merged so error lines arrive before the {ready} marker
+  m_process->setProcessChannelMode(QProcess::MergedChannels);
+  m_process->start(ExifToolWriter::executablePath(),
+                   {"-stay_open", "True", "-@", "-"});
+  if (!m_process->waitForStarted(kCommandTimeoutMs)) {
+    qWarning() << "Failed to start exiftool session:"
+               << m_process->errorString();
+    m_process.reset();
+    return false;
+  }
+
+  m_buffer.clear();
+  qInfo() << "Started persistent exiftool session";
+  return true;
+}
+
+bool ExifToolSession::isRunning() const {
+  return m_process && m_process->state() == QProcess::Running;
+}
+
+void ExifToolSession::stop() {
+  if (!m_process) {
+    return;
+  }
+
+  if (m_process->state() == QProcess::Running) {
+    m_process->write("-stay_open\nFalse\n");
+    m_process->closeWriteChannel();
+    if (!m_process->waitForFinished(2000)) {
+      m_process->kill();
+      m_process->waitForFinished(1000);
+    }
+  }
+  m_process.reset();
+  m_buffer.clear();
+}
+
+int ExifToolSession::sendCommand(const QStringList &args) {
+  const int commandId = m_nextCommandId++;
+
+  QByteArray command;
+  // Arguments are read one per line; file names are sent as UTF-8
+  command += "-charset\nfilename=utf8\n";
+  for (const QString &arg : args) {
+    command += arg.toUtf8();
+    command += '\n';
+  }
+  command += "-execute" + QByteArray::number(commandId) + '\n';
+
+  m_process->write(command);
+  return commandId;
+}
+
+bool ExifToolSession::readResponse(int commandId, QString *output) {
+  const QByteArray marker = "{ready" + QByteArray::number(commandId) + "}";
+
+  while (true) {
+    int markerPos = m_buffer.indexOf(marker);
+    if (markerPos >= 0) {
+      *output = QString::fromUtf8(m_buffer.left(markerPos));
+      int lineEnd = m_buffer.indexOf('\n', markerPos);
+      m_buffer.remove(0, lineEnd >= 0 ? lineEnd + 1
+                                      : markerPos + marker.size());
+      return true;
+    }
+
+    if (!m_process->waitForReadyRead(kCommandTimeoutMs)) {
+      return false;
+    }
+    m_buffer += m_process->readAll();
+  }
+}
+
+QVector<GpsWriteResult>
+ExifToolSession::writeGpsData(const QVector<GpsWriteRequest> &requests) {
+  if (!start()) {
+    return QVector<GpsWriteResult>(
+        requests.size(), Status::failure("Failed to start exiftool"));
+  }
+
+  QVector<GpsWriteResult> results(requests.size());
+
+  for (int chunkStart = 0; chunkStart < requests.size();
+       chunkStart += kPipelineDepth) {
+    const int chunkEnd =
+        std::min<int>(chunkStart + kPipelineDepth, requests.size());
+
+    // Queue the whole chunk, then collect responses in order
+    QVector<int> commandIds;
+    commandIds.reserve(chunkEnd - chunkStart);
+    for (int i = chunkStart; i < chunkEnd; ++i) {
+      const GpsWriteRequest &request = requests[i];
+      QStringList args;
+      args << "-overwrite_original"; // Don't create backup files
+      args << ExifToolWriter::gpsArguments(request.latitude, request.longitude,
+                                           request.elevation);
+      args << request.filePath;
+      commandIds.append(sendCommand(args));
+    }
+
+    for (int i = chunkStart; i < chunkEnd; ++i) {
+      QString output;
+      if (!readResponse(commandIds[i - chunkStart], &output)) {
+        // The session is unusable after a timeout; fail the rest of the chunk
+        for (int j = i; j < chunkEnd; ++j) {
+          results[j] = Status::failure(
+              QString("exiftool timed out for %1").arg(requests[j].filePath));
+        }
+        qWarning() << "exiftool session timed out, restarting";
+        m_process->kill();
+        m_process->waitForFinished(1000);
+        m_process.reset();
+        if (!start()) {
+          for (int j = chunkEnd; j < requests.size(); ++j) {
+            results[j] = Status::failure("Failed to restart exiftool");
+          }
+          return results;
+        }
+        break;
+      }
+
+      results[i] = parseWriteOutput(output);
+      if (results[i].ok()) {
+        qInfo() << "exiftool wrote GPS to" << requests[i].filePath << ":"
+                << requests[i].latitude << "," << requests[i].longitude;
+      } else {
+        qWarning() << results[i].error();
+      }
+    }
+  }
+
+  return results;
+}
+
+bool ExifToolWriter::isAvailable() {
+  return !discoveredExecutable().isEmpty();
+}
+
+QString ExifToolWriter::executablePath() { return discoveredExecutable(); }
+
+QStringList ExifToolWriter::gpsArguments(double latitude, double longitude,
+                                         std::optional<double> elevation) {
   QStringList args;
-  args << "-overwrite_original"; // Don't create backup files
 
   // GPS coordinates
   QString latRef = latitude >= 0 ? "N" : "S";
@@ -57,30 +246,97 @@ bool ExifToolWriter::writeGpsData(const QString &filePath, double latitude,
                 .arg(alt >= 0 ? "Above Sea Level" : "Below Sea Level");
   }
 
+  return args;
+}
+
+Status ExifToolWriter::writeGpsData(const QString &filePath, double latitude,
+                                    double longitude,
+                                    std::optional<double> elevation) {
+  if (!isAvailable()) {
+    return Status::failure(kNotInstalled);
+  }
+
+  ScopedTimer timer(PerfStage::ExifTool);
+  ExifToolSession *session = threadSession();
+  if (!session->start()) {
+    // Fall back to spawning exiftool for this file
+    return writeGpsDataOneShot(filePath, latitude, longitude, elevation);
+  }
+
+  return session->writeGpsData({{filePath, latitude, longitude, elevation}})
+      .first();
+}
+
+QVector<GpsWriteResult>
+ExifToolWriter::writeGpsDataBatch(const QVector<GpsWriteRequest> &requests) {
+  if (!isAvailable()) {
+    return QVector<GpsWriteResult>(requests.size(),
+                                   Status::failure(kNotInstalled));
+  }
+
+  return threadSession()->writeGpsData(requests);
+}
+
+QVector<GpsWriteResult>
+ExifToolWriter::writeGpsDataParallel(const QVector<GpsWriteRequest> &requests,
+                                     int processCount) {
+  processCount = std::max(1, std::min<int>(processCount, requests.size()));
+  if (processCount <= 1 || !isAvailable()) {
+    return writeGpsDataBatch(requests);
+  }
+
+  QVector<GpsWriteResult> results(requests.size());
+  const int chunkSize = (requests.size() + processCount - 1) / processCount;
+
+  GpsWriteResult *out = results.data();
+
+  // Each pool thread owns one session for the lifetime of this call
+  QThreadPool pool;
+  pool.setMaxThreadCount(processCount);
+  for (int start = 0; start < requests.size(); start += chunkSize) {
+    const int count = std::min<int>(chunkSize, requests.size() - start);
+    pool.start([&requests, out, start, count]() {
+      const QVector<GpsWriteResult> chunkResults =
+          writeGpsDataBatch(requests.mid(start, count));
+      std::copy(chunkResults.cbegin(), chunkResults.cend(), out + start);
+      shutdownSession();
+    });
+  }
+  pool.waitForDone();
+
+  return results;
+}
+
+void ExifToolWriter::shutdownSession() { t_session.reset(); }
+
+Status ExifToolWriter::writeGpsDataOneShot(const QString &filePath,
+                                           double latitude, double longitude,
+                                           std::optional<double> elevation) {
+  // Build exiftool command arguments
+  QStringList args;
+  args << "-overwrite_original"; // Don't create backup files
+  args << gpsArguments(latitude, longitude, elevation);
   args << filePath;
 
   // Execute exiftool
   QProcess process;
-  process.start("exiftool", args);
+  process.start(executablePath(), args);
 
-  if (!process.waitForFinished(30000)) { // 30 second timeout
-    s_lastError = QString("exiftool timed out for %1").arg(filePath);
+  if (!process.waitForFinished(kCommandTimeoutMs)) {
     process.kill();
-    return false;
+    return Status::failure(QString("exiftool timed out for %1").arg(filePath));
   }
 
   if (process.exitCode() != 0) {
     QString stderr = QString::fromUtf8(process.readAllStandardError());
-    s_lastError = QString("exiftool failed: %1").arg(stderr.trimmed());
-    qWarning() << s_lastError;
-    return false;
+    const QString error = QString("exiftool failed: %1").arg(stderr.trimmed());
+    qWarning() << error;
+    return Status::failure(error);
   }
 
   qInfo() << "exiftool wrote GPS to" << filePath << ":" << latitude << ","
           << longitude;
-  return true;
+  return Status::success();
 }
 
-QString ExifToolWriter::lastError() { return s_lastError; }
-
 } // namespace lyp
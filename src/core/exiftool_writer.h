@@ -1,14 +1,92 @@
 #pragma once
 
+#include "core/result.h"
+#include <QByteArray>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
 #include <optional>
 
+class QProcess;
+
 namespace lyp {
 
+/**
+ * @brief A single GPS write for batch exiftool operations.
+ */
+struct GpsWriteRequest {
+  QString filePath;
+  double latitude = 0.0;
+  double longitude = 0.0;
+  std::optional<double> elevation;
+};
+
+/**
+ * @brief Outcome of a single GPS write in a batch.
+ */
+using GpsWriteResult = Status;
+
+/**
+ * @brief Long-lived `exiftool -stay_open True -@ -` process.
+ *
+ * Arguments are streamed over stdin and each command is terminated by a
+ * numbered `-execute` marker, so the Perl startup cost is paid once per
+ * session instead of once per file. Commands can be pipelined: several are
+ * written before their responses are collected.
+ *
+ * A session belongs to the thread that created it.
+ */
+class ExifToolSession {
+public:
+  ExifToolSession();
+  ~ExifToolSession();
+
+  ExifToolSession(const ExifToolSession &) = delete;
+  ExifToolSession &operator=(const ExifToolSession &) = delete;
+
+  /**
+   * @brief Start the exiftool process if it is not running.
+   * @return true if the process is ready for commands
+   */
+  bool start();
+
+  /**
+   * @brief Check if the exiftool process is running.
+   */
+  bool isRunning() const;
+
+  /**
+   * @brief Write GPS data to many files through one session.
+   *
+   * Commands are pipelined in chunks; one result is returned per request.
+   * @param requests Files and coordinates to write
+   * @return Results in the same order as the requests
+   */
+  QVector<GpsWriteResult>
+  writeGpsData(const QVector<GpsWriteRequest> &requests);
+
+  /**
+   * @brief Ask exiftool to exit and wait briefly for it.
+   */
+  void stop();
+
+private:
+  int sendCommand(const QStringList &args);
+  bool readResponse(int commandId, QString *output);
+
+  std::unique_ptr<QProcess> m_process;
+  QByteArray m_buffer;
+  int m_nextCommandId = 1;
+};
+
 /**
  * @brief Writer for GPS data using external exiftool command.
  *
  * Used for BMFF formats (HEIC, AVIF, CR3, JXL) that exiv2 can't write to.
+ * Each calling thread keeps its own persistent ExifToolSession, so a worker
+ * pool naturally runs one exiftool process per worker. The executable is
+ * looked up once per process, on first use from any thread.
  */
 class ExifToolWriter {
 public:
@@ -18,28 +96,56 @@ public:
    */
   static bool isAvailable();
 
+  /**
+   * @brief Path of the exiftool executable, empty if not available.
+   */
+  static QString executablePath();
+
   /**
    * @brief Write GPS coordinates using exiftool.
    * @param filePath Path to the photo file
    * @param latitude GPS latitude
    * @param longitude GPS longitude
    * @param elevation GPS elevation (optional)
-   * @return true on success
+   * @return Success or the exiftool error
+   */
+  static Status writeGpsData(const QString &filePath, double latitude,
+                             double longitude,
+                             std::optional<double> elevation = std::nullopt);
+
+  /**
+   * @brief Write GPS data to many files using the calling thread's session.
+   * @param requests Files and coordinates to write
+   * @return Results in the same order as the requests
+   */
+  static QVector<GpsWriteResult>
+  writeGpsDataBatch(const QVector<GpsWriteRequest> &requests);
+
+  /**
+   * @brief Write GPS data to many files using several exiftool processes.
+   * @param requests Files and coordinates to write
+   * @param processCount Number of exiftool processes to run in parallel
+   * @return Results in the same order as the requests
+   */
+  static QVector<GpsWriteResult>
+  writeGpsDataParallel(const QVector<GpsWriteRequest> &requests,
+                       int processCount);
+
+  /**
+   * @brief Close the exiftool session owned by the calling thread.
    */
-  static bool writeGpsData(const QString &filePath, double latitude,
-                           double longitude,
-                           std::optional<double> elevation = std::nullopt);
+  static void shutdownSession();
 
   /**
-   * @brief Get the last error message.
-   * @return Error message or empty string
+   * @brief Build the exiftool tag arguments for a GPS write.
    */
-  static QString lastError();
+  static QStringList gpsArguments(double latitude, double longitude,
+                                  std::optional<double> elevation);
 
 private:
-  static QString s_lastError;
-  static bool s_availabilityChecked;
-  static bool s_isAvailable;
+  static Status writeGpsDataOneShot(const QString &filePath, double latitude,
+                                    double longitude,
+                                    std::optional<double> elevation);
 };
 
 } // namespace lyp
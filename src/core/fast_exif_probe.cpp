@@ -0,0 +1,324 @@
+#include "fast_exif_probe.h"
+#include "perf_trace.h"
+#include "exif_handler.h"
+#include "mapped_file.h"
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+
+namespace lyp {
+
+namespace {
+
+// TIFF tags of interest
+constexpr quint16 kTagDateTime = 0x0132;
+constexpr quint16 kTagExifIfd = 0x8769;
+constexpr quint16 kTagGpsIfd = 0x8825;
+constexpr quint16 kTagDateTimeOriginal = 0x9003;
+constexpr quint16 kTagDateTimeDigitized = 0x9004;
+constexpr quint16 kTagOffsetTimeOriginal = 0x9011;
+constexpr quint16 kTagSubSecTimeOriginal = 0x9291;
+constexpr quint16 kTagGpsLatitudeRef = 0x0001;
+constexpr quint16 kTagGpsLatitude = 0x0002;
+constexpr quint16 kTagGpsLongitudeRef = 0x0003;
+constexpr quint16 kTagGpsLongitude = 0x0004;
+constexpr quint16 kTagGpsAltitudeRef = 0x0005;
+constexpr quint16 kTagGpsAltitude = 0x0006;
+
+constexpr quint16 kTypeByte = 1;
+constexpr quint16 kTypeAscii = 2;
+constexpr quint16 kTypeLong = 4;
+constexpr quint16 kTypeRational = 5;
+constexpr quint16 kTypeIfd = 13;
+
+// Sanity limit; real IFDs hold a few dozen entries
+constexpr int kMaxIfdEntries = 1024;
+
+/**
+ * @brief Bounds-checked reader over a TIFF structure.
+ */
+class TiffReader {
+public:
+  TiffReader(const uchar *tiff, qint64 size, qint64 fileOffset)
+      : m_tiff(tiff), m_size(size), m_fileOffset(fileOffset) {}
+
+  bool littleEndian() const { return m_littleEndian; }
+
+  bool init() {
+    if (m_size < 8)
+      return false;
+    if (m_tiff[0] == 'I' && m_tiff[1] == 'I') {
+      m_littleEndian = true;
+    } else if (m_tiff[0] == 'M' && m_tiff[1] == 'M') {
+      m_littleEndian = false;
+    } else {
+      return false;
+    }
+    return u16(2) == 42;
+  }
+
+  bool contains(qint64 offset, qint64 length) const {
+    return offset >= 0 && length >= 0 && offset <= m_size - length;
+  }
+
+  quint16 u16(qint64 offset) const {
+    const uchar *p = m_tiff + offset;
+    return m_littleEndian ? quint16(p[0] | (p[1] << 8))
+                          : quint16((p[0] << 8) | p[1]);
+  }
+
+  quint32 u32(qint64 offset) const {
+    const uchar *p = m_tiff + offset;
+    return m_littleEndian
+               ? quint32(p[0]) | (quint32(p[1]) << 8) |
+                     (quint32(p[2]) << 16) | (quint32(p[3]) << 24)
+               : (quint32(p[0]) << 24) | (quint32(p[1]) << 16) |
+                     (quint32(p[2]) << 8) | quint32(p[3]);
+  }
+
+  /**
+   * @brief Visit each entry of the IFD at offset.
+   * @return false if the IFD lies outside the buffer
+   */
+  template <typename Visitor> bool forEachEntry(qint64 offset, Visitor visit) {
+    if (!contains(offset, 2))
+      return false;
+    const int count = u16(offset);
+    if (count > kMaxIfdEntries || !contains(offset + 2, qint64(count) * 12))
+      return false;
+    for (int i = 0; i < count; ++i) {
+      const qint64 entry = offset + 2 + qint64(i) * 12;
+      if (!visit(entry, u16(entry), u16(entry + 2), u32(entry + 4)))
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Read an ASCII entry's value, trimmed at the first NUL.
+   */
+  bool ascii(qint64 entry, quint16 type, quint32 count, QString &out) const {
+    if (type != kTypeAscii || count == 0)
+      return true; // Ignore unexpected types, as exiv2 lookups would fail too
+    const qint64 valueOffset = count <= 4 ? entry + 8 : u32(entry + 8);
+    if (!contains(valueOffset, count))
+      return false;
+    const char *text = reinterpret_cast<const char *>(m_tiff + valueOffset);
+    const void *nul = std::memchr(text, '\0', count);
+    const qsizetype length =
+        nul ? static_cast<const char *>(nul) - text : qsizetype(count);
+    out = QString::fromLatin1(text, length).trimmed();
+    return true;
+  }
+
+  /**
+   * @brief Resolve an IFD pointer entry.
+   */
+  std::optional<qint64> pointer(qint64 entry, quint16 type) const {
+    if (type != kTypeLong && type != kTypeIfd)
+      return std::nullopt;
+    return qint64(u32(entry + 8));
+  }
+
+  /**
+   * @brief File offset of an entry's value if it has the expected shape.
+   * @return Offset, or -1 on a type/count mismatch
+   */
+  qint64 valueLocation(qint64 entry, quint16 type, quint32 count,
+                       quint16 expectedType, quint32 expectedCount,
+                       qint64 typeSize) const {
+    if (type != expectedType || count != expectedCount)
+      return -1;
+    const qint64 bytes = typeSize * count;
+    const qint64 valueOffset = bytes <= 4 ? entry + 8 : u32(entry + 8);
+    if (!contains(valueOffset, bytes))
+      return -1;
+    return m_fileOffset + valueOffset;
+  }
+
+private:
+  const uchar *m_tiff;
+  qint64 m_size;
+  qint64 m_fileOffset; // Position of the TIFF header in the file
+  bool m_littleEndian = true;
+};
+
+std::optional<ExifProbeResult> parseTiff(const uchar *tiff, qint64 size,
+                                        qint64 fileOffset) {
+  TiffReader reader(tiff, size, fileOffset);
+  if (!reader.init())
+    return std::nullopt;
+
+  ExifProbeResult result;
+  result.gpsLayout.littleEndian = reader.littleEndian();
+  std::optional<qint64> exifIfd;
+  std::optional<qint64> gpsIfd;
+
+  const bool ifd0Ok = reader.forEachEntry(
+      reader.u32(4), [&](qint64 entry, quint16 tag, quint16 type, quint32 count) {
+        switch (tag) {
+        case kTagDateTime:
+          return reader.ascii(entry, type, count, result.dateTimes[3]);
+        case kTagDateTimeOriginal:
+          return reader.ascii(entry, type, count, result.dateTimes[1]);
+        case kTagExifIfd:
+          exifIfd = reader.pointer(entry, type);
+          return true;
+        case kTagGpsIfd:
+          gpsIfd = reader.pointer(entry, type);
+          return true;
+        default:
+          return true;
+        }
+      });
+  if (!ifd0Ok)
+    return std::nullopt;
+
+  if (exifIfd) {
+    const bool exifOk = reader.forEachEntry(
+        *exifIfd,
+        [&](qint64 entry, quint16 tag, quint16 type, quint32 count) {
+          switch (tag) {
+          case kTagDateTimeOriginal:
+            return reader.ascii(entry, type, count, result.dateTimes[0]);
+          case kTagDateTimeDigitized:
+            return reader.ascii(entry, type, count, result.dateTimes[2]);
+          case kTagSubSecTimeOriginal:
+            return reader.ascii(entry, type, count, result.subSecTimeOriginal);
+          case kTagOffsetTimeOriginal:
+            return reader.ascii(entry, type, count, result.offsetTimeOriginal);
+          default:
+            return true;
+          }
+        });
+    if (!exifOk)
+      return std::nullopt;
+  }
+
+  if (gpsIfd) {
+    bool hasLat = false;
+    bool hasLon = false;
+    GpsValueLayout &layout = result.gpsLayout;
+    const bool gpsOk = reader.forEachEntry(
+        *gpsIfd, [&](qint64 entry, quint16 tag, quint16 type, quint32 count) {
+          switch (tag) {
+          case kTagGpsLatitudeRef:
+            layout.latitudeRef =
+                reader.valueLocation(entry, type, count, kTypeAscii, 2, 1);
+            break;
+          case kTagGpsLatitude:
+            hasLat = true;
+            layout.latitude =
+                reader.valueLocation(entry, type, count, kTypeRational, 3, 8);
+            break;
+          case kTagGpsLongitudeRef:
+            layout.longitudeRef =
+                reader.valueLocation(entry, type, count, kTypeAscii, 2, 1);
+            break;
+          case kTagGpsLongitude:
+            hasLon = true;
+            layout.longitude =
+                reader.valueLocation(entry, type, count, kTypeRational, 3, 8);
+            break;
+          case kTagGpsAltitudeRef:
+            layout.altitudeRef =
+                reader.valueLocation(entry, type, count, kTypeByte, 1, 1);
+            break;
+          case kTagGpsAltitude:
+            layout.altitude =
+                reader.valueLocation(entry, type, count, kTypeRational, 1, 8);
+            break;
+          default:
+            break;
+          }
+          return true;
+        });
+    if (!gpsOk)
+      return std::nullopt;
+    result.hasGps = hasLat && hasLon;
+  }
+
+  return result;
+}
+
+std::optional<ExifProbeResult> parseJpeg(const uchar *data, qint64 size) {
+  static const char kExifHeader[] = "Exif\0\0";
+
+  qint64 pos = 2;
+  while (pos + 4 <= size) {
+    if (data[pos] != 0xFF)
+      return std::nullopt;
+    const uchar marker = data[pos + 1];
+    if (marker == 0xFF) {
+      ++pos; // Fill byte
+      continue;
+    }
+    if (marker == 0xDA || marker == 0xD9) {
+      // Start of scan or end of image: there is no Exif segment
+      return ExifProbeResult();
+    }
+
+    const qint64 length = (qint64(data[pos + 2]) << 8) | data[pos + 3];
+    if (length < 2)
+      return std::nullopt;
+    const qint64 payload = pos + 4;
+    if (marker == 0xE1 && length >= 8 && payload + 6 <= size &&
+        std::memcmp(data + payload, kExifHeader, 6) == 0) {
+      const qint64 tiffSize = std::min(length - 8, size - payload - 6);
+      return parseTiff(data + payload + 6, tiffSize, payload + 6);
+    }
+    pos += 2 + length;
+  }
+  return std::nullopt; // Truncated before the Exif segment
+}
+
+} // namespace
+
+std::optional<QDateTime>
+ExifProbeResult::captureTime(double timeOffsetSeconds) const {
+  for (int i = 0; i < 4; ++i) {
+    if (dateTimes[i].isEmpty())
+      continue;
+    auto dt = ExifHandler::parseExifDateTime(
+        dateTimes[i], i == 0 ? subSecTimeOriginal : QString(),
+        timeOffsetSeconds);
+    if (dt.has_value())
+      return dt;
+  }
+  return std::nullopt;
+}
+
+std::optional<ExifProbeResult> FastExifProbe::probe(const QString &filePath) {
+  ScopedTimer timer(PerfStage::Probe);
+
+  // Large local files: only the pages the IFD walk touches are read
+  if (auto mapping = MappedFile::open(filePath, kMaxProbeBytes)) {
+    PerfTrace::addBytesRead(mapping->size());
+    return probeBuffer(mapping->data(), mapping->size());
+  }
+
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly))
+    return std::nullopt;
+
+  // Check the magic before paying for the bounded read
+  QByteArray head = file.read(4);
+  const bool jpeg = head.startsWith("\xFF\xD8");
+  const bool tiff = head == QByteArray("II*\0", 4) || head == QByteArray("MM\0*", 4);
+  if (!jpeg && !tiff)
+    return std::nullopt;
+
+  head += file.read(kMaxProbeBytes - head.size());
+  PerfTrace::addBytesRead(head.size());
+  return probeBuffer(reinterpret_cast<const uchar *>(head.constData()),
+                     head.size());
+}
+
+std::optional<ExifProbeResult> FastExifProbe::probeBuffer(const uchar *data,
+                                                          qint64 size) {
+  if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8)
+    return parseJpeg(data, size);
+  return parseTiff(data, size, 0);
+}
+
+} // namespace lyp
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QDateTime>
+#include <QString>
+#include <optional>
+
+namespace lyp {
+
+/**
+ * @brief File offsets of existing GPS values, for patching in place.
+ *
+ * Offsets point at the value bytes; -1 means the tag is missing or does
+ * not have the layout the writer produces.
+ */
+struct GpsValueLayout {
+  bool littleEndian = true;
+  qint64 latitudeRef = -1;  // ASCII[2], inline
+  qint64 latitude = -1;     // RATIONAL[3]
+  qint64 longitudeRef = -1; // ASCII[2], inline
+  qint64 longitude = -1;    // RATIONAL[3]
+  qint64 altitudeRef = -1;  // BYTE[1], inline
+  qint64 altitude = -1;     // RATIONAL[1]
+
+  /**
+   * @brief Check if every value a write would change can be patched.
+   * @param withElevation Whether the altitude will be written too
+   */
+  bool canPatch(bool withElevation) const {
+    return latitudeRef >= 0 && latitude >= 0 && longitudeRef >= 0 &&
+           longitude >= 0 &&
+           (!withElevation || (altitudeRef >= 0 && altitude >= 0));
+  }
+};
+
+/**
+ * @brief Capture time and GPS presence read straight from the TIFF IFDs.
+ */
+struct ExifProbeResult {
+  // Date candidates in ExifHandler's lookup order: Photo.DateTimeOriginal,
+  // Image.DateTimeOriginal, Photo.DateTimeDigitized, Image.DateTime
+  QString dateTimes[4];
+  QString subSecTimeOriginal; // Exif 0x9291
+  QString offsetTimeOriginal; // Exif 0x9011, informational only
+  bool hasGps = false;        // GPSLatitude and GPSLongitude present
+  GpsValueLayout gpsLayout;
+
+  /**
+   * @brief Capture time in UTC, using the same rules as the exiv2 path.
+   * @param timeOffsetSeconds Camera offset from UTC to subtract
+   */
+  std::optional<QDateTime> captureTime(double timeOffsetSeconds) const;
+};
+
+/**
+ * @brief Fast metadata probe that avoids a full exiv2 decode.
+ *
+ * Reads at most kMaxProbeBytes from the start of the file and walks only
+ * IFD0, the Exif IFD and the GPS IFD of a JPEG APP1 or bare TIFF structure
+ * (TIFF, DNG and most TIFF-based RAW files). Maker notes, IPTC and XMP are
+ * never touched. Large files on local disks are probed through a memory
+ * mapping of that prefix. Callers fall back to exiv2 when the probe gives up.
+ */
+class FastExifProbe {
+public:
+  static constexpr qint64 kMaxProbeBytes = 512 * 1024;
+
+  /**
+   * @brief Probe a file.
+   * @param filePath Path to the photo file
+   * @return Result, or nullopt if the layout is unsupported or truncated
+   */
+  static std::optional<ExifProbeResult> probe(const QString &filePath);
+
+  /**
+   * @brief Probe an in-memory file prefix.
+   * @param data Start of the file
+   * @param size Number of bytes available
+   */
+  static std::optional<ExifProbeResult> probeBuffer(const uchar *data,
+                                                    qint64 size);
+};
+
+} // namespace lyp
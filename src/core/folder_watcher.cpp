@@ -0,0 +1,202 @@
+#include "folder_watcher.h"
+#include "exif_handler.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <algorithm>
+
+namespace lyp {
+
+namespace {
+
+// How often files that have not settled yet are looked at again
+constexpr int kPollIntervalMs = 100;
+
+// Writers on some systems keep the file locked until they are done
+bool isReadable(const QString &path) {
+  QFile file(path);
+  return file.open(QIODevice::ReadOnly);
+}
+
+} // namespace
+
+FolderWatcher::FolderWatcher(QObject *parent)
+    : QObject(parent), m_watcher(new QFileSystemWatcher(this)),
+      m_pollTimer(new QTimer(this)) {
+  m_clock.start();
+  m_pollTimer->setInterval(kPollIntervalMs);
+  connect(m_pollTimer, &QTimer::timeout, this, &FolderWatcher::checkPending);
+  connect(m_watcher, &QFileSystemWatcher::directoryChanged, this,
+          &FolderWatcher::onDirectoryChanged);
+  connect(m_watcher, &QFileSystemWatcher::fileChanged, this,
+          &FolderWatcher::onFileChanged);
+}
+
+bool FolderWatcher::watchDirectories(const QStringList &directories,
+                                     bool includeExisting) {
+  bool watching = true;
+  for (const QString &directory : directories) {
+    const QString root = QFileInfo(directory).absoluteFilePath();
+    if (!watchTree(root, includeExisting)) {
+      qWarning() << "Cannot watch directory" << root;
+      watching = false;
+    }
+  }
+  return watching;
+}
+
+void FolderWatcher::watchFiles(const QStringList &filePaths) {
+  for (const QString &filePath : filePaths) {
+    const QString path = QFileInfo(filePath).absoluteFilePath();
+    if (!m_watcher->addPath(path)) {
+      qWarning() << "Cannot watch file" << path;
+    }
+  }
+}
+
+bool FolderWatcher::watchTree(const QString &root, bool reportFiles) {
+  QStringList directories{root};
+  bool rootWatched = false;
+
+  while (!directories.isEmpty()) {
+    const QString path = directories.takeLast();
+    if (m_directories.contains(path)) {
+      rootWatched |= path == root;
+      continue;
+    }
+    if (!m_watcher->addPath(path))
+      continue;
+    m_directories.insert(path);
+    rootWatched |= path == root;
+
+    // Entries are listed after the watch is set, so none can slip between
+    const QFileInfoList entries =
+        QDir(path).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+    for (const QFileInfo &entry : entries) {
+      if (entry.isDir()) {
+        if (!entry.isSymLink()) {
+          directories.append(entry.absoluteFilePath());
+        }
+      } else if (entry.isFile()) {
+        addPhoto(entry.absoluteFilePath(), reportFiles);
+      }
+    }
+  }
+  return rootWatched;
+}
+
+void FolderWatcher::addPhoto(const QString &path, bool report) {
+  if (m_seen.contains(path) || !ExifHandler::isSupported(path))
+    return;
+
+  m_seen.insert(path);
+  if (report) {
+    addPending(path, false);
+  }
+}
+
+void FolderWatcher::addPending(const QString &path, bool watchedFile) {
+  if (!m_pending.contains(path)) {
+    Pending pending;
+    pending.watchedFile = watchedFile;
+    m_pending.insert(path, pending);
+  }
+  if (!m_pollTimer->isActive()) {
+    m_pollTimer->start();
+  }
+}
+
+void FolderWatcher::onDirectoryChanged(const QString &path) {
+  const QDir dir(path);
+  if (!dir.exists()) {
+    m_directories.remove(path);
+    m_watcher->removePath(path);
+    return;
+  }
+
+  const QFileInfoList entries =
+      dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+  for (const QFileInfo &entry : entries) {
+    const QString entryPath = entry.absoluteFilePath();
+    if (entry.isDir()) {
+      // A new subdirectory may arrive with files, e.g. a copied card folder
+      if (!entry.isSymLink() && !m_directories.contains(entryPath)) {
+        watchTree(entryPath, true);
+      }
+    } else if (entry.isFile()) {
+      addPhoto(entryPath, true);
+    }
+  }
+}
+
+void FolderWatcher::onFileChanged(const QString &path) {
+  addPending(path, true);
+}
+
+void FolderWatcher::checkPending() {
+  const qint64 nowMs = m_clock.elapsed();
+  QStringList arrived;
+  QStringList changed;
+
+  for (auto it = m_pending.begin(); it != m_pending.end();) {
+    const QString path = it.key();
+    Pending &pending = it.value();
+    const QFileInfo info(path);
+
+    if (!info.exists()) {
+      if (pending.watchedFile) {
+        // Removed on the way to being replaced; wait for the new file
+        ++it;
+        continue;
+      }
+      // Deleted or renamed before it settled; a new name is a new file
+      m_seen.remove(path);
+      it = m_pending.erase(it);
+      continue;
+    }
+
+    const qint64 size = info.size();
+    const qint64 modifiedMs = info.lastModified().toMSecsSinceEpoch();
+    if (size != pending.size || modifiedMs != pending.modifiedMs) {
+      pending.size = size;
+      pending.modifiedMs = modifiedMs;
+      pending.stableSinceMs = nowMs;
+      ++it;
+      continue;
+    }
+    if (size == 0 || nowMs - pending.stableSinceMs < m_settleMs ||
+        !isReadable(path)) {
+      ++it;
+      continue;
+    }
+
+    if (pending.watchedFile) {
+      // A replaced file drops out of the watcher
+      if (!m_watcher->files().contains(path)) {
+        m_watcher->addPath(path);
+      }
+      changed.append(path);
+    } else {
+      arrived.append(path);
+    }
+    it = m_pending.erase(it);
+  }
+
+  if (m_pending.isEmpty()) {
+    m_pollTimer->stop();
+  }
+  if (!changed.isEmpty()) {
+    std::sort(changed.begin(), changed.end());
+    emit filesChanged(changed);
+  }
+  if (!arrived.isEmpty()) {
+    std::sort(arrived.begin(), arrived.end());
+    emit filesArrived(arrived);
+  }
+}
+
+} // namespace lyp
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+namespace lyp {
+
+/**
+ * @brief Watches directory trees for photos that have finished arriving.
+ *
+ * Directories are watched with QFileSystemWatcher, including subdirectories
+ * created later. A new supported file is only reported once its size and
+ * modification time have stayed the same for the settle time and it can be
+ * opened, so photos still being copied or written by a tethering tool are
+ * never read half-written. Single files, such as a GPX log that is still
+ * recording, can be watched too; their changes are settled the same way.
+ * Hidden entries and symlinked directories are skipped, and each photo is
+ * reported once.
+ */
+class FolderWatcher : public QObject {
+  Q_OBJECT
+
+public:
+  /**
+   * @brief Default time a file must stay unchanged before it is reported.
+   */
+  static constexpr int kDefaultSettleMs = 500;
+
+  explicit FolderWatcher(QObject *parent = nullptr);
+
+  /**
+   * @brief Start watching directories and everything below them.
+   * @param directories Root directories
+   * @param includeExisting Also report supported files already there
+   * @return false if a directory could not be watched
+   */
+  bool watchDirectories(const QStringList &directories, bool includeExisting);
+
+  /**
+   * @brief Report changes to single files through filesChanged().
+   *
+   * A file that is replaced rather than rewritten in place stays watched.
+   * @param filePaths Files to watch
+   */
+  void watchFiles(const QStringList &filePaths);
+
+  /**
+   * @brief Set how long a file must stay unchanged before it is reported.
+   */
+  void setSettleTime(int msecs) { m_settleMs = msecs; }
+  int settleTime() const { return m_settleMs; }
+
+  /**
+   * @brief Number of files seen but not yet settled.
+   */
+  int pendingCount() const { return m_pending.size(); }
+
+signals:
+  /**
+   * @brief Emitted with new supported files that have finished arriving.
+   * @param filePaths Absolute file paths, sorted
+   */
+  void filesArrived(const QStringList &filePaths);
+
+  /**
+   * @brief Emitted once changes to watched files have settled.
+   * @param filePaths Watched files that changed
+   */
+  void filesChanged(const QStringList &filePaths);
+
+private:
+  struct Pending {
+    qint64 size = -1;
+    qint64 modifiedMs = -1;
+    qint64 stableSinceMs = 0;
+    bool watchedFile = false; // From watchFiles() rather than a new photo
+  };
+
+  bool watchTree(const QString &root, bool reportFiles);
+  void addPhoto(const QString &path, bool report);
+  void addPending(const QString &path, bool watchedFile);
+  void onDirectoryChanged(const QString &path);
+  void onFileChanged(const QString &path);
+  void checkPending();
+
+  QFileSystemWatcher *m_watcher;
+  QTimer *m_pollTimer;
+  QElapsedTimer m_clock;
+  QSet<QString> m_directories;
+  QSet<QString> m_seen; // Photos reported or waiting to settle
+  QHash<QString, Pending> m_pending;
+  int m_settleMs = kDefaultSettleMs;
+};
+
+} // namespace lyp
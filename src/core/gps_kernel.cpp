@@ -0,0 +1,54 @@
+#include "gps_kernel.h"
+
+namespace lyp {
+
+namespace {
+
+// One loop per output column over restrict-qualified parameters, which is
+// what lets the compiler vectorise without runtime aliasing checks
+
+void lerpColumn(const double *__restrict from, const double *__restrict to,
+                const double *__restrict ratio, double *__restrict out,
+                int count) {
+  for (int i = 0; i < count; ++i) {
+    out[i] = GpsKernel::lerp(from[i], to[i], ratio[i]);
+  }
+}
+
+} // namespace
+
+void InterpolationBatch::reserve(int count) {
+  for (std::vector<double> *column :
+       {&ratio, &latitudeBefore, &latitudeAfter, &longitudeBefore,
+        &longitudeAfter, &elevationBefore, &elevationAfter}) {
+    column->reserve(count);
+  }
+}
+
+void InterpolationBatch::append(double t, double latBefore, double latAfter,
+                                double lonBefore, double lonAfter,
+                                double eleBefore, double eleAfter) {
+  ratio.push_back(t);
+  latitudeBefore.push_back(latBefore);
+  latitudeAfter.push_back(latAfter);
+  longitudeBefore.push_back(lonBefore);
+  longitudeAfter.push_back(lonAfter);
+  elevationBefore.push_back(eleBefore);
+  elevationAfter.push_back(eleAfter);
+}
+
+void GpsKernel::interpolate(const InterpolationBatch &batch,
+                            GpsPositionBatch &out) {
+  const int count = batch.size();
+  out.latitude.resize(count);
+  out.longitude.resize(count);
+  out.elevation.resize(count);
+  lerpColumn(batch.latitudeBefore.data(), batch.latitudeAfter.data(),
+             batch.ratio.data(), out.latitude.data(), count);
+  lerpColumn(batch.longitudeBefore.data(), batch.longitudeAfter.data(),
+             batch.ratio.data(), out.longitude.data(), count);
+  lerpColumn(batch.elevationBefore.data(), batch.elevationAfter.data(),
+             batch.ratio.data(), out.elevation.data(), count);
+}
+
+} // namespace lyp
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace lyp {
+
+/**
+ * @brief Endpoints of a batch of track interpolations, one entry per photo.
+ *
+ * Structure of arrays, so the kernel loops run over plain doubles. A
+ * single-point match has equal endpoints and ratio 0. Missing elevations
+ * are NaN, which the arithmetic carries through without a branch.
+ */
+struct InterpolationBatch {
+  std::vector<double> ratio;
+  std::vector<double> latitudeBefore;
+  std::vector<double> latitudeAfter;
+  std::vector<double> longitudeBefore;
+  std::vector<double> longitudeAfter;
+  std::vector<double> elevationBefore;
+  std::vector<double> elevationAfter;
+
+  int size() const { return static_cast<int>(ratio.size()); }
+  void reserve(int count);
+  void append(double t, double latBefore, double latAfter, double lonBefore,
+              double lonAfter, double eleBefore, double eleAfter);
+};
+
+/**
+ * @brief Interpolated positions; elevation is NaN where it is unknown.
+ */
+struct GpsPositionBatch {
+  std::vector<double> latitude;
+  std::vector<double> longitude;
+  std::vector<double> elevation;
+
+  int size() const { return static_cast<int>(latitude.size()); }
+};
+
+/**
+ * @brief Interpolation and EXIF encoding arithmetic.
+ *
+ * The scalar helpers are what the per-photo paths use. The batch
+ * interpolation runs the same expression over whole arrays in loops the
+ * compiler can vectorise, so both produce identical values.
+ */
+class GpsKernel {
+public:
+  /**
+   * @brief Denominator of the DMS seconds rational (1/10000 s).
+   */
+  static constexpr uint32_t kSecondsDenominator = 10000;
+
+  /**
+   * @brief Denominator of the altitude rational (centimetres).
+   */
+  static constexpr uint32_t kAltitudeDenominator = 100;
+
+  /**
+   * @brief Degrees, minutes and seconds numerators of one coordinate.
+   */
+  struct Dms {
+    uint32_t degrees;
+    uint32_t minutes;
+    uint32_t seconds; // In 1/kSecondsDenominator
+  };
+
+  static double lerp(double from, double to, double ratio) {
+    return from + (to - from) * ratio;
+  }
+
+  /**
+   * @brief Convert decimal degrees to truncated DMS numerators.
+   */
+  static Dms toDms(double decimal) {
+    decimal = std::abs(decimal);
+    const int deg = static_cast<int>(decimal);
+    const double minDecimal = (decimal - deg) * 60.0;
+    const int min = static_cast<int>(minDecimal);
+    const double sec = (minDecimal - min) * 60.0;
+    return {static_cast<uint32_t>(deg), static_cast<uint32_t>(min),
+            static_cast<uint32_t>(static_cast<int>(sec * kSecondsDenominator))};
+  }
+
+  /**
+   * @brief Convert an elevation to the altitude numerator; NaN gives 0.
+   */
+  static uint32_t toAltitude(double elevation) {
+    // NaN is the only value that compares unequal to itself
+    constexpr double kMax = std::numeric_limits<int>::max();
+    double centimetres = std::abs(elevation) * kAltitudeDenominator;
+    centimetres = centimetres == centimetres ? centimetres : 0.0;
+    centimetres = centimetres < kMax ? centimetres : kMax;
+    return static_cast<uint32_t>(static_cast<int>(centimetres));
+  }
+
+  /**
+   * @brief Interpolate every entry of a batch in one pass.
+   * @param batch Endpoints and ratios
+   * @param out Positions, resized to the batch size
+   */
+  static void interpolate(const InterpolationBatch &batch,
+                          GpsPositionBatch &out);
+};
+
+} // namespace lyp
@@ -1,90 +1,259 @@
 #include "gps_matcher.h"
+#include "gps_kernel.h"
+#include <QTimeZone>
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
 
 namespace lyp {
 
-GpsMatcher::GpsMatcher(const QVector<TrackPoint>& trackpoints, 
+GpsMatcher::GpsMatcher(TrackSetPtr tracks,
                        double maxTimeDiffSeconds,
                        bool forceInterpolate)
-    : m_trackpoints(trackpoints)
+    : m_tracks(tracks ? std::move(tracks) : TrackSet::build({}, {}))
     , m_maxTimeDiff(maxTimeDiffSeconds)
     , m_forceInterpolate(forceInterpolate)
 {
 }
 
-std::optional<std::tuple<double, double, std::optional<double>>> 
-GpsMatcher::findGpsForPhoto(const QDateTime& photoTime) const
+GpsMatcher::GpsMatcher(TrackStorePtr track, 
+                       double maxTimeDiffSeconds,
+                       bool forceInterpolate)
+    : GpsMatcher(TrackSet::fromTrack(std::move(track)), maxTimeDiffSeconds, forceInterpolate)
+{
+}
+
+std::optional<GpsMatch> GpsMatcher::findGpsForPhoto(const QDateTime& photoTime) const
+{
+    return findGpsForTime(photoTime.toMSecsSinceEpoch());
+}
+
+std::optional<GpsMatch> GpsMatcher::findGpsForTime(qint64 photoTimeMs) const
 {
-    if (m_trackpoints.isEmpty()) {
+    if (m_tracks->isEmpty()) {
         return std::nullopt;
     }
     
-    // Find the two closest trackpoints (before and after)
-    const TrackPoint* before = nullptr;
-    const TrackPoint* after = nullptr;
+    const int spanIndex = m_tracks->findSpan(photoTimeMs);
+    if (spanIndex < 0 || photoTimeMs > m_tracks->spans()[spanIndex].endMs) {
+        return evaluate(matchAfterSpan(spanIndex, photoTimeMs));
+    }
+    
+    // First trackpoint of the owning segment strictly after the photo time
+    const TrackSegment& segment = m_tracks->segmentOf(m_tracks->spans()[spanIndex]);
+    const std::vector<qint64>& times = m_tracks->trackOf(segment).timesMs();
+    auto it = std::upper_bound(times.begin() + segment.first,
+                               times.begin() + segment.last + 1, photoTimeMs);
+    return evaluate(matchInSegment(segment, static_cast<int>(it - times.begin()),
+                                   photoTimeMs));
+}
+
+QVector<std::optional<GpsMatch>>
+GpsMatcher::findGpsForPhotos(const QVector<qint64>& photoTimesMs) const
+{
+    QVector<std::optional<GpsMatch>> results;
+    results.reserve(photoTimesMs.size());
+    
+    if (m_tracks->isEmpty()) {
+        results.fill(std::nullopt, photoTimesMs.size());
+        return results;
+    }
+    
+    // The cursors below only move forward, so match unsorted times in order
+    if (!std::is_sorted(photoTimesMs.begin(), photoTimesMs.end())) {
+        QVector<int> order(photoTimesMs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&photoTimesMs](int a, int b) {
+            return photoTimesMs[a] < photoTimesMs[b];
+        });
+        QVector<qint64> sortedTimesMs;
+        sortedTimesMs.reserve(order.size());
+        for (int i : order) {
+            sortedTimesMs.append(photoTimesMs[i]);
+        }
+        const QVector<std::optional<GpsMatch>> sorted = findGpsForPhotos(sortedTimesMs);
+        results.resize(photoTimesMs.size());
+        for (int k = 0; k < order.size(); ++k) {
+            results[order[k]] = sorted[k];
+        }
+        return results;
+    }
     
-    for (int i = 0; i < m_trackpoints.size(); ++i) {
-        if (m_trackpoints[i].timestamp <= photoTime) {
-            before = &m_trackpoints[i];
-        } else {
-            after = &m_trackpoints[i];
-            break;
+    // Walk spans, and points within the current span, with forward-only cursors
+    const std::vector<TrackSpan>& spans = m_tracks->spans();
+    const int spanCount = static_cast<int>(spans.size());
+    std::vector<MatchPlan> plans;
+    plans.reserve(photoTimesMs.size());
+    int spanIndex = -1;
+    int cursorSpan = -1;
+    int cursor = 0;
+    for (qint64 photoTimeMs : photoTimesMs) {
+        while (spanIndex + 1 < spanCount && spans[spanIndex + 1].startMs <= photoTimeMs) {
+            ++spanIndex;
         }
+        if (spanIndex < 0 || photoTimeMs > spans[spanIndex].endMs) {
+            plans.push_back(matchAfterSpan(spanIndex, photoTimeMs));
+            continue;
+        }
+        
+        const TrackSegment& segment = m_tracks->segmentOf(spans[spanIndex]);
+        const std::vector<qint64>& times = m_tracks->trackOf(segment).timesMs();
+        if (cursorSpan != spanIndex) {
+            // Spans may start mid-segment; jump there once
+            cursorSpan = spanIndex;
+            cursor = static_cast<int>(std::upper_bound(times.begin() + segment.first,
+                                                       times.begin() + segment.last + 1,
+                                                       photoTimeMs) - times.begin());
+        }
+        while (cursor <= segment.last && times[cursor] <= photoTimeMs) {
+            ++cursor;
+        }
+        plans.push_back(matchInSegment(segment, cursor, photoTimeMs));
     }
     
-    // Handle edge cases
-    if (!before) {
-        // Photo is before first trackpoint
-        double timeDiff = m_trackpoints.first().timestamp.toMSecsSinceEpoch() / 1000.0 
-                        - photoTime.toMSecsSinceEpoch() / 1000.0;
-        if (m_forceInterpolate || timeDiff <= m_maxTimeDiff) {
-            const auto& p = m_trackpoints.first();
-            return std::make_tuple(p.latitude, p.longitude, p.elevation);
+    // Gather the endpoints, then interpolate every match in one pass
+    auto elevationAt = [](const TrackStore& track, int index) {
+        return track.hasElevation(index)
+            ? static_cast<double>(track.elevations()[index])
+            : std::numeric_limits<double>::quiet_NaN();
+    };
+    InterpolationBatch batch;
+    batch.reserve(static_cast<int>(plans.size()));
+    for (const MatchPlan& plan : plans) {
+        if (plan.isValid()) {
+            const TrackStore& before = *plan.beforeTrack;
+            const TrackStore& after = *plan.afterTrack;
+            batch.append(plan.ratio,
+                         before.latitude(plan.before), after.latitude(plan.after),
+                         before.longitude(plan.before), after.longitude(plan.after),
+                         elevationAt(before, plan.before), elevationAt(after, plan.after));
         }
-        return std::nullopt;
     }
+    GpsPositionBatch positions;
+    GpsKernel::interpolate(batch, positions);
     
-    if (!after) {
-        // Photo is after last trackpoint
-        double timeDiff = photoTime.toMSecsSinceEpoch() / 1000.0 
-                        - m_trackpoints.last().timestamp.toMSecsSinceEpoch() / 1000.0;
-        if (m_forceInterpolate || timeDiff <= m_maxTimeDiff) {
-            const auto& p = m_trackpoints.last();
-            return std::make_tuple(p.latitude, p.longitude, p.elevation);
+    int next = 0;
+    for (const MatchPlan& plan : plans) {
+        if (!plan.isValid()) {
+            results.append(std::nullopt);
+            continue;
         }
-        return std::nullopt;
+        std::optional<double> elevation;
+        if (!std::isnan(positions.elevation[next])) {
+            elevation = positions.elevation[next];
+        }
+        results.append(std::make_tuple(positions.latitude[next], positions.longitude[next],
+                                       elevation));
+        ++next;
+    }
+    
+    return results;
+}
+
+GpsMatcher::MatchPlan GpsMatcher::matchInSegment(const TrackSegment& segment, int afterIndex,
+                                                 qint64 photoTimeMs) const
+{
+    const TrackStore& track = m_tracks->trackOf(segment);
+    
+    // Spans never extend past their segment, so this is the segment's last
+    // point at exactly the photo time
+    if (afterIndex > segment.last) {
+        return nearestPoint(track, segment.last, photoTimeMs);
+    }
+    Q_ASSERT(afterIndex > segment.first);
+    return interpolate(track, afterIndex - 1, track, afterIndex, photoTimeMs);
+}
+
+GpsMatcher::MatchPlan GpsMatcher::matchAfterSpan(int spanIndex, qint64 photoTimeMs) const
+{
+    const std::vector<TrackSpan>& spans = m_tracks->spans();
+    
+    // Photo is before the first trackpoint
+    if (spanIndex < 0) {
+        const TrackSegment& first = m_tracks->segmentOf(spans.front());
+        return nearestPoint(m_tracks->trackOf(first), first.first, photoTimeMs);
     }
     
+    // Uncovered time only follows a span that ends its segment
+    const TrackSegment& before = m_tracks->segmentOf(spans[spanIndex]);
+    const TrackStore& beforeTrack = m_tracks->trackOf(before);
+    
+    // Photo is after the last trackpoint
+    if (spanIndex + 1 >= static_cast<int>(spans.size())) {
+        return nearestPoint(beforeTrack, before.last, photoTimeMs);
+    }
+    
+    // In a gap between segments, possibly of different sources. The track
+    // says nothing about the path taken, so only a nearby end point counts
+    const TrackSegment& after = m_tracks->segmentOf(spans[spanIndex + 1]);
+    const TrackStore& afterTrack = m_tracks->trackOf(after);
+    if (m_forceInterpolate) {
+        return interpolate(beforeTrack, before.last, afterTrack, after.first, photoTimeMs);
+    }
+    if (photoTimeMs - beforeTrack.timeMs(before.last) <=
+        afterTrack.timeMs(after.first) - photoTimeMs) {
+        return nearestPoint(beforeTrack, before.last, photoTimeMs);
+    }
+    return nearestPoint(afterTrack, after.first, photoTimeMs);
+}
+
+GpsMatcher::MatchPlan GpsMatcher::interpolate(const TrackStore& beforeTrack, int before,
+                                              const TrackStore& afterTrack, int after,
+                                              qint64 photoTimeMs) const
+{
+    const qint64 beforeMs = beforeTrack.timeMs(before);
+    const qint64 afterMs = afterTrack.timeMs(after);
+    
     // Calculate time differences
-    double timeDiffBefore = photoTime.toMSecsSinceEpoch() / 1000.0 
-                          - before->timestamp.toMSecsSinceEpoch() / 1000.0;
-    double timeDiffAfter = after->timestamp.toMSecsSinceEpoch() / 1000.0 
-                         - photoTime.toMSecsSinceEpoch() / 1000.0;
+    double timeDiffBefore = (photoTimeMs - beforeMs) / 1000.0;
+    double timeDiffAfter = (afterMs - photoTimeMs) / 1000.0;
     
     // Check if within acceptable time range
     if (!m_forceInterpolate && 
         std::min(timeDiffBefore, timeDiffAfter) > m_maxTimeDiff) {
-        return std::nullopt;
+        return MatchPlan();
     }
     
     // Linear interpolation
-    double totalTime = after->timestamp.toMSecsSinceEpoch() / 1000.0 
-                     - before->timestamp.toMSecsSinceEpoch() / 1000.0;
+    double totalTime = (afterMs - beforeMs) / 1000.0;
     
     if (totalTime <= 0) {
         // Exact match or very close points
-        return std::make_tuple(before->latitude, before->longitude, before->elevation);
+        return MatchPlan{&beforeTrack, before, &beforeTrack, before, 0.0};
     }
     
-    double ratio = timeDiffBefore / totalTime;
+    return MatchPlan{&beforeTrack, before, &afterTrack, after, timeDiffBefore / totalTime};
+}
+
+GpsMatcher::MatchPlan GpsMatcher::nearestPoint(const TrackStore& track, int index,
+                                               qint64 photoTimeMs) const
+{
+    double timeDiff = std::abs(photoTimeMs - track.timeMs(index)) / 1000.0;
+    if (m_forceInterpolate || timeDiff <= m_maxTimeDiff) {
+        return MatchPlan{&track, index, &track, index, 0.0};
+    }
+    return MatchPlan();
+}
+
+std::optional<GpsMatch> GpsMatcher::evaluate(const MatchPlan& plan)
+{
+    if (!plan.isValid()) {
+        return std::nullopt;
+    }
     
-    double latitude = before->latitude + (after->latitude - before->latitude) * ratio;
-    double longitude = before->longitude + (after->longitude - before->longitude) * ratio;
+    const TrackStore& beforeTrack = *plan.beforeTrack;
+    const TrackStore& afterTrack = *plan.afterTrack;
+    const double latitude = GpsKernel::lerp(beforeTrack.latitude(plan.before),
+                                            afterTrack.latitude(plan.after), plan.ratio);
+    const double longitude = GpsKernel::lerp(beforeTrack.longitude(plan.before),
+                                             afterTrack.longitude(plan.after), plan.ratio);
     
     std::optional<double> elevation;
-    if (before->elevation.has_value() && after->elevation.has_value()) {
-        elevation = before->elevation.value() + 
-                   (after->elevation.value() - before->elevation.value()) * ratio;
+    if (beforeTrack.hasElevation(plan.before) && afterTrack.hasElevation(plan.after)) {
+        elevation = GpsKernel::lerp(beforeTrack.elevation(plan.before).value(),
+                                    afterTrack.elevation(plan.after).value(), plan.ratio);
     }
     
     return std::make_tuple(latitude, longitude, elevation);
@@ -92,19 +261,29 @@ GpsMatcher::findGpsForPhoto(const QDateTime& photoTime) const
 
 bool GpsMatcher::isWithinTrackRange(const QDateTime& time) const
 {
-    if (m_trackpoints.isEmpty()) {
+    if (m_tracks->isEmpty()) {
+        return false;
+    }
+    const qint64 timeMs = time.toMSecsSinceEpoch();
+    return timeMs >= m_tracks->startMs() && timeMs <= m_tracks->endMs();
+}
+
+bool GpsMatcher::isInTrackGap(const QDateTime& time) const
+{
+    if (!isWithinTrackRange(time)) {
         return false;
     }
-    return time >= m_trackpoints.first().timestamp && 
-           time <= m_trackpoints.last().timestamp;
+    const qint64 timeMs = time.toMSecsSinceEpoch();
+    return timeMs > m_tracks->spans()[m_tracks->findSpan(timeMs)].endMs;
 }
 
 std::pair<QDateTime, QDateTime> GpsMatcher::trackTimeRange() const
 {
-    if (m_trackpoints.isEmpty()) {
+    if (m_tracks->isEmpty()) {
         return {QDateTime(), QDateTime()};
     }
-    return {m_trackpoints.first().timestamp, m_trackpoints.last().timestamp};
+    return {QDateTime::fromMSecsSinceEpoch(m_tracks->startMs(), QTimeZone::utc()),
+            QDateTime::fromMSecsSinceEpoch(m_tracks->endMs(), QTimeZone::utc())};
 }
 
 } // namespace lyp
@@ -1,26 +1,50 @@
 #pragma once
 
-#include "models/track_point.h"
+#include "core/track_set.h"
+#include "models/track_store.h"
+#include <QDateTime>
 #include <QVector>
 #include <optional>
 #include <tuple>
 
 namespace lyp {
 
+/**
+ * @brief Matched GPS position: (latitude, longitude, optional elevation).
+ */
+using GpsMatch = std::tuple<double, double, std::optional<double>>;
+
 /**
  * @brief Matches photo timestamps with GPS trackpoints.
  * 
  * Uses linear interpolation to find GPS coordinates for a given timestamp.
+ * A lookup first finds the owning span of the track set in O(log S), then
+ * binary-searches that segment's sorted epoch-millisecond times, so where
+ * several tracks overlap the position always comes from the more accurate
+ * one, and interpolation never crosses a gap between segments. Batch
+ * lookups over sorted photo times walk spans and points with
+ * forward-only cursors, then interpolate every photo in one GpsKernel
+ * pass. Tracks are shared, not copied.
  */
 class GpsMatcher {
 public:
     /**
-     * @brief Construct a GPS matcher with trackpoints.
-     * @param trackpoints Sorted vector of GPS trackpoints
+     * @brief Construct a GPS matcher for a track set.
+     * @param tracks Sources with overlaps resolved
+     * @param maxTimeDiffSeconds Maximum time difference for matching
+     * @param forceInterpolate If true, always return coordinates even outside time range
+     */
+    GpsMatcher(TrackSetPtr tracks,
+               double maxTimeDiffSeconds,
+               bool forceInterpolate = false);
+    
+    /**
+     * @brief Construct a GPS matcher for a single track.
+     * @param track Track sorted by time
      * @param maxTimeDiffSeconds Maximum time difference for matching
      * @param forceInterpolate If true, always return coordinates even outside time range
      */
-    GpsMatcher(const QVector<TrackPoint>& trackpoints, 
+    GpsMatcher(TrackStorePtr track, 
                double maxTimeDiffSeconds,
                bool forceInterpolate = false);
     
@@ -29,8 +53,27 @@ public:
      * @param photoTime Photo capture time (UTC)
      * @return Tuple of (latitude, longitude, optional elevation) or nullopt if no match
      */
-    std::optional<std::tuple<double, double, std::optional<double>>> 
-    findGpsForPhoto(const QDateTime& photoTime) const;
+    std::optional<GpsMatch> findGpsForPhoto(const QDateTime& photoTime) const;
+    
+    /**
+     * @brief Find GPS coordinates for a photo timestamp in epoch milliseconds.
+     * @param photoTimeMs Photo capture time (UTC, ms since epoch)
+     * @return Matched position or nullopt if no match
+     */
+    std::optional<GpsMatch> findGpsForTime(qint64 photoTimeMs) const;
+    
+    /**
+     * @brief Match many photo timestamps in a single pass over the track.
+     *
+     * The pass needs ascending times. Sorted input is matched as it is;
+     * anything else is first ordered through an index permutation, which
+     * costs an O(n log n) sort and a copy.
+     * @param photoTimesMs Photo capture times (UTC, ms since epoch), best
+     *        sorted in ascending order
+     * @return One result per input time, in the same order
+     */
+    QVector<std::optional<GpsMatch>>
+    findGpsForPhotos(const QVector<qint64>& photoTimesMs) const;
     
     /**
      * @brief Check if a timestamp is within the GPX track time range.
@@ -39,6 +82,17 @@ public:
      */
     bool isWithinTrackRange(const QDateTime& time) const;
     
+    /**
+     * @brief Check if a timestamp falls between two segments, e.g. in a
+     *        tunnel or while the recorder was off.
+     *
+     * Without forceInterpolate, such photos only match an end point of the
+     * gap within the time threshold; they are never interpolated across it.
+     * @param time Timestamp to check
+     * @return true if inside the track range but not covered by a segment
+     */
+    bool isInTrackGap(const QDateTime& time) const;
+    
     /**
      * @brief Get the time range of the track.
      * @return Pair of (start, end) timestamps
@@ -46,7 +100,54 @@ public:
     std::pair<QDateTime, QDateTime> trackTimeRange() const;
 
 private:
-    QVector<TrackPoint> m_trackpoints;
+    /**
+     * @brief Which trackpoints a match uses and how far between them, before
+     *        any coordinate arithmetic. A single point has equal endpoints
+     *        and ratio 0; a null beforeTrack means no match.
+     */
+    struct MatchPlan {
+        const TrackStore* beforeTrack = nullptr;
+        int before = 0;
+        const TrackStore* afterTrack = nullptr;
+        int after = 0;
+        double ratio = 0.0;
+        
+        bool isValid() const { return beforeTrack != nullptr; }
+    };
+    
+    /**
+     * @brief Resolve a match inside a segment given the index of the first
+     *        point after the photo time (as returned by upper_bound).
+     */
+    MatchPlan matchInSegment(const TrackSegment& segment, int afterIndex,
+                             qint64 photoTimeMs) const;
+    
+    /**
+     * @brief Resolve a photo time past the end of a span (or, for -1,
+     *        before the first span) that no span covers.
+     */
+    MatchPlan matchAfterSpan(int spanIndex, qint64 photoTimeMs) const;
+    
+    /**
+     * @brief Interpolate between a point before and a point after the photo
+     *        time, which may belong to different tracks.
+     */
+    MatchPlan interpolate(const TrackStore& beforeTrack, int before,
+                          const TrackStore& afterTrack, int after,
+                          qint64 photoTimeMs) const;
+    
+    /**
+     * @brief Use a single point if it is close enough to the photo time.
+     */
+    MatchPlan nearestPoint(const TrackStore& track, int index,
+                           qint64 photoTimeMs) const;
+    
+    /**
+     * @brief Compute the position of a single plan (the scalar path).
+     */
+    static std::optional<GpsMatch> evaluate(const MatchPlan& plan);
+
+    TrackSetPtr m_tracks;
     double m_maxTimeDiff;
     bool m_forceInterpolate;
 };
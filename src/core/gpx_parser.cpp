@@ -1,122 +1,290 @@
 #include "gpx_parser.h"
+#include "mapped_file.h"
 #include <pugixml.hpp>
 #include <QFile>
 #include <QDebug>
+#include <QFileInfo>
 #include <QTimeZone>
 #include <algorithm>
+#include <cstring>
 
 namespace lyp {
 
-QString GpxParser::s_lastError;
 
-QVector<TrackPoint> GpxParser::parse(const QString& filePath)
+namespace {
+
+// Files written more recently than this are read rather than mapped
+constexpr qint64 kLiveFileAgeMs = 60 * 1000;
+
+bool isDigit(char c)
 {
-    s_lastError.clear();
-    QVector<TrackPoint> trackpoints;
-    
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(filePath.toUtf8().constData());
-    
-    if (!result) {
-        s_lastError = QString("Failed to parse GPX file: %1").arg(result.description());
-        qWarning() << s_lastError;
-        return trackpoints;
+    return c >= '0' && c <= '9';
+}
+
+// Parse exactly `count` digits at s[pos]; returns -1 on mismatch
+int parseDigits(const char* s, size_t len, size_t pos, int count)
+{
+    if (pos + count > len) {
+        return -1;
     }
-    
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        const char c = s[pos + i];
+        if (!isDigit(c)) {
+            return -1;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+// Length of a month (1-12) in the proleptic Gregorian calendar
+int daysInMonth(int year, int month)
+{
+    static const int kDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return month == 2 && leap ? 29 : kDays[month - 1];
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant)
+qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2 ? 1 : 0;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const int yoe = static_cast<int>(year - era * 400);
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief Fallback for timestamps the fast path does not understand.
+ */
+std::optional<qint64> parseTimeWithQt(const char* text)
+{
+    QString timeStr = QString::fromUtf8(text).trimmed();
+    // GPX uses ISO 8601 format: 2025-12-01T07:35:10Z or with offset
+    QDateTime timestamp = QDateTime::fromString(timeStr, Qt::ISODate);
+    if (!timestamp.isValid()) {
+        // Try alternative format without 'T'
+        timestamp = QDateTime::fromString(timeStr, "yyyy-MM-dd HH:mm:ss");
+    }
+    if (!timestamp.isValid()) {
+        return std::nullopt;
+    }
+    // Times without an explicit offset are UTC
+    if (timestamp.timeSpec() == Qt::LocalTime) {
+        timestamp.setTimeZone(QTimeZone::utc());
+    }
+    return timestamp.toMSecsSinceEpoch();
+}
+
+/**
+ * @brief Build a track from a parsed GPX document.
+ */
+bool collectTrackpoints(const pugi::xml_document& doc, TrackStore& track)
+{
     // GPX root element
     pugi::xml_node gpx = doc.child("gpx");
     if (!gpx) {
-        s_lastError = "Invalid GPX file: missing <gpx> root element";
-        qWarning() << s_lastError;
-        return trackpoints;
+        return false;
     }
     
     // Iterate through all tracks
     for (pugi::xml_node trk : gpx.children("trk")) {
         // Iterate through track segments
         for (pugi::xml_node trkseg : trk.children("trkseg")) {
+            track.beginSegment();
             // Iterate through track points
             for (pugi::xml_node trkpt : trkseg.children("trkpt")) {
-                TrackPoint point;
-                
                 // Parse latitude and longitude (required attributes)
-                point.latitude = trkpt.attribute("lat").as_double(0.0);
-                point.longitude = trkpt.attribute("lon").as_double(0.0);
+                const double latitude = trkpt.attribute("lat").as_double(0.0);
+                const double longitude = trkpt.attribute("lon").as_double(0.0);
+                if (latitude < -90.0 || latitude > 90.0 ||
+                    longitude < -180.0 || longitude > 180.0) {
+                    continue;
+                }
                 
-                // Parse timestamp (child element)
+                // Parse timestamp (child element); points without one are dropped
                 pugi::xml_node timeNode = trkpt.child("time");
-                if (timeNode) {
-                    QString timeStr = QString::fromUtf8(timeNode.text().get());
-                    // GPX uses ISO 8601 format: 2025-12-01T07:35:10Z or with offset
-                    point.timestamp = QDateTime::fromString(timeStr, Qt::ISODate);
-                    if (!point.timestamp.isValid()) {
-                        // Try alternative format without 'T'
-                        point.timestamp = QDateTime::fromString(timeStr, "yyyy-MM-dd HH:mm:ss");
-                    }
-                    // Ensure UTC
-                    point.timestamp.setTimeZone(QTimeZone::utc());
+                if (!timeNode) {
+                    continue;
+                }
+                std::optional<qint64> timeMs = GpxParser::parseIsoTimeMs(timeNode.text().get());
+                if (!timeMs.has_value()) {
+                    continue;
                 }
                 
                 // Parse elevation (optional child element)
+                std::optional<double> elevation;
                 pugi::xml_node eleNode = trkpt.child("ele");
                 if (eleNode) {
-                    point.elevation = eleNode.text().as_double();
+                    elevation = eleNode.text().as_double();
                 }
                 
-                // Only add valid points with timestamps
-                if (point.isValid() && point.timestamp.isValid()) {
-                    trackpoints.append(point);
-                }
+                track.append(timeMs.value(), latitude, longitude, elevation);
             }
         }
     }
+    return true;
+}
+
+} // namespace
+
+std::optional<qint64> GpxParser::parseIsoTimeMs(const char* text)
+{
+    if (!text) {
+        return std::nullopt;
+    }
+    
+    // Trim surrounding whitespace without copying
+    const char* s = text;
+    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') {
+        ++s;
+    }
+    size_t len = std::strlen(s);
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t' ||
+                       s[len - 1] == '\n' || s[len - 1] == '\r')) {
+        --len;
+    }
     
-    // Sort by timestamp
-    std::sort(trackpoints.begin(), trackpoints.end(), 
-        [](const TrackPoint& a, const TrackPoint& b) {
-            return a.timestamp < b.timestamp;
-        });
+    // Fixed layout: YYYY-MM-DDTHH:MM:SS. Anything out of range, such as
+    // 2024-02-31 or a leap second, goes to Qt, which rejects it
+    const int year = parseDigits(s, len, 0, 4);
+    const int month = parseDigits(s, len, 5, 2);
+    const int day = parseDigits(s, len, 8, 2);
+    const int hour = parseDigits(s, len, 11, 2);
+    const int minute = parseDigits(s, len, 14, 2);
+    const int second = parseDigits(s, len, 17, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 ||
+        day > daysInMonth(year, month) ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 ||
+        second < 0 || second > 59 || s[4] != '-' || s[7] != '-' ||
+        (s[10] != 'T' && s[10] != 't' && s[10] != ' ') ||
+        s[13] != ':' || s[16] != ':') {
+        return parseTimeWithQt(text);
+    }
     
-    qInfo() << "Parsed" << trackpoints.size() << "trackpoints from" << filePath;
+    size_t pos = 19;
     
-    if (!trackpoints.isEmpty()) {
-        qInfo() << "Time range:" << trackpoints.first().timestamp 
-                << "to" << trackpoints.last().timestamp;
+    // Optional fraction; keep millisecond precision
+    int millis = 0;
+    if (pos < len && (s[pos] == '.' || s[pos] == ',')) {
+        ++pos;
+        int digits = 0;
+        while (pos < len && isDigit(s[pos])) {
+            if (digits < 3) {
+                millis = millis * 10 + (s[pos] - '0');
+            }
+            ++digits;
+            ++pos;
+        }
+        if (digits == 0) {
+            return parseTimeWithQt(text);
+        }
+        for (; digits < 3; ++digits) {
+            millis *= 10;
+        }
     }
     
-    return trackpoints;
+    // Optional zone: Z, +HH:MM, +HHMM or +HH; none means UTC
+    int offsetMinutes = 0;
+    if (pos < len) {
+        if (s[pos] == 'Z' || s[pos] == 'z') {
+            ++pos;
+        } else if (s[pos] == '+' || s[pos] == '-') {
+            const int sign = s[pos] == '-' ? -1 : 1;
+            const int offsetHours = parseDigits(s, len, pos + 1, 2);
+            if (offsetHours < 0) {
+                return parseTimeWithQt(text);
+            }
+            pos += 3;
+            int offsetMins = 0;
+            if (pos < len) {
+                if (s[pos] == ':') {
+                    ++pos;
+                }
+                offsetMins = parseDigits(s, len, pos, 2);
+                if (offsetMins < 0) {
+                    return parseTimeWithQt(text);
+                }
+                pos += 2;
+            }
+            offsetMinutes = sign * (offsetHours * 60 + offsetMins);
+        }
+    }
+    if (pos != len) {
+        return parseTimeWithQt(text);
+    }
+    
+    const qint64 days = daysFromCivil(year, month, day);
+    const qint64 seconds = days * 86400 + hour * 3600 + minute * 60 + second
+                         - offsetMinutes * 60;
+    return seconds * 1000 + millis;
 }
 
-double GpxParser::calculateAverageInterval(const QVector<TrackPoint>& trackpoints)
+Result<TrackStorePtr> GpxParser::parse(const QString& filePath)
 {
-    if (trackpoints.size() < 2) {
-        return 300.0; // Default 5 minutes
+    const auto fail = [](const QString& error) {
+        qWarning() << error;
+        return Result<TrackStorePtr>::failure(error);
+    };
+    auto track = std::make_shared<TrackStore>();
+    
+    // Parse in place from a private (copy-on-write) mapping so the document
+    // neither copies the file nor allocates its strings. MappedFile only maps
+    // large files on local disks; a file that may still be recording is read
+    // too, since a logger truncating it would fault the mapping
+    std::unique_ptr<MappedFile> mapping;
+    const QDateTime modified = QFileInfo(filePath).lastModified();
+    if (modified.msecsTo(QDateTime::currentDateTime()) >= kLiveFileAgeMs) {
+        mapping = MappedFile::open(filePath, -1, true);
+    }
+    QByteArray buffer;
+    uchar* data = nullptr;
+    size_t size = 0;
+    if (mapping) {
+        data = mapping->mutableData();
+        size = static_cast<size_t>(mapping->size());
+    } else {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return fail(QString("Failed to parse GPX file: %1").arg(file.errorString()));
+        }
+        buffer = file.readAll();
+        data = reinterpret_cast<uchar*>(buffer.data());
+        size = static_cast<size_t>(buffer.size());
     }
     
-    double totalSeconds = 0.0;
-    int count = 0;
+    pugi::xml_document doc;
+    pugi::xml_parse_result result = doc.load_buffer_inplace(data, size, pugi::parse_minimal);
     
-    for (int i = 1; i < trackpoints.size(); ++i) {
-        qint64 msecs = trackpoints[i - 1].timestamp.msecsTo(trackpoints[i].timestamp);
-        double seconds = msecs / 1000.0;
-        if (seconds > 0) {
-            totalSeconds += seconds;
-            ++count;
-        }
+    if (!result) {
+        return fail(QString("Failed to parse GPX file: %1").arg(result.description()));
     }
     
-    if (count == 0) {
-        return 300.0;
+    if (!collectTrackpoints(doc, *track)) {
+        return fail("Invalid GPX file: missing <gpx> root element");
+    }
+    
+    // Sort by timestamp and find segments and gaps
+    track->finalize();
+    
+    qInfo() << "Parsed" << track->size() << "trackpoints from" << filePath;
+    
+    if (!track->isEmpty()) {
+        qInfo() << "Time range:" << track->pointAt(0).timestamp
+                << "to" << track->pointAt(track->size() - 1).timestamp;
     }
     
-    double avgInterval = totalSeconds / count;
-    qInfo() << "Average trackpoint interval:" << avgInterval << "seconds";
-    return avgInterval;
+    return TrackStorePtr(std::move(track));
 }
 
-QString GpxParser::lastError()
+double GpxParser::calculateAverageInterval(const TrackStore& track)
 {
-    return s_lastError;
+    // Precomputed by TrackStore::finalize(); gaps are not counted
+    const double avgInterval = track.stats().averageIntervalSeconds;
+    return avgInterval > 0 ? avgInterval : 300.0; // Default 5 minutes
 }
 
 } // namespace lyp
@@ -1,8 +1,10 @@
 #pragma once
 
-#include "models/track_point.h"
+#include "core/result.h"
+#include "models/track_store.h"
 #include <QString>
 #include <QVector>
+#include <optional>
 
 namespace lyp {
 
@@ -10,31 +12,41 @@ namespace lyp {
  * @brief Parser for GPX trace files.
  * 
  * Extracts GPS trackpoints with timestamps and coordinates from GPX files.
+ * Files are parsed in place, from a MappedFile where mapping is safe and
+ * the file has not been written in the last minute, otherwise from a
+ * buffered read. Timestamps go through a fixed-format ISO 8601 fast path
+ * straight to epoch milliseconds.
  */
 class GpxParser {
 public:
     /**
      * @brief Parse a GPX file and extract all trackpoints.
+     * 
+     * Each <trkseg> is recorded as a segment of the returned track.
      * @param filePath Path to the GPX file
-     * @return Vector of trackpoints sorted by timestamp, empty on error
+     * @return Track sorted by timestamp (never null; empty if the file has
+     *         no trackpoints), or why the file could not be parsed
      */
-    static QVector<TrackPoint> parse(const QString& filePath);
+    static Result<TrackStorePtr> parse(const QString& filePath);
     
     /**
-     * @brief Calculate the average time interval between trackpoints.
-     * @param trackpoints Vector of trackpoints
-     * @return Average interval in seconds, or 300.0 if unable to calculate
+     * @brief Convert an ISO 8601 timestamp to UTC epoch milliseconds.
+     *
+     * Handles "YYYY-MM-DDTHH:MM:SS[.fff][Z|+HH:MM]" directly (a missing zone
+     * means UTC) and falls back to QDateTime for anything else.
+     * @param text NUL-terminated timestamp text
+     * @return Milliseconds since epoch, or nullopt if unparseable
      */
-    static double calculateAverageInterval(const QVector<TrackPoint>& trackpoints);
+    static std::optional<qint64> parseIsoTimeMs(const char* text);
     
     /**
-     * @brief Get the last error message.
-     * @return Error message or empty string if no error
+     * @brief Average time interval between trackpoints within segments.
+     *
+     * Reads the statistics computed when the track was finalized; O(1).
+     * @param track Track to analyse
+     * @return Average interval in seconds, or 300.0 if unable to calculate
      */
-    static QString lastError();
-
-private:
-    static QString s_lastError;
+    static double calculateAverageInterval(const TrackStore& track);
 };
 
 } // namespace lyp
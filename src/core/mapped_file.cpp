@@ -0,0 +1,95 @@
+#include "mapped_file.h"
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStorageInfo>
+#include <algorithm>
+#include <atomic>
+
+namespace lyp {
+
+namespace {
+
+std::atomic<bool> g_enabled{true};
+
+/**
+ * @brief Filesystems that live on a fixed local disk.
+ *
+ * Anything else (NFS, SMB, FUSE, FAT/exFAT cards) is treated as possibly
+ * going away under a mapping.
+ */
+bool isLocalFileSystem(const QByteArray &type) {
+  static const QSet<QByteArray> local = {
+      "ext2", "ext3", "ext4", "xfs",     "btrfs", "zfs",  "f2fs",
+      "jfs",  "apfs", "hfs",  "hfsplus", "ntfs",  "refs", "tmpfs"};
+  return local.contains(type.toLower());
+}
+
+/**
+ * @brief Whether files in a directory may be mapped.
+ *
+ * QStorageInfo reads the mount table, so answers are kept per directory;
+ * a batch touches only a handful.
+ */
+bool isMappableDirectory(const QString &dirPath) {
+  static QMutex mutex;
+  static QHash<QString, bool> known;
+
+  QMutexLocker locker(&mutex);
+  auto it = known.constFind(dirPath);
+  if (it != known.constEnd())
+    return it.value();
+
+  const QStorageInfo storage(dirPath);
+  const bool mappable = storage.isValid() && storage.isReady() &&
+                        isLocalFileSystem(storage.fileSystemType());
+  known.insert(dirPath, mappable);
+  return mappable;
+}
+
+} // namespace
+
+std::unique_ptr<MappedFile> MappedFile::open(const QString &filePath,
+                                             qint64 maxBytes,
+                                             bool copyOnWrite) {
+  if (!isEnabled())
+    return nullptr;
+
+  const QFileInfo info(filePath);
+  if (!info.isFile() || info.size() < kMinMappedBytes ||
+      !isMappableDirectory(info.absolutePath()))
+    return nullptr;
+
+  std::unique_ptr<MappedFile> mapping(new MappedFile);
+  mapping->m_file.setFileName(filePath);
+  if (!mapping->m_file.open(QIODevice::ReadOnly))
+    return nullptr;
+
+  const qint64 size = maxBytes >= 0 ? std::min(maxBytes, info.size())
+                                    : info.size();
+  mapping->m_data = mapping->m_file.map(
+      0, size,
+      copyOnWrite ? QFileDevice::MapPrivateOption : QFileDevice::NoOptions);
+  if (!mapping->m_data)
+    return nullptr;
+  mapping->m_size = size;
+  mapping->m_copyOnWrite = copyOnWrite;
+  return mapping;
+}
+
+void MappedFile::setEnabled(bool enabled) {
+  g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool MappedFile::isEnabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+MappedFile::~MappedFile() {
+  if (m_data) {
+    m_file.unmap(m_data);
+  }
+}
+
+} // namespace lyp
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+#include <memory>
+
+namespace lyp {
+
+/**
+ * @brief Memory mapping of a photo or GPX file on a local disk.
+ *
+ * Lets the header probe, exiv2 and the GPX parser read straight from the page cache
+ * instead of copying the file through read buffers. Only files of at least
+ * kMinMappedBytes on a fixed local filesystem are mapped: on network shares
+ * and removable cards a vanished file would fault the process instead of
+ * failing a read, so those keep using buffered I/O.
+ */
+class MappedFile {
+public:
+  // Smaller files are read in a few buffered reads anyway
+  static constexpr qint64 kMinMappedBytes = 1024 * 1024;
+
+  /**
+   * @brief Map a file, or its head.
+   * @param filePath Path to the file
+   * @param maxBytes Map at most this many bytes from the start (-1 = all)
+   * @param copyOnWrite Make the pages writable; changes stay private to the
+   *        process and never reach the file (exiv2 edits TIFF data in place)
+   * @return The mapping, or nullptr if the file should use buffered I/O
+   */
+  static std::unique_ptr<MappedFile> open(const QString &filePath,
+                                          qint64 maxBytes = -1,
+                                          bool copyOnWrite = false);
+
+  /**
+   * @brief Turn mapping on or off process-wide (on by default).
+   */
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const uchar *data() const { return m_data; }
+  qint64 size() const { return m_size; }
+
+  /**
+   * @brief Writable pages of a copy-on-write mapping; null otherwise.
+   */
+  uchar *mutableData() { return m_copyOnWrite ? m_data : nullptr; }
+
+private:
+  MappedFile() = default;
+
+  QFile m_file;
+  uchar *m_data = nullptr;
+  qint64 m_size = 0;
+  bool m_copyOnWrite = false;
+};
+
+} // namespace lyp
@@ -0,0 +1,291 @@
+#include "perf_trace.h"
+#include <QSaveFile>
+#include <QStringList>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lyp {
+
+namespace {
+
+constexpr int kChunkEvents = 4096;
+
+struct Event {
+  qint64 startNs;
+  qint64 durationNs;
+  PerfStage stage;
+};
+
+/**
+ * @brief Fixed block of events, filled by one thread.
+ *
+ * `count` is published with release semantics after each event, and `next`
+ * is only set once the chunk is full, so readers never see a torn event.
+ */
+struct Chunk {
+  Event events[kChunkEvents];
+  std::atomic<int> count{0};
+  std::atomic<Chunk *> next{nullptr};
+};
+
+struct ThreadBuffer {
+  int threadIndex = 0;
+  Chunk *head = nullptr;
+  Chunk *tail = nullptr; // Owner thread only
+
+  // Start of the reporting window; guarded by the registry mutex
+  Chunk *windowChunk = nullptr;
+  int windowIndex = 0;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  std::atomic<qint64> bytesRead{0};
+  std::atomic<qint64> bytesWritten{0};
+
+  // Window baselines; guarded by the mutex
+  qint64 windowStartNs = 0;
+  qint64 windowBytesRead = 0;
+  qint64 windowBytesWritten = 0;
+};
+
+std::atomic<bool> g_enabled{false};
+
+// Never destroyed: worker threads may still record during static teardown
+Registry &registry() {
+  static Registry *instance = new Registry;
+  return *instance;
+}
+
+ThreadBuffer *localBuffer() {
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (!buffer) {
+    Registry &reg = registry();
+    auto created = std::make_unique<ThreadBuffer>();
+    created->head = new Chunk;
+    created->tail = created->head;
+    created->windowChunk = created->head;
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    created->threadIndex = static_cast<int>(reg.buffers.size()) + 1;
+    buffer = created.get();
+    reg.buffers.push_back(std::move(created));
+  }
+  return buffer;
+}
+
+/**
+ * @brief Visit every event in the reporting window; caller holds the mutex.
+ */
+template <typename Visitor> void forEachEvent(Registry &reg, Visitor visit) {
+  for (const auto &buffer : reg.buffers) {
+    Chunk *chunk = buffer->windowChunk;
+    int index = buffer->windowIndex;
+    while (chunk) {
+      const int count = chunk->count.load(std::memory_order_acquire);
+      for (int i = index; i < count; ++i) {
+        visit(buffer->threadIndex, chunk->events[i]);
+      }
+      chunk = chunk->next.load(std::memory_order_acquire);
+      index = 0;
+    }
+  }
+}
+
+double percentileMs(const std::vector<qint64> &sortedNs, int percent) {
+  if (sortedNs.empty()) {
+    return 0.0;
+  }
+  const size_t index = (sortedNs.size() - 1) * percent / 100;
+  return sortedNs[index] / 1e6;
+}
+
+QString mebibytes(qint64 bytes) {
+  return QString::number(bytes / (1024.0 * 1024.0), 'f', 1);
+}
+
+} // namespace
+
+void PerfTrace::setEnabled(bool enabled) {
+  g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool PerfTrace::isEnabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+void PerfTrace::enableFromEnvironment() {
+  if (!qEnvironmentVariableIsEmpty("LYP_PERF") ||
+      !qEnvironmentVariableIsEmpty("LYP_PERF_TRACE")) {
+    setEnabled(true);
+  }
+}
+
+qint64 PerfTrace::nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void PerfTrace::record(PerfStage stage, qint64 startNs, qint64 durationNs) {
+  ThreadBuffer *buffer = localBuffer();
+  Chunk *chunk = buffer->tail;
+  int count = chunk->count.load(std::memory_order_relaxed);
+  if (count == kChunkEvents) {
+    Chunk *fresh = new Chunk;
+    chunk->next.store(fresh, std::memory_order_release);
+    buffer->tail = fresh;
+    chunk = fresh;
+    count = 0;
+  }
+  chunk->events[count] = {startNs, durationNs, stage};
+  chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void PerfTrace::addBytesRead(qint64 bytes) {
+  if (isEnabled()) {
+    registry().bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+void PerfTrace::addBytesWritten(qint64 bytes) {
+  if (isEnabled()) {
+    registry().bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+void PerfTrace::reset() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const auto &buffer : reg.buffers) {
+    // Skip to the newest chunk; its filled part is history now
+    Chunk *chunk = buffer->windowChunk;
+    while (Chunk *next = chunk->next.load(std::memory_order_acquire)) {
+      chunk = next;
+    }
+    buffer->windowChunk = chunk;
+    buffer->windowIndex = chunk->count.load(std::memory_order_acquire);
+  }
+  reg.windowStartNs = nowNs();
+  reg.windowBytesRead = reg.bytesRead.load(std::memory_order_relaxed);
+  reg.windowBytesWritten = reg.bytesWritten.load(std::memory_order_relaxed);
+}
+
+QString PerfTrace::summary(int fileCount, qint64 wallMs) {
+  constexpr int kStageCount = static_cast<int>(PerfStage::Count);
+  std::array<std::vector<qint64>, kStageCount> durations;
+
+  Registry &reg = registry();
+  qint64 bytesRead = 0;
+  qint64 bytesWritten = 0;
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    forEachEvent(reg, [&durations](int, const Event &event) {
+      durations[static_cast<int>(event.stage)].push_back(event.durationNs);
+    });
+    bytesRead =
+        reg.bytesRead.load(std::memory_order_relaxed) - reg.windowBytesRead;
+    bytesWritten = reg.bytesWritten.load(std::memory_order_relaxed) -
+                   reg.windowBytesWritten;
+  }
+
+  QStringList lines;
+  lines << QString("%1 %2 %3 %4 %5")
+               .arg("stage", -13)
+               .arg("count", 8)
+               .arg("total ms", 11)
+               .arg("p50 ms", 9)
+               .arg("p95 ms", 9);
+  for (int stage = 0; stage < kStageCount; ++stage) {
+    std::vector<qint64> &values = durations[stage];
+    if (values.empty())
+      continue;
+    std::sort(values.begin(), values.end());
+    qint64 totalNs = 0;
+    for (qint64 value : values) {
+      totalNs += value;
+    }
+    lines << QString("%1 %2 %3 %4 %5")
+                 .arg(stageName(static_cast<PerfStage>(stage)), -13)
+                 .arg(qulonglong(values.size()), 8)
+                 .arg(totalNs / 1e6, 11, 'f', 1)
+                 .arg(percentileMs(values, 50), 9, 'f', 3)
+                 .arg(percentileMs(values, 95), 9, 'f', 3);
+  }
+
+  const double seconds = std::max<qint64>(wallMs, 1) / 1000.0;
+  lines << QString("%1 file(s) in %2 ms: %3 files/s, read %4 MiB, wrote %5 MiB")
+               .arg(fileCount)
+               .arg(wallMs)
+               .arg(fileCount / seconds, 0, 'f', 1)
+               .arg(mebibytes(bytesRead))
+               .arg(mebibytes(bytesWritten));
+  return lines.join('\n');
+}
+
+bool PerfTrace::writeChromeTrace(const QString &filePath) {
+  QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first = true;
+
+  Registry &reg = registry();
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const qint64 originNs = reg.windowStartNs;
+    forEachEvent(reg, [&](int threadIndex, const Event &event) {
+      if (!first) {
+        json.append(',');
+      }
+      first = false;
+      // Complete ("X") events with microsecond timestamps
+      json.append("{\"name\":\"");
+      json.append(stageName(event.stage));
+      json.append("\",\"cat\":\"lyp\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+      json.append(QByteArray::number(threadIndex));
+      json.append(",\"ts\":");
+      json.append(QByteArray::number((event.startNs - originNs) / 1000.0, 'f', 3));
+      json.append(",\"dur\":");
+      json.append(QByteArray::number(event.durationNs / 1000.0, 'f', 3));
+      json.append('}');
+    });
+  }
+  json.append("]}\n");
+
+  QSaveFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  file.write(json);
+  return file.commit();
+}
+
+const char *PerfTrace::stageName(PerfStage stage) {
+  switch (stage) {
+  case PerfStage::Open:
+    return "open";
+  case PerfStage::ReadMetadata:
+    return "readMetadata";
+  case PerfStage::Probe:
+    return "probe";
+  case PerfStage::Match:
+    return "match";
+  case PerfStage::Write:
+    return "write";
+  case PerfStage::ExifTool:
+    return "exiftool";
+  case PerfStage::ModelUpdate:
+    return "modelUpdate";
+  case PerfStage::QmlInvoke:
+    return "qmlInvoke";
+  case PerfStage::Count:
+    break;
+  }
+  return "unknown";
+}
+
+} // namespace lyp
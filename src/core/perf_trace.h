@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+namespace lyp {
+
+/**
+ * @brief Instrumented stages of the photo pipeline.
+ */
+enum class PerfStage : quint8 {
+  Open,         // exiv2 ImageFactory::open
+  ReadMetadata, // exiv2 readMetadata
+  Probe,        // FastExifProbe header read
+  Match,        // GPS lookup for one photo
+  Write,        // exiv2 write, in-place patch or sidecar
+  ExifTool,     // Write through an exiftool process
+  ModelUpdate,  // Committing results and emitting dataChanged
+  QmlInvoke,    // Calls from C++ into the map's QML
+  Count
+};
+
+/**
+ * @brief Process-wide timing and byte counters for the hot paths.
+ *
+ * Disabled by default, in which case a ScopedTimer costs one relaxed load.
+ * When enabled, every thread appends events to its own chunked buffer
+ * without locks; readers walk the published chunks. Buffers live until
+ * the process exits, and reset() only moves the start of the reported
+ * window, so recording threads never race with it.
+ */
+class PerfTrace {
+public:
+  /**
+   * @brief Turn recording on or off.
+   */
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  /**
+   * @brief Enable recording if LYP_PERF or LYP_PERF_TRACE is set.
+   */
+  static void enableFromEnvironment();
+
+  /**
+   * @brief Monotonic clock used for all events, in nanoseconds.
+   */
+  static qint64 nowNs();
+
+  /**
+   * @brief Record a finished interval on the calling thread.
+   */
+  static void record(PerfStage stage, qint64 startNs, qint64 durationNs);
+
+  static void addBytesRead(qint64 bytes);
+  static void addBytesWritten(qint64 bytes);
+
+  /**
+   * @brief Start a new reporting window; earlier events are ignored.
+   */
+  static void reset();
+
+  /**
+   * @brief Per-stage table (count, total, p50, p95) plus throughput.
+   * @param fileCount Files handled in the window, for files/s
+   * @param wallMs Wall-clock duration of the window
+   * @return Multi-line, human-readable report
+   */
+  static QString summary(int fileCount, qint64 wallMs);
+
+  /**
+   * @brief Write the window's events as a Chrome trace (chrome://tracing,
+   *        Perfetto).
+   * @param filePath Destination JSON file
+   * @return true on success
+   */
+  static bool writeChromeTrace(const QString &filePath);
+
+  /**
+   * @brief Short stage name used in reports and traces.
+   */
+  static const char *stageName(PerfStage stage);
+};
+
+/**
+ * @brief Records the lifetime of a scope as one PerfTrace event.
+ */
+class ScopedTimer {
+public:
+  explicit ScopedTimer(PerfStage stage)
+      : m_stage(stage), m_startNs(PerfTrace::isEnabled() ? PerfTrace::nowNs() : -1) {}
+
+  ~ScopedTimer() {
+    if (m_startNs >= 0) {
+      PerfTrace::record(m_stage, m_startNs, PerfTrace::nowNs() - m_startNs);
+    }
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  PerfStage m_stage;
+  qint64 m_startNs;
+};
+
+} // namespace lyp
@@ -0,0 +1,375 @@
+#include "photo_pipeline.h"
+#include "batch_journal.h"
+#include "exif_handler.h"
+#include "exiftool_writer.h"
+#include "fast_exif_probe.h"
+#include "gps_matcher.h"
+#include "perf_trace.h"
+#include "scan_cache.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+
+namespace lyp {
+
+namespace {
+
+// Files in flight per reader thread when no limit is set
+constexpr int kDefaultInFlightPerReader = 4;
+
+} // namespace
+
+/**
+ * @brief A file travelling through the stages.
+ */
+struct PhotoPipeline::Item {
+  PhotoJob job;
+  FormatInfo formatInfo;
+  std::unique_ptr<MetadataSession> session; // Only if exiv2 was needed to read
+  PhotoResult result;
+  bool done = false;    // Result is final; skip the remaining stages
+  bool resumed = false; // Done by an earlier run; not journaled again
+};
+
+namespace {
+
+void skip(PhotoResult &result, const char *reason) {
+  result.state = PhotoState::Skipped;
+  result.errorMessage = reason;
+}
+
+} // namespace
+
+void PhotoPipeline::readPhoto(Item &item) const {
+  const QString &filePath = item.job.filePath;
+  PhotoResult &result = item.result;
+  const double timeOffsetSeconds = m_settings.timeOffsetHours * 3600.0;
+
+  if (m_journal) {
+    if (auto done = m_journal->completed(filePath, m_settings.outputMode)) {
+      skip(result, "Geotagged by an earlier run");
+      result.matchedLat = done->latitude;
+      result.matchedLon = done->longitude;
+      result.matchedElevation = done->elevation;
+      result.gpsWritten = true;
+      item.done = true;
+      item.resumed = true;
+      return;
+    }
+  }
+
+  const auto owner = m_sidecarOwners.constFind(item.job.index);
+  if (owner != m_sidecarOwners.constEnd()) {
+    result.state = PhotoState::Skipped;
+    result.errorMessage = QString("Shares its XMP sidecar with %1").arg(*owner);
+    item.done = true;
+    return;
+  }
+
+  // Check format support level
+  item.formatInfo = ExifHandler::getFormatInfo(filePath);
+
+  // Skip files with no metadata support
+  if (item.formatInfo.level == FormatSupportLevel::Minimal) {
+    skip(result, "No metadata support for this format");
+    item.done = true;
+    return;
+  }
+
+  // Skip if already has GPS and not overwriting
+  if (item.job.hasExistingGps && !m_settings.overwriteExistingGps) {
+    skip(result, "Already has GPS data");
+    item.done = true;
+    return;
+  }
+
+  // Take the timestamp from the scan cache or the TIFF headers when
+  // possible; the full exiv2 decode is then only paid for files written
+  std::optional<QDateTime> timestamp;
+  if (auto cached = ScanCache::lookup(filePath)) {
+    timestamp = cached->captureTime(timeOffsetSeconds);
+  } else if (auto probe = FastExifProbe::probe(filePath)) {
+    timestamp = probe->captureTime(timeOffsetSeconds);
+  } else {
+    item.session = std::make_unique<MetadataSession>(filePath);
+    timestamp = item.session->timestamp(timeOffsetSeconds);
+  }
+  if (!timestamp.has_value()) {
+    skip(result, "No timestamp found");
+    item.done = true;
+    return;
+  }
+  result.captureTime = timestamp.value();
+}
+
+void PhotoPipeline::matchPhoto(Item &item) const {
+  const GpsMatcher &matcher = *m_matcher;
+  PhotoResult &result = item.result;
+
+  std::optional<GpsMatch> gpsResult;
+  {
+    ScopedTimer timer(PerfStage::Match);
+    gpsResult = matcher.findGpsForPhoto(result.captureTime);
+  }
+  if (!gpsResult.has_value()) {
+    if (matcher.isInTrackGap(result.captureTime)) {
+      skip(result, "Photo time falls in a gap in the GPX track");
+    } else if (matcher.isWithinTrackRange(result.captureTime)) {
+      skip(result, "No GPS match within time threshold");
+    } else {
+      skip(result, "Photo time outside GPX range");
+    }
+    item.done = true;
+    return;
+  }
+
+  auto [lat, lon, elevation] = gpsResult.value();
+  result.matchedLat = lat;
+  result.matchedLon = lon;
+  result.matchedElevation = elevation;
+
+  // Dry run stops after matching
+  if (m_settings.dryRun) {
+    result.state = PhotoState::Success;
+    item.done = true;
+  }
+}
+
+void PhotoPipeline::writePhoto(Item &item) const {
+  const QString &filePath = item.job.filePath;
+  PhotoResult &result = item.result;
+  const double lat = *result.matchedLat;
+  const double lon = *result.matchedLon;
+  const std::optional<double> elevation = result.matchedElevation;
+
+  const auto fail = [&result](const QString &error) {
+    result.state = PhotoState::Error;
+    result.errorMessage = error;
+  };
+
+  if (m_settings.outputMode == OutputMode::XmpSidecar) {
+    // Only the small sidecar is written; the photo stays untouched
+    const Status written =
+        ExifHandler::writeGpsSidecar(filePath, lat, lon, elevation);
+    if (!written) {
+      fail(written.error());
+      return;
+    }
+    result.state = PhotoState::Success;
+    result.gpsWritten = true;
+    return;
+  }
+
+  // Embed in the photo itself
+  if (item.formatInfo.level == FormatSupportLevel::NeedsExifTool) {
+    // Use exiftool for BMFF formats
+    if (!ExifToolWriter::isAvailable()) {
+      fail("exiftool not found - install it to write to this format");
+      return;
+    }
+    const Status written =
+        ExifToolWriter::writeGpsData(filePath, lat, lon, elevation);
+    if (!written) {
+      fail(written.error());
+      return;
+    }
+  } else if (item.job.hasExistingGps &&
+             item.formatInfo.level == FormatSupportLevel::FullWrite &&
+             ExifHandler::patchGpsInPlace(filePath, lat, lon, elevation)) {
+    // Existing GPS values were overwritten in place
+  } else {
+    // Use exiv2 for FullWrite and DangerousRAW formats
+    if (!item.session) {
+      item.session = std::make_unique<MetadataSession>(filePath);
+    }
+    const bool written = item.session->writeGpsData(lat, lon, elevation);
+    const QString error = item.session->lastError();
+    item.session.reset();
+    if (!written) {
+      fail(error);
+      return;
+    }
+  }
+
+  // The write changed the file's mtime; keep its cache entry valid
+  const double timeOffsetSeconds = m_settings.timeOffsetHours * 3600.0;
+  ScanCacheEntry entry;
+  entry.captureTimeMs =
+      result.captureTime.addSecs(static_cast<qint64>(timeOffsetSeconds))
+          .toMSecsSinceEpoch();
+  entry.hasGps = true;
+  entry.level = item.formatInfo.level;
+  ScanCache::insert(filePath, entry);
+
+  result.state = PhotoState::Success;
+  result.gpsWritten = true;
+}
+
+PhotoPipeline::PhotoPipeline(QVector<PhotoJob> jobs,
+                             std::shared_ptr<const GpsMatcher> matcher,
+                             const ProcessingSettings &settings,
+                             QThreadPool *threads, StartedHandler onStarted,
+                             ResultHandler onResult)
+    : m_jobs(std::move(jobs)), m_matcher(std::move(matcher)),
+      m_settings(settings), m_onStarted(std::move(onStarted)),
+      m_onResult(std::move(onResult)),
+      m_readerCount(std::max(1, settings.workerCount > 0
+                                    ? settings.workerCount
+                                    : QThread::idealThreadCount())),
+      m_writerCount(m_readerCount),
+      m_maxInFlight(settings.maxFilesInFlight > 0
+                        ? settings.maxFilesInFlight
+                        : m_readerCount * kDefaultInFlightPerReader),
+      m_computeQueue(m_maxInFlight), m_writeQueue(m_maxInFlight),
+      m_threads(threads ? threads : &m_ownThreads) {
+  // Every stage thread blocks on its queue, so all must run at once
+  m_threads->setMaxThreadCount(m_readerCount + 1 + m_writerCount);
+
+  if (m_settings.outputMode == OutputMode::XmpSidecar) {
+    findSharedSidecars();
+  }
+}
+
+void PhotoPipeline::findSharedSidecars() {
+  // IMG_0001.ARW and IMG_0001.JPG both map to IMG_0001.xmp. Only one of
+  // them writes it, the RAW if there is one, as Lightroom expects.
+  // Otherwise each write would clobber the other and change the size and
+  // time journaled for it.
+  QVector<QString> sidecars(m_jobs.size());
+  QHash<QString, int> writers; // Sidecar -> position in m_jobs
+  for (int i = 0; i < m_jobs.size(); ++i) {
+    sidecars[i] = ExifHandler::sidecarPath(m_jobs[i].filePath);
+    auto it = writers.find(sidecars[i]);
+    if (it == writers.end()) {
+      writers.insert(sidecars[i], i);
+    } else if (ExifHandler::isRawFormat(m_jobs[i].filePath) &&
+               !ExifHandler::isRawFormat(m_jobs[*it].filePath)) {
+      *it = i;
+    }
+  }
+
+  for (int i = 0; i < m_jobs.size(); ++i) {
+    const int writer = writers.value(sidecars[i]);
+    if (writer != i) {
+      const QString name = QFileInfo(m_jobs[writer].filePath).fileName();
+      m_sidecarOwners.insert(m_jobs[i].index, name);
+      qWarning() << m_jobs[i].filePath << "shares its XMP sidecar with"
+                 << name << "; only that photo is written";
+    }
+  }
+}
+
+PhotoPipeline::~PhotoPipeline() {
+  stop();
+  wait();
+}
+
+void PhotoPipeline::start() {
+  m_activeReaders = m_readerCount;
+  for (int i = 0; i < m_readerCount; ++i) {
+    m_threads->start([this]() { runReader(); });
+  }
+  m_threads->start([this]() { runCompute(); });
+  for (int i = 0; i < m_writerCount; ++i) {
+    m_threads->start([this]() { runWriter(); });
+  }
+}
+
+void PhotoPipeline::stop() {
+  QMutexLocker locker(&m_slotMutex);
+  m_stopped = true;
+  m_slotFreed.wakeAll();
+}
+
+void PhotoPipeline::wait() { m_threads->waitForDone(); }
+
+bool PhotoPipeline::acquireSlot() {
+  QMutexLocker locker(&m_slotMutex);
+  while (!m_stopped && m_inFlight >= m_maxInFlight) {
+    m_slotFreed.wait(&m_slotMutex);
+  }
+  if (m_stopped)
+    return false;
+  ++m_inFlight;
+  return true;
+}
+
+void PhotoPipeline::finish(const Item &item, bool cancelled) {
+  if (m_journal && !cancelled && !item.resumed) {
+    const bool sidecar = item.result.state == PhotoState::Success &&
+                         m_settings.outputMode == OutputMode::XmpSidecar;
+    m_journal->record(item.job.filePath,
+                      sidecar ? ExifHandler::sidecarPath(item.job.filePath)
+                              : item.job.filePath,
+                      item.result);
+  }
+  m_onResult(item.job.index, item.job.filePath,
+             cancelled ? PhotoResult() : item.result, cancelled);
+
+  QMutexLocker locker(&m_slotMutex);
+  --m_inFlight;
+  m_slotFreed.wakeOne();
+}
+
+void PhotoPipeline::runReader() {
+  for (;;) {
+    const int next = m_nextJob++;
+    if (next >= m_jobs.size())
+      break;
+
+    const PhotoJob &job = m_jobs[next];
+    if (!acquireSlot()) {
+      // Stopped: leave the photo untouched; it is only accounted for
+      m_onResult(job.index, job.filePath, PhotoResult(), true);
+      continue;
+    }
+
+    m_onStarted(job.index);
+    auto item = std::make_unique<Item>();
+    item->job = job;
+    readPhoto(*item);
+    if (item->done) {
+      finish(*item, false);
+    } else {
+      // Only closed once every reader is done, so this cannot fail
+      m_computeQueue.push(std::move(item));
+    }
+  }
+
+  if (--m_activeReaders == 0) {
+    m_computeQueue.close();
+  }
+}
+
+void PhotoPipeline::runCompute() {
+  while (std::optional<ItemPtr> item = m_computeQueue.pop()) {
+    Item &current = **item;
+    if (m_stopped) {
+      finish(current, true);
+      continue;
+    }
+    matchPhoto(current);
+    if (current.done) {
+      finish(current, false);
+    } else {
+      m_writeQueue.push(std::move(*item));
+    }
+  }
+  m_writeQueue.close();
+}
+
+void PhotoPipeline::runWriter() {
+  while (std::optional<ItemPtr> item = m_writeQueue.pop()) {
+    Item &current = **item;
+    if (m_stopped) {
+      // Files not yet written are left for the next run
+      finish(current, true);
+      continue;
+    }
+    writePhoto(current);
+    finish(current, false);
+  }
+}
+
+} // namespace lyp
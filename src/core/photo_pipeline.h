@@ -0,0 +1,140 @@
+#pragma once
+
+#include "core/bounded_queue.h"
+#include "core/photo_processor.h"
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace lyp {
+
+class BatchJournal;
+class GpsMatcher;
+
+/**
+ * @brief One photo handed to the pipeline.
+ */
+struct PhotoJob {
+  int index;           // Row in the model
+  QString filePath;
+  bool hasExistingGps;
+};
+
+/**
+ * @brief Read, match and write stages for a processing run.
+ *
+ * Reader threads fetch capture times (scan cache, header probe or exiv2),
+ * one compute thread matches them against the track, and writer threads
+ * write the coordinates. The stages are connected by bounded queues, and at
+ * most `maxFilesInFlight` files are between being picked up and being
+ * reported. Slow network round trips therefore overlap instead of running
+ * one after another, while memory stays capped: a file in flight holds at
+ * most one open metadata session. Results are reported from the stage
+ * threads as files finish, in no particular order.
+ */
+class PhotoPipeline {
+public:
+  using StartedHandler = std::function<void(int index)>;
+  using ResultHandler =
+      std::function<void(int index, const QString &filePath,
+                         const PhotoResult &result, bool cancelled)>;
+
+  /**
+   * @param jobs Photos to process
+   * @param matcher Matcher shared by the run
+   * @param settings Run settings; workerCount sets the reader and the
+   *        writer thread count, maxFilesInFlight the in-flight limit
+   * @param threads Pool the stages run on; only used by this pipeline
+   *        while it runs. Null gives the pipeline a pool of its own
+   * @param onStarted Called when a file is picked up
+   * @param onResult Called exactly once per job
+   */
+  PhotoPipeline(QVector<PhotoJob> jobs,
+                std::shared_ptr<const GpsMatcher> matcher,
+                const ProcessingSettings &settings, QThreadPool *threads,
+                StartedHandler onStarted, ResultHandler onResult);
+
+  /**
+   * @brief Stops and waits for the stage threads.
+   */
+  ~PhotoPipeline();
+
+  PhotoPipeline(const PhotoPipeline &) = delete;
+  PhotoPipeline &operator=(const PhotoPipeline &) = delete;
+
+  /**
+   * @brief Skip photos done by an earlier run and log every outcome.
+   *
+   * Must be set before start(); the journal must already be open.
+   */
+  void setJournal(std::shared_ptr<BatchJournal> journal) {
+    m_journal = std::move(journal);
+  }
+
+  void start();
+
+  /**
+   * @brief Finish files being written; report the rest as cancelled.
+   */
+  void stop();
+
+  /**
+   * @brief Block until every job has been reported.
+   */
+  void wait();
+
+  int readerCount() const { return m_readerCount; }
+  int writerCount() const { return m_writerCount; }
+  int maxFilesInFlight() const { return m_maxInFlight; }
+
+private:
+  struct Item;
+  using ItemPtr = std::unique_ptr<Item>;
+
+  // Stage bodies; set item.done once the result is final
+  void readPhoto(Item &item) const;
+  void matchPhoto(Item &item) const;
+  void writePhoto(Item &item) const;
+
+  void runReader();
+  void runCompute();
+  void runWriter();
+
+  void findSharedSidecars();
+  bool acquireSlot();
+  void finish(const Item &item, bool cancelled);
+
+  const QVector<PhotoJob> m_jobs;
+  const std::shared_ptr<const GpsMatcher> m_matcher;
+  const ProcessingSettings m_settings;
+  const StartedHandler m_onStarted;
+  const ResultHandler m_onResult;
+  std::shared_ptr<BatchJournal> m_journal;
+  int m_readerCount;
+  int m_writerCount;
+  int m_maxInFlight;
+
+  // Photos whose sidecar another photo of the run writes: row -> its name
+  QHash<int, QString> m_sidecarOwners;
+
+  std::atomic<int> m_nextJob{0};
+  std::atomic<int> m_activeReaders{0};
+  std::atomic<bool> m_stopped{false};
+
+  // In-flight budget; readers wait here when it is used up
+  QMutex m_slotMutex;
+  QWaitCondition m_slotFreed;
+  int m_inFlight = 0;
+
+  BoundedQueue<ItemPtr> m_computeQueue;
+  BoundedQueue<ItemPtr> m_writeQueue;
+  QThreadPool m_ownThreads;
+  QThreadPool *m_threads;
+};
+
+} // namespace lyp
@@ -1,39 +1,273 @@
 #include "photo_processor.h"
+#include "batch_journal.h"
 #include "exif_handler.h"
 #include "exiftool_writer.h"
 #include "gps_matcher.h"
 #include "gpx_parser.h"
+#include "perf_trace.h"
+#include "photo_pipeline.h"
+#include "scan_cache.h"
+#include "track_cache.h"
 #include "models/photo_list_model.h"
 #include <QDebug>
 #include <QFileInfo>
 #include <algorithm>
+#include <cmath>
+#include <memory>
 
 namespace lyp {
 
-PhotoProcessor::PhotoProcessor(QObject *parent) : QObject(parent) {}
+namespace {
+
+// Files probed per scan task; also the granularity of row insertion
+constexpr int kScanChunkSize = 64;
+
+// Minimum spacing of progressUpdated signals during a run
+constexpr qint64 kProgressIntervalMs = 50;
+
+/**
+ * @brief Load GPX files concurrently through the track cache.
+ * @param filePaths Paths to GPX files
+ * @param failures Receives "path: reason" for files without trackpoints
+ * @return One track per path (never null)
+ */
+QVector<TrackStorePtr> loadTracks(const QStringList &filePaths,
+                                  QStringList &failures) {
+  QVector<TrackStorePtr> tracks(filePaths.size());
+  QStringList errors(filePaths.size());
+
+  // Each task only writes its own slot
+  TrackStorePtr *trackSlots = tracks.data();
+  QString *errorSlots = errors.data();
+  QThreadPool pool;
+  for (int i = 0; i < filePaths.size(); ++i) {
+    const QString path = filePaths[i];
+    pool.start([path, i, trackSlots, errorSlots]() {
+      const Result<TrackStorePtr> loaded = TrackCache::loadOrParse(path);
+      trackSlots[i] = loaded.valueOr(std::make_shared<TrackStore>());
+      errorSlots[i] = loaded.error();
+    });
+  }
+  pool.waitForDone();
+
+  for (int i = 0; i < filePaths.size(); ++i) {
+    if (tracks[i]->isEmpty()) {
+      failures << QString("%1: %2").arg(
+          filePaths[i],
+          errors[i].isEmpty() ? QString("no trackpoints") : errors[i]);
+    }
+  }
+  return tracks;
+}
+
+} // namespace
+
+PhotoProcessor::PhotoProcessor(QObject *parent)
+    : QObject(parent), m_pool(new QThreadPool(this)),
+      m_stageThreads(new QThreadPool(this)),
+      m_dirScanner(new DirectoryScanner(this)) {
+  ExifHandler::initialize();
+
+  connect(m_dirScanner, &DirectoryScanner::filesFound, this,
+          [this](const QStringList &filePaths) {
+            if (m_scanModel) {
+              scanPhotos(filePaths, m_scanModel);
+            }
+          });
+  connect(m_dirScanner, &DirectoryScanner::finished, this, [this](int count) {
+    qInfo() << "Directory walk found" << count << "supported file(s)";
+    if (!isScanning()) {
+      finishScan();
+    }
+  });
+}
+
+PhotoProcessor::~PhotoProcessor() {
+  // Let in-flight workers finish before their queued results are discarded
+  m_stopRequested = true;
+  ++m_gpxGeneration;
+  m_pipeline.reset();
+  m_pool->waitForDone();
+}
 
 bool PhotoProcessor::loadGpxFile(const QString &filePath) {
-  m_trackpoints = GpxParser::parse(filePath);
+  cancelGpxLoad();
+  const Result<TrackStorePtr> loaded = TrackCache::loadOrParse(filePath);
+  m_trackSet = TrackSet::fromTrack(
+      loaded.valueOr(std::make_shared<TrackStore>()), filePath);
+  m_gpxFilePath = filePath;
+  return finishGpxLoad(loaded.error());
+}
 
-  if (m_trackpoints.isEmpty()) {
-    emit gpxLoadError(GpxParser::lastError());
-    return false;
+bool PhotoProcessor::loadGpxFiles(const QStringList &filePaths) {
+  if (filePaths.size() == 1) {
+    return loadGpxFile(filePaths.first());
+  }
+
+  cancelGpxLoad();
+  QStringList failures;
+  const QVector<TrackStorePtr> tracks = loadTracks(filePaths, failures);
+  m_trackSet = TrackSet::build(filePaths, tracks);
+  if (!failures.isEmpty() && !m_trackSet->isEmpty()) {
+    qWarning() << "Failed to load" << failures.size()
+               << "GPX file(s):" << failures;
+  }
+  m_gpxFilePath = filePaths.join(';');
+  return finishGpxLoad(failures.join('\n'));
+}
+
+void PhotoProcessor::setKeepJournalOpen(bool keep) {
+  m_keepJournalOpen = keep;
+  if (!keep) {
+    m_journal.reset();
+  }
+}
+
+bool PhotoProcessor::reloadGpxFiles(const QStringList &filePaths) {
+  const TrackSetPtr previous = m_trackSet;
+  const QString previousPath = m_gpxFilePath;
+  if (loadGpxFiles(filePaths))
+    return true;
+
+  if (previous && !previous->isEmpty()) {
+    qWarning() << "Keeping the previously loaded track";
+    m_trackSet = previous;
+    m_track = previous->resolvedTrack();
+    m_gpxFilePath = previousPath;
+  }
+  return false;
+}
+
+void PhotoProcessor::loadGpxFilesAsync(const QStringList &filePaths) {
+  cancelGpxLoad();
+  if (filePaths.isEmpty())
+    return;
+
+  const quint64 generation = m_gpxGeneration;
+  m_gpxLoadPaths = filePaths;
+  m_gpxLoadTracks = QVector<TrackStorePtr>(filePaths.size());
+  m_gpxLoadErrors = QStringList();
+  m_gpxLoadTotal = filePaths.size();
+  m_gpxLoadDone = 0;
+  emit gpxLoadProgress(0, m_gpxLoadTotal);
+
+  for (int i = 0; i < filePaths.size(); ++i) {
+    const QString path = filePaths[i];
+    // Ahead of queued scan chunks, which may number in the thousands
+    m_pool->start(
+        [this, generation, i, path]() {
+          if (m_gpxGeneration != generation)
+            return;
+
+          const Result<TrackStorePtr> loaded = TrackCache::loadOrParse(path);
+          const TrackStorePtr track =
+              loaded.valueOr(std::make_shared<TrackStore>());
+          const QString error = loaded.error();
+          QMetaObject::invokeMethod(
+              this,
+              [this, generation, i, track, error]() {
+                onGpxFileLoaded(generation, i, track, error);
+              },
+              Qt::QueuedConnection);
+        },
+        1);
+  }
+}
+
+void PhotoProcessor::onGpxFileLoaded(quint64 generation, int index,
+                                     const TrackStorePtr &track,
+                                     const QString &error) {
+  if (generation != m_gpxGeneration)
+    return;
+
+  m_gpxLoadTracks[index] = track;
+  if (track->isEmpty()) {
+    m_gpxLoadErrors << QString("%1: %2").arg(
+        m_gpxLoadPaths[index],
+        error.isEmpty() ? QString("no trackpoints") : error);
+  }
+  ++m_gpxLoadDone;
+  emit gpxLoadProgress(m_gpxLoadDone, m_gpxLoadTotal);
+  if (m_gpxLoadDone < m_gpxLoadTotal)
+    return;
+
+  // Indexing and merging millions of points would stall this thread as well
+  const QStringList paths = m_gpxLoadPaths;
+  const QVector<TrackStorePtr> tracks = m_gpxLoadTracks;
+  const QString failures = m_gpxLoadTotal == 1 ? error : m_gpxLoadErrors.join('\n');
+  m_pool->start(
+      [this, generation, paths, tracks, failures]() {
+        TrackSetPtr trackSet = TrackSet::build(paths, tracks);
+        QMetaObject::invokeMethod(
+            this,
+            [this, generation, trackSet, failures]() {
+              onGpxTrackReady(generation, trackSet, failures);
+            },
+            Qt::QueuedConnection);
+      },
+      1);
+}
+
+void PhotoProcessor::onGpxTrackReady(quint64 generation,
+                                     const TrackSetPtr &tracks,
+                                     const QString &error) {
+  if (generation != m_gpxGeneration)
+    return;
+
+  if (!m_gpxLoadErrors.isEmpty() && !tracks->isEmpty()) {
+    qWarning() << "Failed to load" << m_gpxLoadErrors.size()
+               << "GPX file(s):" << m_gpxLoadErrors;
   }
+  const QString filePath = m_gpxLoadPaths.join(';');
+  cancelGpxLoad();
 
+  m_trackSet = tracks;
   m_gpxFilePath = filePath;
+  finishGpxLoad(error);
+}
 
-  // Calculate adaptive max time diff if needed
-  double avgInterval = GpxParser::calculateAverageInterval(m_trackpoints);
-  qInfo() << "Loaded GPX with" << m_trackpoints.size() << "trackpoints,"
-          << "avg interval:" << avgInterval << "seconds";
+void PhotoProcessor::cancelGpxLoad() {
+  ++m_gpxGeneration;
+  m_gpxLoadPaths.clear();
+  m_gpxLoadTracks.clear();
+  m_gpxLoadErrors.clear();
+  m_gpxLoadTotal = 0;
+  m_gpxLoadDone = 0;
+}
 
-  emit gpxLoaded(m_trackpoints.size());
+bool PhotoProcessor::finishGpxLoad(const QString &error) {
+  m_track = m_trackSet->resolvedTrack();
+  if (m_track->isEmpty()) {
+    m_gpxFilePath.clear();
+    emit gpxLoadError(error);
+    return false;
+  }
+
+  // Calculate adaptive max time diff if needed
+  const TrackStats &stats = m_track->stats();
+  qInfo() << "Loaded GPX with" << m_track->size() << "trackpoints in"
+          << stats.segmentCount << "segment(s),"
+          << "avg interval:" << GpxParser::calculateAverageInterval(*m_track)
+          << "seconds, longest gap:" << stats.longestGapMs / 1000.0
+          << "seconds";
+
+  emit gpxLoaded(m_track->size());
   return true;
 }
 
+double
+PhotoProcessor::effectiveMaxTimeDiff(const ProcessingSettings &settings) const {
+  if (settings.maxTimeDiffSeconds > 0) {
+    return settings.maxTimeDiffSeconds;
+  }
+  // Adaptive: 3x the average trackpoint interval, within 1-10 minutes
+  double avgInterval = GpxParser::calculateAverageInterval(*m_track);
+  return std::max(60.0, std::min(avgInterval * 3.0, 600.0));
+}
+
 void PhotoProcessor::scanPhotos(const QStringList &filePaths,
                                 PhotoListModel *model) {
-  QVector<PhotoItem> items;
+  QStringList queued;
   int skippedDuplicates = 0;
 
   for (const QString &path : filePaths) {
@@ -42,32 +276,134 @@ void PhotoProcessor::scanPhotos(const QStringList &filePaths,
       continue;
     }
 
-    // Skip duplicates
-    if (model->containsFile(path)) {
+    // Skip duplicates, including files still waiting in an earlier scan
+    if (model->containsFile(path) || m_scanQueuedPaths.contains(path)) {
       qInfo() << "Skipping duplicate file:" << path;
       ++skippedDuplicates;
       continue;
     }
 
-    PhotoItem item;
-    item.filePath = path;
-    item.fileName = QFileInfo(path).fileName();
-    item.hasExistingGps = ExifHandler::hasGpsData(path);
-    item.state = PhotoState::Pending;
-
-    items.append(item);
+    m_scanQueuedPaths.insert(path);
+    queued.append(path);
   }
 
-  model->addPhotos(items);
   if (skippedDuplicates > 0) {
     qInfo() << "Skipped" << skippedDuplicates << "duplicate file(s)";
   }
-  emit photosScanComplete(items.size());
+
+  m_scanModel = model;
+  m_scanTotal += queued.size();
+
+  if (!isScanning()) {
+    finishScan();
+    return;
+  }
+  emit scanProgress(m_scanDone, m_scanTotal);
+
+  const quint64 generation = m_scanGeneration;
+  for (int start = 0; start < queued.size(); start += kScanChunkSize) {
+    const int chunk = m_dispatchedScanChunks++;
+    const QStringList paths = queued.mid(start, kScanChunkSize);
+
+    m_pool->start([this, chunk, paths, generation]() {
+      QVector<PhotoItem> items;
+      items.reserve(paths.size());
+
+      for (const QString &path : paths) {
+        if (m_scanGeneration != generation) {
+          return; // Scan was cancelled; nobody waits for this chunk
+        }
+
+        PhotoItem item;
+        item.filePath = path;
+        item.fileName = QFileInfo(path).fileName();
+        const Result<ScanCacheEntry> probed = ScanCache::loadOrProbe(path);
+        if (probed) {
+          item.rawCaptureMs = probed.value().captureTimeMs;
+          item.hasExistingGps = probed.value().hasGps;
+          item.state = PhotoState::Pending;
+        } else {
+          // Processing reads the file again; a transient error may clear
+          item.state = PhotoState::Error;
+          item.errorMessage = probed.error();
+        }
+        items.append(item);
+      }
+
+      QMetaObject::invokeMethod(
+          this,
+          [this, chunk, generation, items]() {
+            onScanChunk(chunk, generation, items);
+          },
+          Qt::QueuedConnection);
+    });
+  }
+}
+
+void PhotoProcessor::scanDirectories(const QStringList &directories,
+                                     PhotoListModel *model) {
+  m_scanModel = model;
+  m_dirScanner->start(directories);
+}
+
+void PhotoProcessor::onScanChunk(int chunk, quint64 generation,
+                                 const QVector<PhotoItem> &items) {
+  if (generation != m_scanGeneration)
+    return;
+
+  m_pendingScanChunks.insert(chunk, items);
+
+  while (!m_pendingScanChunks.isEmpty() &&
+         m_pendingScanChunks.firstKey() == m_nextScanChunk) {
+    const QVector<PhotoItem> ready = m_pendingScanChunks.take(m_nextScanChunk);
+    ++m_nextScanChunk;
+
+    for (const PhotoItem &item : ready) {
+      m_scanQueuedPaths.remove(item.filePath);
+    }
+    if (m_scanModel) {
+      m_scanModel->addPhotos(ready);
+      m_scanAdded += ready.size();
+    }
+    m_scanDone += ready.size();
+  }
+
+  emit scanProgress(m_scanDone, m_scanTotal);
+  if (!isScanning()) {
+    finishScan();
+  }
+}
+
+void PhotoProcessor::cancelScan() {
+  if (!isScanning())
+    return;
+
+  ++m_scanGeneration;
+  m_dirScanner->cancel();
+  m_scanQueuedPaths.clear();
+  m_pendingScanChunks.clear();
+  m_nextScanChunk = m_dispatchedScanChunks;
+  finishScan();
+}
+
+void PhotoProcessor::finishScan() {
+  ScanCache::flush();
+
+  const int added = m_scanAdded;
+  m_scanTotal = 0;
+  m_scanDone = 0;
+  m_scanAdded = 0;
+  emit photosScanComplete(added);
 }
 
 void PhotoProcessor::processPhotos(PhotoListModel *model,
                                    const ProcessingSettings &settings) {
-  if (m_trackpoints.isEmpty()) {
+  if (isProcessing()) {
+    qWarning() << "Processing already in progress";
+    return;
+  }
+
+  if (!hasGpxLoaded()) {
     qWarning() << "No GPX trackpoints loaded";
     emit processingComplete(0, model->count());
     return;
@@ -75,138 +411,325 @@ void PhotoProcessor::processPhotos(PhotoListModel *model,
 
   m_stopRequested = false;
 
-  // Calculate effective max time diff
-  double maxTimeDiff = settings.maxTimeDiffSeconds;
-  if (maxTimeDiff <= 0) {
-    double avgInterval = GpxParser::calculateAverageInterval(m_trackpoints);
-    maxTimeDiff = std::max(60.0, std::min(avgInterval * 3.0, 600.0));
+  const double maxTimeDiff = effectiveMaxTimeDiff(settings);
+  auto matcher = std::make_shared<const GpsMatcher>(
+      m_trackSet, maxTimeDiff, settings.forceInterpolate);
+
+  // Resolve exiftool availability here so workers only read the cached flag
+  if (settings.outputMode == OutputMode::EmbedInFile) {
+    ExifToolWriter::isAvailable();
   }
 
-  GpsMatcher matcher(m_trackpoints, maxTimeDiff, settings.forceInterpolate);
-  double timeOffsetSeconds = settings.timeOffsetHours * 3600.0;
+  QVector<PhotoJob> jobs;
+  jobs.reserve(model->count());
+  for (int i = 0; i < model->count(); ++i) {
+    const PhotoItem &photo = model->photos()[i];
+    jobs.append({i, photo.filePath, photo.hasExistingGps});
+  }
+
+  m_pipeline = std::make_unique<PhotoPipeline>(
+      std::move(jobs), matcher, settings, m_stageThreads,
+      [this](int index) {
+        QMetaObject::invokeMethod(
+            this, [this, index]() { onPhotoStarted(index); },
+            Qt::QueuedConnection);
+      },
+      [this](int index, const QString &filePath, const PhotoResult &result,
+             bool cancelled) {
+        QMetaObject::invokeMethod(
+            this,
+            [this, index, filePath, result, cancelled]() {
+              onPhotoResult(index, filePath, result, cancelled);
+            },
+            Qt::QueuedConnection);
+      });
 
   qInfo() << "Processing" << model->count() << "photos with settings:"
           << "maxTimeDiff=" << maxTimeDiff
           << "timeOffset=" << settings.timeOffsetHours << "h"
           << "overwrite=" << settings.overwriteExistingGps
           << "forceInterpolate=" << settings.forceInterpolate
-          << "dryRun=" << settings.dryRun;
-
-  int successCount = 0;
+          << "dryRun=" << settings.dryRun
+          << "sidecar=" << (settings.outputMode == OutputMode::XmpSidecar)
+          << "readers=" << m_pipeline->readerCount()
+          << "writers=" << m_pipeline->writerCount()
+          << "inFlight=" << m_pipeline->maxFilesInFlight();
+
+  m_model = model;
+  m_pendingResults.clear();
+  m_nextResult = 0;
+  m_totalCount = model->count();
+  m_successCount = 0;
+
+  if (m_totalCount == 0) {
+    m_pipeline.reset();
+    m_model.clear();
+    emit processingComplete(0, 0);
+    return;
+  }
 
-  for (int i = 0; i < model->count(); ++i) {
-    if (m_stopRequested) {
-      qInfo() << "Processing stopped by user";
-      break;
+  m_progressTimer.start();
+  m_runTimer.start();
+  m_traceFilePath = settings.traceFilePath;
+  PerfTrace::reset();
+
+  // Photos finished by an interrupted run with the same settings are skipped
+  if (!settings.dryRun && !settings.journalFilePath.isEmpty()) {
+    const QString fingerprint =
+        BatchJournal::fingerprint(settings, maxTimeDiff, *m_trackSet);
+    std::shared_ptr<BatchJournal> journal = m_journal;
+    if (!journal || journal->filePath() != settings.journalFilePath ||
+        journal->runFingerprint() != fingerprint) {
+      QStringList gpxFiles;
+      for (const TrackSource &source : m_trackSet->sources()) {
+        gpxFiles.append(source.name);
+      }
+      journal = std::make_shared<BatchJournal>(settings.journalFilePath);
+      if (!journal->open(fingerprint, settings, gpxFiles, model->count())) {
+        journal.reset();
+      }
     }
+    if (m_keepJournalOpen) {
+      m_journal = journal;
+    }
+    if (journal) {
+      m_pipeline->setJournal(std::move(journal));
+    }
+  }
 
-    emit progressUpdated(i + 1, model->count());
-
-    PhotoItem photo = model->photos()[i];
-    photo.state = PhotoState::Processing;
-    model->updatePhoto(i, photo);
-
-    // Check format support level
-    FormatInfo formatInfo = ExifHandler::getFormatInfo(photo.filePath);
+  m_pipeline->start();
+}
 
-    // Skip files with no metadata support
-    if (formatInfo.level == FormatSupportLevel::Minimal) {
-      photo.state = PhotoState::Skipped;
-      photo.errorMessage = "No metadata support for this format";
-      model->updatePhoto(i, photo);
-      emit photoProcessed(i, false);
+int PhotoProcessor::previewMatches(PhotoListModel *model,
+                                   const ProcessingSettings &settings) {
+  if (isProcessing() || !hasGpxLoaded())
+    return 0;
+
+  const QVector<PhotoItem> &photos = model->photos();
+  const qint64 offsetMs =
+      static_cast<qint64>(settings.timeOffsetHours * 3600.0) * 1000;
+
+  // Unwritten photos with a known capture time, ordered by UTC time. A dry
+  // run or an unmatched skip says nothing about the next run at this offset
+  QVector<int> rows;
+  rows.reserve(photos.size());
+  for (int i = 0; i < photos.size(); ++i) {
+    const PhotoItem &photo = photos[i];
+    if (photo.gpsWritten || photo.state == PhotoState::Error)
       continue;
+    if (photo.rawCaptureMs &&
+        (!photo.hasExistingGps || settings.overwriteExistingGps)) {
+      rows.append(i);
+    } else if (photo.hasMatchedCoordinates()) {
+      // Would be skipped now; drop the marker of an earlier preview
+      PhotoItem &item = model->photoAt(i);
+      item.matchedLat.reset();
+      item.matchedLon.reset();
+      item.matchedElevation.reset();
+      model->markDirty(i);
     }
+  }
+  std::sort(rows.begin(), rows.end(), [&photos](int a, int b) {
+    return *photos[a].rawCaptureMs < *photos[b].rawCaptureMs;
+  });
+
+  QVector<qint64> timesMs;
+  timesMs.reserve(rows.size());
+  for (int row : rows) {
+    timesMs.append(*photos[row].rawCaptureMs - offsetMs);
+  }
 
-    // Skip if already has GPS and not overwriting
-    if (photo.hasExistingGps && !settings.overwriteExistingGps) {
-      photo.state = PhotoState::Skipped;
-      photo.errorMessage = "Already has GPS data";
-      model->updatePhoto(i, photo);
-      emit photoProcessed(i, false);
-      continue;
+  const GpsMatcher matcher(m_trackSet, effectiveMaxTimeDiff(settings),
+                           settings.forceInterpolate);
+  const QVector<std::optional<GpsMatch>> matches =
+      matcher.findGpsForPhotos(timesMs);
+
+  int matched = 0;
+  for (int k = 0; k < rows.size(); ++k) {
+    PhotoItem &photo = model->photoAt(rows[k]);
+    photo.state = PhotoState::Pending;
+    photo.errorMessage.clear();
+    if (matches[k]) {
+      const auto &[lat, lon, elevation] = *matches[k];
+      photo.matchedLat = lat;
+      photo.matchedLon = lon;
+      photo.matchedElevation = elevation;
+      ++matched;
+    } else {
+      photo.matchedLat.reset();
+      photo.matchedLon.reset();
+      photo.matchedElevation.reset();
     }
+    model->markDirty(rows[k]);
+  }
 
-    // Get photo timestamp
-    auto timestamp =
-        ExifHandler::getPhotoTimestamp(photo.filePath, timeOffsetSeconds);
-    if (!timestamp.has_value()) {
-      photo.state = PhotoState::Skipped;
-      photo.errorMessage = "No timestamp found";
-      model->updatePhoto(i, photo);
-      emit photoProcessed(i, false);
-      continue;
+  // Show the new positions now rather than on the next flush tick
+  model->flushUpdates();
+  return matched;
+}
+
+std::optional<OffsetSuggestion> PhotoProcessor::suggestTimeOffset(
+    const PhotoListModel *model, const ProcessingSettings &settings,
+    double minHours, double maxHours, double stepHours) const {
+  if (!hasGpxLoaded() || stepHours <= 0 || maxHours < minHours)
+    return std::nullopt;
+
+  QVector<qint64> rawTimesMs;
+  rawTimesMs.reserve(model->count());
+  for (const PhotoItem &photo : model->photos()) {
+    if (photo.rawCaptureMs) {
+      rawTimesMs.append(*photo.rawCaptureMs);
+    }
+  }
+  if (rawTimesMs.isEmpty())
+    return std::nullopt;
+  std::sort(rawTimesMs.begin(), rawTimesMs.end());
+
+  const std::vector<qint64> &trackTimes = m_track->timesMs();
+  const qint64 capMs =
+      static_cast<qint64>(effectiveMaxTimeDiff(settings) * 1000.0);
+
+  std::optional<OffsetSuggestion> best;
+  qint64 bestCost = 0;
+  const int steps =
+      static_cast<int>(std::floor((maxHours - minHours) / stepHours + 1e-9));
+  for (int step = 0; step <= steps; ++step) {
+    const double hours = minHours + step * stepHours;
+    const qint64 offsetMs = static_cast<qint64>(hours * 3600.0) * 1000;
+
+    // Photo times are sorted, so the track cursor only moves forward
+    qint64 cost = 0;
+    int matched = 0;
+    auto it = trackTimes.begin();
+    for (qint64 rawMs : rawTimesMs) {
+      const qint64 timeMs = rawMs - offsetMs;
+      it = std::lower_bound(it, trackTimes.end(), timeMs);
+      qint64 gap = capMs;
+      if (it != trackTimes.end()) {
+        gap = std::min(gap, *it - timeMs);
+      }
+      if (it != trackTimes.begin()) {
+        gap = std::min(gap, timeMs - *(it - 1));
+      }
+      if (gap < capMs) {
+        ++matched;
+      }
+      cost += gap;
     }
 
-    photo.captureTime = timestamp.value();
+    const bool better =
+        !best || cost < bestCost ||
+        (cost == bestCost &&
+         std::abs(hours - settings.timeOffsetHours) <
+             std::abs(best->timeOffsetHours - settings.timeOffsetHours));
+    if (better) {
+      best = OffsetSuggestion{hours, matched,
+                              static_cast<int>(rawTimesMs.size())};
+      bestCost = cost;
+    }
+  }
 
-    // Find GPS coordinates
-    auto gpsResult = matcher.findGpsForPhoto(photo.captureTime);
-    if (!gpsResult.has_value()) {
-      photo.state = PhotoState::Skipped;
-      if (matcher.isWithinTrackRange(photo.captureTime)) {
-        photo.errorMessage = "No GPS match within time threshold";
-      } else {
-        photo.errorMessage = "Photo time outside GPX range";
-      }
-      model->updatePhoto(i, photo);
-      emit photoProcessed(i, false);
+  return best;
+}
+
+void PhotoProcessor::onPhotoStarted(int index) {
+  if (!m_model || index >= m_model->count() || index < m_nextResult)
+    return;
+
+  PhotoItem &photo = m_model->photoAt(index);
+  if (photo.state != PhotoState::Pending)
+    return;
+  photo.state = PhotoState::Processing;
+  m_model->markDirty(index);
+}
+
+void PhotoProcessor::onPhotoResult(int index, const QString &filePath,
+                                   const PhotoResult &result, bool cancelled) {
+  m_pendingResults.insert(index, {filePath, result, cancelled});
+  ScopedTimer timer(PerfStage::ModelUpdate);
+
+  // Commit results to the model strictly in index order
+  const int firstCommitted = m_nextResult;
+  while (!m_pendingResults.isEmpty() &&
+         m_pendingResults.firstKey() == m_nextResult) {
+    const int i = m_nextResult++;
+    PendingResult pending = m_pendingResults.take(i);
+
+    // The model may have been edited while workers were running
+    bool rowValid = m_model && i < m_model->count() &&
+                    m_model->photos()[i].filePath == pending.filePath;
+    if (!rowValid)
       continue;
-    }
 
-    auto [lat, lon, elevation] = gpsResult.value();
-    photo.matchedLat = lat;
-    photo.matchedLon = lon;
-    photo.matchedElevation = elevation;
-
-    // Write GPS data (unless dry run)
-    if (!settings.dryRun) {
-      bool writeSuccess = false;
-
-      if (formatInfo.level == FormatSupportLevel::NeedsExifTool) {
-        // Use exiftool for BMFF formats
-        if (!ExifToolWriter::isAvailable()) {
-          photo.state = PhotoState::Error;
-          photo.errorMessage =
-              "exiftool not found - install it to write to this format";
-          model->updatePhoto(i, photo);
-          emit photoProcessed(i, false);
-          continue;
-        }
-        writeSuccess =
-            ExifToolWriter::writeGpsData(photo.filePath, lat, lon, elevation);
-        if (!writeSuccess) {
-          photo.state = PhotoState::Error;
-          photo.errorMessage = ExifToolWriter::lastError();
-          model->updatePhoto(i, photo);
-          emit photoProcessed(i, false);
-          continue;
-        }
-      } else {
-        // Use exiv2 for FullWrite and DangerousRAW formats
-        writeSuccess =
-            ExifHandler::writeGpsData(photo.filePath, lat, lon, elevation);
-        if (!writeSuccess) {
-          photo.state = PhotoState::Error;
-          photo.errorMessage = ExifHandler::lastError();
-          model->updatePhoto(i, photo);
-          emit photoProcessed(i, false);
-          continue;
-        }
+    // Edit the row in place; the model batches the notifications
+    PhotoItem &photo = m_model->photoAt(i);
+    if (!pending.cancelled) {
+      PhotoResult &r = pending.result;
+      photo.state = r.state;
+      photo.errorMessage = std::move(r.errorMessage);
+      photo.gpsWritten = r.gpsWritten;
+      if (r.captureTime.isValid()) {
+        photo.captureTime = r.captureTime;
+      }
+      photo.matchedLat = r.matchedLat;
+      photo.matchedLon = r.matchedLon;
+      photo.matchedElevation = r.matchedElevation;
+      m_model->markDirty(i);
+
+      const bool success = photo.state == PhotoState::Success;
+      if (success) {
+        ++m_successCount;
       }
+      emit photoProcessed(i, success);
+    } else if (photo.state == PhotoState::Processing) {
+      photo.state = PhotoState::Pending;
+      m_model->markDirty(i);
     }
+  }
 
-    photo.state = PhotoState::Success;
-    model->updatePhoto(i, photo);
-    emit photoProcessed(i, true);
-    ++successCount;
+  if (m_nextResult > firstCommitted &&
+      (m_nextResult == m_totalCount ||
+       m_progressTimer.elapsed() >= kProgressIntervalMs)) {
+    m_progressTimer.restart();
+    emit progressUpdated(m_nextResult, m_totalCount);
   }
 
-  qInfo() << "Processing complete:" << successCount << "/" << model->count()
+  if (m_nextResult < m_totalCount)
+    return;
+
+  if (m_stopRequested) {
+    qInfo() << "Processing stopped by user";
+  }
+  qInfo() << "Processing complete:" << m_successCount << "/" << m_totalCount
           << "photos updated";
-  emit processingComplete(successCount, model->count());
+  if (m_model) {
+    m_model->flushUpdates();
+  }
+  m_model.clear();
+  m_pipeline.reset();
+  ScanCache::flush();
+  if (m_journal) {
+    m_journal->flush();
+  }
+
+  if (PerfTrace::isEnabled()) {
+    qInfo().noquote() << PerfTrace::summary(m_totalCount, m_runTimer.elapsed());
+    if (!m_traceFilePath.isEmpty()) {
+      if (PerfTrace::writeChromeTrace(m_traceFilePath)) {
+        qInfo() << "Wrote trace to" << m_traceFilePath;
+      } else {
+        qWarning() << "Failed to write trace to" << m_traceFilePath;
+      }
+    }
+  }
+  emit processingComplete(m_successCount, m_totalCount);
 }
 
-void PhotoProcessor::stopProcessing() { m_stopRequested = true; }
+void PhotoProcessor::stopProcessing() {
+  m_stopRequested = true;
+  if (m_pipeline) {
+    m_pipeline->stop();
+  }
+}
 
 } // namespace lyp
@@ -1,14 +1,35 @@
 #pragma once
 
+#include "core/directory_scanner.h"
+#include "core/track_set.h"
 #include "models/photo_item.h"
-#include "models/track_point.h"
+#include "models/track_store.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMap>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QThreadPool>
 #include <QVector>
 #include <QFuture>
+#include <atomic>
+#include <memory>
+#include <optional>
 
 namespace lyp {
 
+class BatchJournal;
 class PhotoListModel;
+class PhotoPipeline;
+
+/**
+ * @brief Where matched coordinates are written.
+ */
+enum class OutputMode {
+    EmbedInFile,    // Rewrite the photo's EXIF (exiv2 or exiftool)
+    XmpSidecar      // Write only a small .xmp file next to the photo
+};
 
 /**
  * @brief Processing settings for photo geotagging.
@@ -19,18 +40,51 @@ struct ProcessingSettings {
     bool overwriteExistingGps = false;  // Overwrite photos that already have GPS
     bool forceInterpolate = false;      // Always interpolate regardless of time diff
     bool dryRun = false;                // Preview only, don't write changes
+    int workerCount = 0;                // Reader and writer threads each (0 = one per CPU core)
+    int maxFilesInFlight = 0;           // Files read but not yet reported (0 = 4 per reader)
+    OutputMode outputMode = OutputMode::EmbedInFile;
+    QString traceFilePath;              // Chrome trace written after a run (needs PerfTrace enabled)
+    QString journalFilePath;            // Resume journal and audit log (empty = none; unused in dry runs)
+};
+
+/**
+ * @brief Outcome of processing a single photo on a worker thread.
+ *
+ * Only the fields processing can change; applied to the model row in place.
+ */
+struct PhotoResult {
+    PhotoState state = PhotoState::Pending;
+    QString errorMessage;
+    QDateTime captureTime;              // Invalid if not read
+    bool gpsWritten = false;            // The photo or its sidecar holds the match
+    std::optional<double> matchedLat;
+    std::optional<double> matchedLon;
+    std::optional<double> matchedElevation;
+};
+
+/**
+ * @brief Camera offset proposed by PhotoProcessor::suggestTimeOffset().
+ */
+struct OffsetSuggestion {
+    double timeOffsetHours = 0.0;
+    int matchedCount = 0;   // Photos within the time threshold at this offset
+    int photoCount = 0;     // Photos with a known capture time
 };
 
 /**
  * @brief Orchestrates the photo geotagging process.
  * 
  * Coordinates GPX parsing, photo scanning, GPS matching, and EXIF writing.
+ * Photos are processed in a read/match/write pipeline (see PhotoPipeline);
+ * results are committed back to the model in order on the thread that owns
+ * the processor.
  */
 class PhotoProcessor : public QObject {
     Q_OBJECT
 
 public:
     explicit PhotoProcessor(QObject* parent = nullptr);
+    ~PhotoProcessor() override;
     
     /**
      * @brief Load a GPX trace file.
@@ -40,33 +94,170 @@ public:
     bool loadGpxFile(const QString& filePath);
     
     /**
-     * @brief Get the loaded trackpoints.
+     * @brief Load several GPX files as one merged, time-sorted track.
+     * @param filePaths Paths to GPX files
+     * @return true if any trackpoints were loaded
+     */
+    bool loadGpxFiles(const QStringList& filePaths);
+    
+    /**
+     * @brief Load GPX files in the background.
+     *
+     * Each file is loaded through the track cache by its own pool task and
+     * several files are merged off the calling thread. gpxLoadProgress()
+     * reports finished files; gpxLoaded() or gpxLoadError() ends the load.
+     * A new load supersedes a running one.
+     * @param filePaths Paths to GPX files
+     */
+    void loadGpxFilesAsync(const QStringList& filePaths);
+    
+    /**
+     * @brief Load the GPX files again, e.g. while one is still recording.
+     *
+     * Unchanged files come from the track cache. Unlike loadGpxFiles(), a
+     * load without trackpoints keeps the current track, since a logger may
+     * be halfway through rewriting its file.
+     * @param filePaths Paths to GPX files
+     * @return true if the track was replaced
      */
-    const QVector<TrackPoint>& trackpoints() const { return m_trackpoints; }
+    bool reloadGpxFiles(const QStringList& filePaths);
     
     /**
-     * @brief Scan photo files and populate the model.
+     * @brief Abandon a running background GPX load; the current track stays.
+     */
+    void cancelGpxLoad();
+    
+    /**
+     * @brief Check if a background GPX load is in progress.
+     */
+    bool isLoadingGpx() const { return m_gpxLoadTotal > 0; }
+    
+    /**
+     * @brief Get the loaded track (may be null before the first load).
+     *
+     * With several GPX files this is the merged timeline with overlapping
+     * points of less accurate sources left out; see trackSet().
+     */
+    TrackStorePtr track() const { return m_track; }
+    
+    /**
+     * @brief Get the loaded sources with overlaps resolved (may be null).
+     */
+    TrackSetPtr trackSet() const { return m_trackSet; }
+    
+    /**
+     * @brief Scan photo files and populate the model in the background.
+     *
+     * Unsupported and duplicate paths are filtered immediately; metadata is
+     * probed on the worker pool and rows are appended in chunks, in the order
+     * given. May be called again while a scan is running.
      * @param filePaths List of photo file paths
      * @param model Model to populate with photo items
      */
     void scanPhotos(const QStringList& filePaths, PhotoListModel* model);
     
     /**
-     * @brief Process all photos in the model.
+     * @brief Recursively add supported photos under directories.
+     *
+     * Files are fed into scanPhotos() in batches as the parallel walk finds
+     * them; photosScanComplete() is emitted once the walk and all scanning
+     * have finished.
+     * @param directories Root directories
+     * @param model Model to populate with photo items
+     */
+    void scanDirectories(const QStringList& directories, PhotoListModel* model);
+    
+    /**
+     * @brief Drop all pending scan results.
+     */
+    void cancelScan();
+    
+    /**
+     * @brief Check if a photo scan is in progress.
+     */
+    bool isScanning() const {
+        return m_scanDone < m_scanTotal || m_dirScanner->isRunning();
+    }
+    
+    /**
+     * @brief Start processing all photos in the model.
+     *
+     * Returns immediately; progress is reported through signals and
+     * processingComplete() is emitted once every photo has been accounted for.
      * @param model Photo list model
      * @param settings Processing settings
      */
     void processPhotos(PhotoListModel* model, const ProcessingSettings& settings);
     
+    /**
+     * @brief Re-match photos in memory, e.g. while the time offset is tuned.
+     *
+     * Uses the capture times cached at scan time and the batch matcher, so no
+     * file is read. Every photo whose position was not written, including
+     * dry-run results and skipped photos, goes back to pending and its
+     * matched coordinates (and so the map markers) follow the settings.
+     * Failed photos keep their error. Does nothing while processing.
+     * @param model Photo list model
+     * @param settings Processing settings
+     * @return Number of re-matched photos with a match
+     */
+    int previewMatches(PhotoListModel* model, const ProcessingSettings& settings);
+    
+    /**
+     * @brief Find the camera offset that best aligns photos with the track.
+     *
+     * Each candidate offset is scored by the photos' distance in time to
+     * their nearest trackpoint, capped at the effective max time difference;
+     * the lowest total wins, ties going to the offset closest to the current
+     * setting.
+     * @param model Photo list model
+     * @param settings Current settings (time threshold and offset)
+     * @param minHours First offset tried
+     * @param maxHours Last offset tried
+     * @param stepHours Spacing of the candidates
+     * @return Best offset, or nullopt without a track or capture times
+     */
+    std::optional<OffsetSuggestion> suggestTimeOffset(
+        const PhotoListModel* model, const ProcessingSettings& settings,
+        double minHours, double maxHours, double stepHours) const;
+    
     /**
      * @brief Stop ongoing processing.
+     *
+     * Photos already being written are finished; the rest are left pending.
      */
     void stopProcessing();
     
+    /**
+     * @brief Check if a processing run is in progress.
+     */
+    bool isProcessing() const { return !m_model.isNull(); }
+    
+    /**
+     * @brief Set how long idle processing threads are kept.
+     *
+     * Every run uses the same stage threads while they are alive, and each
+     * writer thread keeps its exiftool session, so runs started in short
+     * succession skip the process start-up.
+     * @param msecs Idle time before a thread exits (negative = never)
+     */
+    void setStageThreadExpiry(int msecs) { m_stageThreads->setExpiryTimeout(msecs); }
+    
+    /**
+     * @brief Keep the batch journal open across runs with one fingerprint.
+     *
+     * Saves reading the journal and syncing a run line for every run, which
+     * dominates when each run is a few photos. Photos written by one run are
+     * then not known to be done by the next, so use this only when runs
+     * never repeat photos.
+     * @param keep Whether to keep the journal open
+     */
+    void setKeepJournalOpen(bool keep);
+    
     /**
      * @brief Check if GPX is loaded.
      */
-    bool hasGpxLoaded() const { return !m_trackpoints.isEmpty(); }
+    bool hasGpxLoaded() const { return m_track && !m_track->isEmpty(); }
 
 signals:
     /**
@@ -81,12 +272,26 @@ signals:
      */
     void gpxLoadError(const QString& error);
     
+    /**
+     * @brief Emitted as files of a background GPX load finish.
+     * @param filesDone Files loaded so far
+     * @param fileCount Files in the load
+     */
+    void gpxLoadProgress(int filesDone, int fileCount);
+    
     /**
      * @brief Emitted when photo scanning is complete.
      * @param photoCount Number of photos found
      */
     void photosScanComplete(int photoCount);
     
+    /**
+     * @brief Emitted as scanned photos are added to the model.
+     * @param current Number of files scanned so far
+     * @param total Number of files queued for scanning
+     */
+    void scanProgress(int current, int total);
+    
     /**
      * @brief Emitted when a single photo is processed.
      * @param index Photo index in model
@@ -102,16 +307,76 @@ signals:
     void processingComplete(int successCount, int totalCount);
     
     /**
-     * @brief Emitted with progress updates.
+     * @brief Emitted with progress updates, at most every 50 ms.
      * @param current Current photo index
      * @param total Total photos
      */
     void progressUpdated(int current, int total);
 
 private:
-    QVector<TrackPoint> m_trackpoints;
+    struct PendingResult {
+        QString filePath;
+        PhotoResult result;
+        bool cancelled = false;
+    };
+    
+    void onPhotoStarted(int index);
+    void onPhotoResult(int index, const QString& filePath,
+                       const PhotoResult& result, bool cancelled);
+    void onScanChunk(int chunk, quint64 generation, const QVector<PhotoItem>& items);
+    void finishScan();
+    void onGpxFileLoaded(quint64 generation, int index,
+                         const TrackStorePtr& track, const QString& error);
+    void onGpxTrackReady(quint64 generation, const TrackSetPtr& tracks,
+                         const QString& error);
+    bool finishGpxLoad(const QString& error);
+    double effectiveMaxTimeDiff(const ProcessingSettings& settings) const;
+    
+    TrackSetPtr m_trackSet;
+    TrackStorePtr m_track;          // m_trackSet's resolved track
     QString m_gpxFilePath;
-    bool m_stopRequested = false;
+    std::atomic<bool> m_stopRequested{false};
+    
+    // Background GPX load; results of superseded loads are dropped
+    std::atomic<quint64> m_gpxGeneration{0};
+    QStringList m_gpxLoadPaths;
+    QVector<TrackStorePtr> m_gpxLoadTracks;
+    QStringList m_gpxLoadErrors;
+    int m_gpxLoadTotal = 0;
+    int m_gpxLoadDone = 0;
+    
+    // Worker pool for scans and GPX loads
+    QThreadPool* m_pool;
+    
+    // Pipeline stage threads, shared by consecutive runs
+    QThreadPool* m_stageThreads;
+    
+    // Pipeline and in-order commit state for the current run
+    std::unique_ptr<PhotoPipeline> m_pipeline;
+    QPointer<PhotoListModel> m_model;
+    QMap<int, PendingResult> m_pendingResults;
+    int m_nextResult = 0;
+    int m_totalCount = 0;
+    int m_successCount = 0;
+    QElapsedTimer m_progressTimer;
+    QElapsedTimer m_runTimer;
+    QString m_traceFilePath;
+    
+    // Journal kept for later runs (see setKeepJournalOpen())
+    bool m_keepJournalOpen = false;
+    std::shared_ptr<BatchJournal> m_journal;
+    
+    // Background scan state; chunks are committed in dispatch order
+    DirectoryScanner* m_dirScanner;
+    QPointer<PhotoListModel> m_scanModel;
+    QSet<QString> m_scanQueuedPaths;
+    QMap<int, QVector<PhotoItem>> m_pendingScanChunks;
+    std::atomic<quint64> m_scanGeneration{0};
+    int m_nextScanChunk = 0;
+    int m_dispatchedScanChunks = 0;
+    int m_scanTotal = 0;
+    int m_scanDone = 0;
+    int m_scanAdded = 0;
 };
 
 } // namespace lyp
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <optional>
+#include <utility>
+
+namespace lyp {
+
+/**
+ * @brief A value, or the error that prevented it.
+ *
+ * Returned by operations that used to report failures through a static
+ * lastError(), so the error travels with the call that produced it and
+ * concurrent callers never see each other's messages.
+ */
+template <typename T> class Result {
+public:
+  Result(T value) : m_value(std::move(value)) {}
+
+  static Result failure(QString error) {
+    Result result;
+    result.m_error = std::move(error);
+    return result;
+  }
+
+  bool ok() const { return m_value.has_value(); }
+  explicit operator bool() const { return ok(); }
+
+  const T &value() const & {
+    Q_ASSERT(ok());
+    return *m_value;
+  }
+  T &value() & {
+    Q_ASSERT(ok());
+    return *m_value;
+  }
+  T &&value() && {
+    Q_ASSERT(ok());
+    return std::move(*m_value);
+  }
+
+  /**
+   * @brief The value, or fallback on failure.
+   */
+  T valueOr(T fallback) const & { return m_value ? *m_value : fallback; }
+
+  /**
+   * @brief Error message; empty on success.
+   */
+  const QString &error() const { return m_error; }
+
+private:
+  Result() = default;
+
+  std::optional<T> m_value;
+  QString m_error;
+};
+
+/**
+ * @brief Success, or the error of an operation without a value.
+ *
+ * Default-constructed is success.
+ */
+class Status {
+public:
+  Status() = default;
+
+  static Status success() { return Status(); }
+
+  static Status failure(QString error) {
+    Status status;
+    status.m_ok = false;
+    status.m_error = std::move(error);
+    return status;
+  }
+
+  bool ok() const { return m_ok; }
+  explicit operator bool() const { return ok(); }
+
+  /**
+   * @brief Error message; empty on success.
+   */
+  const QString &error() const { return m_error; }
+
+private:
+  bool m_ok = true;
+  QString m_error;
+};
+
+} // namespace lyp
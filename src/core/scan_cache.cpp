@@ -0,0 +1,302 @@
+#include "scan_cache.h"
+#include "fast_exif_probe.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimeZone>
+#include <cstring>
+
+namespace lyp {
+
+namespace {
+
+constexpr char kMagic[8] = {'L', 'Y', 'P', 'S', 'C', 'N', '\0', '\0'};
+constexpr quint32 kVersion = 1;
+constexpr quint32 kByteOrderMark = 0x01020304;
+
+constexpr quint8 kFlagHasGps = 0x01;
+constexpr quint8 kFlagHasCaptureTime = 0x02;
+
+// Compact once the log holds this many more records than live entries
+constexpr int kCompactionSlack = 4096;
+
+struct LogHeader {
+  char magic[8];
+  quint32 version;
+  quint32 byteOrderMark;
+};
+
+/**
+ * @brief Fixed part of a log record, followed by pathBytes of UTF-8 path.
+ *
+ * Records are stored in native byte order; later records for the same path
+ * supersede earlier ones.
+ */
+struct RecordHeader {
+  qint64 fileSize;
+  qint64 mtimeMs;
+  qint64 captureTimeMs;
+  quint32 pathBytes;
+  quint8 flags;
+  quint8 level;
+  quint16 reserved;
+};
+
+struct StoredEntry {
+  qint64 fileSize = 0;
+  qint64 mtimeMs = 0;
+  ScanCacheEntry entry;
+};
+
+struct CacheState {
+  QMutex mutex;
+  bool loaded = false;
+  QHash<QString, StoredEntry> entries;
+  QByteArray pending; // Encoded records not yet on disk
+  qint64 pendingRecords = 0;
+  qint64 recordsOnDisk = 0;
+  bool rewrite = false; // Existing file is unusable; replace it on flush
+};
+
+CacheState &cacheState() {
+  static CacheState state;
+  return state;
+}
+
+bool statFile(const QString &filePath, qint64 &size, qint64 &mtimeMs) {
+  const QFileInfo info(filePath);
+  if (!info.isFile())
+    return false;
+  size = info.size();
+  mtimeMs = info.lastModified().toMSecsSinceEpoch();
+  return true;
+}
+
+void appendRecord(QByteArray &out, const QString &filePath,
+                  const StoredEntry &stored) {
+  const QByteArray path = filePath.toUtf8();
+
+  RecordHeader record = {};
+  record.fileSize = stored.fileSize;
+  record.mtimeMs = stored.mtimeMs;
+  record.captureTimeMs = stored.entry.captureTimeMs.value_or(0);
+  record.pathBytes = static_cast<quint32>(path.size());
+  record.flags = (stored.entry.hasGps ? kFlagHasGps : 0) |
+                 (stored.entry.captureTimeMs ? kFlagHasCaptureTime : 0);
+  record.level = static_cast<quint8>(stored.entry.level);
+
+  out.append(reinterpret_cast<const char *>(&record), sizeof(record));
+  out.append(path);
+}
+
+QByteArray encodeHeader() {
+  LogHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byteOrderMark = kByteOrderMark;
+  return QByteArray(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void loadLocked(CacheState &state) {
+  state.loaded = true;
+
+  QFile file(ScanCache::cacheFilePath());
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  const QByteArray data = file.readAll();
+  LogHeader header;
+  if (data.size() < qsizetype(sizeof(header)))
+    return;
+  std::memcpy(&header, data.constData(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.byteOrderMark != kByteOrderMark) {
+    qInfo() << "Ignoring incompatible scan cache" << file.fileName();
+    state.rewrite = true;
+    return;
+  }
+
+  // A torn tail from an interrupted append is simply ignored
+  qsizetype pos = sizeof(header);
+  while (pos + qsizetype(sizeof(RecordHeader)) <= data.size()) {
+    RecordHeader record;
+    std::memcpy(&record, data.constData() + pos, sizeof(record));
+    pos += sizeof(record);
+    if (record.pathBytes > quint32(data.size() - pos))
+      break;
+
+    StoredEntry stored;
+    stored.fileSize = record.fileSize;
+    stored.mtimeMs = record.mtimeMs;
+    stored.entry.hasGps = record.flags & kFlagHasGps;
+    if (record.flags & kFlagHasCaptureTime) {
+      stored.entry.captureTimeMs = record.captureTimeMs;
+    }
+    stored.entry.level = static_cast<FormatSupportLevel>(record.level);
+
+    state.entries.insert(
+        QString::fromUtf8(data.constData() + pos, record.pathBytes), stored);
+    pos += record.pathBytes;
+    ++state.recordsOnDisk;
+  }
+
+  // Never append after a torn record; rewrite the log instead
+  if (pos != data.size()) {
+    state.rewrite = true;
+  }
+}
+
+} // namespace
+
+std::optional<QDateTime>
+ScanCacheEntry::captureTime(double timeOffsetSeconds) const {
+  if (!captureTimeMs)
+    return std::nullopt;
+  return QDateTime::fromMSecsSinceEpoch(*captureTimeMs, QTimeZone::utc())
+      .addSecs(static_cast<qint64>(-timeOffsetSeconds));
+}
+
+QString ScanCache::cacheFilePath() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/scan-index.lypscan";
+}
+
+std::optional<ScanCacheEntry> ScanCache::lookup(const QString &filePath) {
+  qint64 size = 0;
+  qint64 mtimeMs = 0;
+  if (!statFile(filePath, size, mtimeMs))
+    return std::nullopt;
+
+  CacheState &state = cacheState();
+  QMutexLocker locker(&state.mutex);
+  if (!state.loaded) {
+    loadLocked(state);
+  }
+
+  auto it = state.entries.constFind(filePath);
+  if (it == state.entries.constEnd() || it->fileSize != size ||
+      it->mtimeMs != mtimeMs) {
+    return std::nullopt;
+  }
+  return it->entry;
+}
+
+void ScanCache::insert(const QString &filePath, const ScanCacheEntry &entry) {
+  StoredEntry stored;
+  stored.entry = entry;
+  if (!statFile(filePath, stored.fileSize, stored.mtimeMs))
+    return;
+
+  CacheState &state = cacheState();
+  QMutexLocker locker(&state.mutex);
+  if (!state.loaded) {
+    loadLocked(state);
+  }
+
+  state.entries.insert(filePath, stored);
+  appendRecord(state.pending, filePath, stored);
+  ++state.pendingRecords;
+}
+
+Result<ScanCacheEntry> ScanCache::loadOrProbe(const QString &filePath) {
+  if (auto cached = lookup(filePath)) {
+    return *cached;
+  }
+
+  ScanCacheEntry entry;
+  entry.level = ExifHandler::getFormatInfo(filePath).level;
+
+  std::optional<QDateTime> captureTime;
+  if (auto probe = FastExifProbe::probe(filePath)) {
+    entry.hasGps = probe->hasGps;
+    captureTime = probe->captureTime(0.0);
+  } else {
+    MetadataSession session(filePath);
+    if (!session.isOpen()) {
+      return Result<ScanCacheEntry>::failure(session.lastError());
+    }
+    entry.hasGps = session.hasGpsData();
+    captureTime = session.timestamp(0.0);
+  }
+  if (captureTime) {
+    entry.captureTimeMs = captureTime->toMSecsSinceEpoch();
+  }
+
+  insert(filePath, entry);
+  return entry;
+}
+
+bool ScanCache::flush() {
+  CacheState &state = cacheState();
+  QMutexLocker locker(&state.mutex);
+  if (state.pending.isEmpty())
+    return true;
+
+  const QString path = cacheFilePath();
+  if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+    qWarning() << "Cannot create scan cache directory for" << path;
+    return false;
+  }
+
+  const bool compact =
+      state.rewrite ||
+      state.recordsOnDisk + state.pendingRecords >
+          state.entries.size() + kCompactionSlack;
+
+  if (compact) {
+    // Rewrite only the live entries
+    QByteArray data = encodeHeader();
+    for (auto it = state.entries.constBegin(); it != state.entries.constEnd();
+         ++it) {
+      appendRecord(data, it.key(), it.value());
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() ||
+        !file.commit()) {
+      qWarning() << "Failed to write scan cache" << path;
+      return false;
+    }
+    state.recordsOnDisk = state.entries.size();
+    state.pending.clear();
+    state.pendingRecords = 0;
+    state.rewrite = false;
+    return true;
+  }
+
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    qWarning() << "Failed to open scan cache" << path;
+    return false;
+  }
+  if (file.size() == 0) {
+    file.write(encodeHeader());
+  }
+  if (file.write(state.pending) != state.pending.size()) {
+    qWarning() << "Failed to append to scan cache" << path;
+    return false;
+  }
+  state.recordsOnDisk += state.pendingRecords;
+  state.pending.clear();
+  state.pendingRecords = 0;
+  return true;
+}
+
+void ScanCache::clear() {
+  CacheState &state = cacheState();
+  QMutexLocker locker(&state.mutex);
+  state.entries.clear();
+  state.pending.clear();
+  state.pendingRecords = 0;
+  state.recordsOnDisk = 0;
+  state.rewrite = false;
+  state.loaded = true;
+  QFile::remove(cacheFilePath());
+}
+
+} // namespace lyp
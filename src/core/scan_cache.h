@@ -0,0 +1,76 @@
+#pragma once
+
+#include "core/exif_handler.h"
+#include "core/result.h"
+#include <QString>
+#include <optional>
+
+namespace lyp {
+
+/**
+ * @brief Scan results remembered for one photo file.
+ */
+struct ScanCacheEntry {
+  std::optional<qint64> captureTimeMs; // EXIF time read as UTC, no offset
+  bool hasGps = false;
+  FormatSupportLevel level = FormatSupportLevel::FullWrite;
+
+  /**
+   * @brief Capture time with a camera offset applied (see ExifHandler).
+   */
+  std::optional<QDateTime> captureTime(double timeOffsetSeconds) const;
+};
+
+/**
+ * @brief Persistent index of photo scan results across sessions.
+ *
+ * A flat append-only binary log in the cache directory, keyed by file path
+ * and validated against the file's size and modification time, so changed
+ * files miss automatically. The log is loaded on first use, new entries are
+ * buffered until flush(), and it is compacted when superseded records
+ * dominate. All functions are thread-safe.
+ */
+class ScanCache {
+public:
+  /**
+   * @brief Look up a file whose size and mtime still match.
+   * @param filePath Path to the photo file
+   * @return Cached entry, or nullopt on a miss or stale entry
+   */
+  static std::optional<ScanCacheEntry> lookup(const QString &filePath);
+
+  /**
+   * @brief Record scan results for a file as it is now on disk.
+   * @param filePath Path to the photo file
+   * @param entry Scan results
+   */
+  static void insert(const QString &filePath, const ScanCacheEntry &entry);
+
+  /**
+   * @brief Look up a file, or probe its metadata and cache the result.
+   *
+   * A file that cannot be read is not cached, so it is probed again next
+   * time rather than remembered as having no metadata.
+   * @param filePath Path to the photo file
+   * @return Cached or probed entry, or why the file could not be read
+   */
+  static Result<ScanCacheEntry> loadOrProbe(const QString &filePath);
+
+  /**
+   * @brief Append buffered entries to the log on disk.
+   * @return true on success
+   */
+  static bool flush();
+
+  /**
+   * @brief Forget all entries and delete the log.
+   */
+  static void clear();
+
+  /**
+   * @brief Location of the log file.
+   */
+  static QString cacheFilePath();
+};
+
+} // namespace lyp
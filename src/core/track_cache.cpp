@@ -0,0 +1,199 @@
+#include "track_cache.h"
+#include "gpx_parser.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+#include <limits>
+
+namespace lyp {
+
+namespace {
+
+constexpr char kMagic[8] = {'L', 'Y', 'P', 'T', 'R', 'K', '\0', '\0'};
+constexpr quint32 kVersion = 2;
+constexpr quint32 kByteOrderMark = 0x01020304;
+
+/**
+ * @brief Fixed-size cache file header, followed by the column arrays.
+ *
+ * Arrays are stored in native byte order, 8-byte aligned, in the order:
+ * times (int64), latitudes (double), longitudes (double), elevations
+ * (float, padded to 8 bytes), elevation validity bitmap (uint64), segment
+ * start bitmap (uint64).
+ */
+struct CacheHeader {
+  char magic[8];
+  quint32 version;
+  quint32 byteOrderMark;
+  qint64 sourceSize;
+  qint64 sourceMtimeMs;
+  qint64 pointCount;
+};
+
+qint64 paddedTo8(qint64 bytes) { return (bytes + 7) & ~qint64(7); }
+
+qint64 payloadSize(qint64 count) {
+  return count * qint64(sizeof(qint64)) + 2 * count * qint64(sizeof(double)) +
+         paddedTo8(count * qint64(sizeof(float))) +
+         2 * ((count + 63) / 64) * qint64(sizeof(quint64));
+}
+
+} // namespace
+
+QString TrackCache::cacheFilePath(const QString &gpxPath) {
+  const QString absolutePath = QFileInfo(gpxPath).absoluteFilePath();
+  const QByteArray key =
+      QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Sha1)
+          .toHex();
+  const QString dir =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+      "/tracks";
+  return QString("%1/%2.lyptrack").arg(dir, QString::fromLatin1(key));
+}
+
+TrackStorePtr TrackCache::load(const QString &gpxPath) {
+  QFileInfo source(gpxPath);
+  if (!source.exists()) {
+    return nullptr;
+  }
+
+  QFile file(cacheFilePath(gpxPath));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return nullptr;
+  }
+
+  const qint64 fileSize = file.size();
+  if (fileSize < qint64(sizeof(CacheHeader))) {
+    return nullptr;
+  }
+
+  const uchar *data = file.map(0, fileSize);
+  if (!data) {
+    return nullptr;
+  }
+
+  CacheHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.byteOrderMark != kByteOrderMark) {
+    return nullptr;
+  }
+
+  // Stale if the GPX file changed since it was cached
+  if (header.sourceSize != source.size() ||
+      header.sourceMtimeMs != source.lastModified().toMSecsSinceEpoch()) {
+    return nullptr;
+  }
+
+  const qint64 count = header.pointCount;
+  if (count < 0 || count > std::numeric_limits<int>::max() ||
+      fileSize != qint64(sizeof(CacheHeader)) + payloadSize(count)) {
+    qWarning() << "Ignoring corrupt track cache" << file.fileName();
+    return nullptr;
+  }
+
+  const uchar *cursor = data + sizeof(CacheHeader);
+  const auto *times = reinterpret_cast<const qint64 *>(cursor);
+  cursor += count * sizeof(qint64);
+  const auto *latitudes = reinterpret_cast<const double *>(cursor);
+  cursor += count * sizeof(double);
+  const auto *longitudes = reinterpret_cast<const double *>(cursor);
+  cursor += count * sizeof(double);
+  const auto *elevations = reinterpret_cast<const float *>(cursor);
+  cursor += paddedTo8(count * sizeof(float));
+  const auto *elevationValid = reinterpret_cast<const quint64 *>(cursor);
+  cursor += ((count + 63) / 64) * sizeof(quint64);
+  const auto *segmentStarts = reinterpret_cast<const quint64 *>(cursor);
+
+  auto track = std::make_shared<TrackStore>();
+  track->assign(times, latitudes, longitudes, elevations, elevationValid,
+                segmentStarts, static_cast<int>(count));
+  return track;
+}
+
+bool TrackCache::store(const QString &gpxPath, const TrackStore &track,
+                       qint64 sourceSize, qint64 sourceMtimeMs) {
+  const QString cachePath = cacheFilePath(gpxPath);
+  if (!QDir().mkpath(QFileInfo(cachePath).absolutePath())) {
+    qWarning() << "Failed to create track cache directory for" << cachePath;
+    return false;
+  }
+
+  CacheHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byteOrderMark = kByteOrderMark;
+  header.sourceSize = sourceSize;
+  header.sourceMtimeMs = sourceMtimeMs;
+  header.pointCount = track.size();
+
+  const qint64 count = track.size();
+  const qint64 elevationBytes = count * sizeof(float);
+  const QByteArray padding(paddedTo8(elevationBytes) - elevationBytes, '\0');
+
+  QSaveFile file(cachePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Failed to write track cache" << cachePath << ":"
+               << file.errorString();
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(track.timesMs().data()),
+             count * sizeof(qint64));
+  file.write(reinterpret_cast<const char *>(track.latitudes().data()),
+             count * sizeof(double));
+  file.write(reinterpret_cast<const char *>(track.longitudes().data()),
+             count * sizeof(double));
+  file.write(reinterpret_cast<const char *>(track.elevations().data()),
+             elevationBytes);
+  file.write(padding);
+  file.write(reinterpret_cast<const char *>(track.elevationValidBits().data()),
+             track.elevationValidBits().size() * sizeof(quint64));
+  file.write(reinterpret_cast<const char *>(track.segmentStartBits().data()),
+             track.segmentStartBits().size() * sizeof(quint64));
+
+  if (!file.commit()) {
+    qWarning() << "Failed to write track cache" << cachePath << ":"
+               << file.errorString();
+    return false;
+  }
+  return true;
+}
+
+Result<TrackStorePtr> TrackCache::loadOrParse(const QString &gpxPath) {
+  QElapsedTimer timer;
+  timer.start();
+
+  if (TrackStorePtr cached = load(gpxPath)) {
+    qInfo() << "Loaded" << cached->size() << "trackpoints from cache for"
+            << gpxPath << "in" << timer.elapsed() << "ms";
+    return cached;
+  }
+
+  // Stat before parsing: a live GPX may grow while it is being parsed
+  const QFileInfo before(gpxPath);
+  const qint64 size = before.size();
+  const qint64 mtimeMs = before.lastModified().toMSecsSinceEpoch();
+
+  Result<TrackStorePtr> track = GpxParser::parse(gpxPath);
+  if (track && !track.value()->isEmpty()) {
+    const QFileInfo after(gpxPath);
+    if (after.size() == size &&
+        after.lastModified().toMSecsSinceEpoch() == mtimeMs) {
+      store(gpxPath, *track.value(), size, mtimeMs);
+    } else {
+      qInfo() << "Not caching" << gpxPath << "; it changed while parsing";
+    }
+  }
+  return track;
+}
+
+} // namespace lyp
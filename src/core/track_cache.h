@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core/result.h"
+#include "models/track_store.h"
+#include <QString>
+
+namespace lyp {
+
+/**
+ * @brief On-disk binary cache of parsed GPX tracks.
+ *
+ * Each GPX file maps to one versioned cache file holding the track's raw
+ * column arrays. Entries are keyed by absolute path and validated against
+ * the source file's size and modification time, so edited GPX files are
+ * re-parsed automatically.
+ */
+class TrackCache {
+public:
+  /**
+   * @brief Load a track from the cache.
+   * @param gpxPath Path to the source GPX file
+   * @return Cached track, or nullptr on a miss or stale entry
+   */
+  static TrackStorePtr load(const QString &gpxPath);
+
+  /**
+   * @brief Store a parsed track in the cache.
+   *
+   * The key is the source as it was when parsing began, so a file that
+   * grew meanwhile misses on the next load instead of serving a track
+   * that is too short.
+   * @param gpxPath Path to the source GPX file
+   * @param track Parsed track
+   * @param sourceSize Size of the GPX file that was parsed
+   * @param sourceMtimeMs Modification time of the GPX file that was parsed
+   * @return true on success
+   */
+  static bool store(const QString &gpxPath, const TrackStore &track,
+                    qint64 sourceSize, qint64 sourceMtimeMs);
+
+  /**
+   * @brief Load from the cache, or parse the GPX file and cache the result.
+   * @param gpxPath Path to the GPX file
+   * @return Track (never null), or the GpxParser::parse() error
+   */
+  static Result<TrackStorePtr> loadOrParse(const QString &gpxPath);
+
+  /**
+   * @brief Location of the cache file for a GPX file.
+   */
+  static QString cacheFilePath(const QString &gpxPath);
+};
+
+} // namespace lyp
@@ -0,0 +1,176 @@
+#include "track_set.h"
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <numeric>
+
+namespace lyp {
+
+namespace {
+
+/**
+ * @brief Add the parts of a segment's time range that no span covers yet.
+ * @param covered Spans keyed by start time, touching at most at end points
+ */
+void coverUncovered(std::map<qint64, TrackSpan> &covered,
+                    const TrackSegment &segment, int segmentIndex) {
+  qint64 cursor = segment.startMs;
+  bool cursorCovered = false;
+
+  auto it = covered.upper_bound(cursor);
+  if (it != covered.begin() && std::prev(it)->second.endMs >= cursor) {
+    cursor = std::prev(it)->second.endMs;
+    cursorCovered = true;
+  }
+
+  std::vector<TrackSpan> pieces;
+  for (; it != covered.end() && it->first <= segment.endMs; ++it) {
+    if (it->first > cursor) {
+      pieces.push_back({cursor, it->first, segmentIndex});
+    }
+    cursor = std::max(cursor, it->second.endMs);
+    cursorCovered = true;
+  }
+  if (cursor < segment.endMs ||
+      (cursor == segment.endMs && !cursorCovered)) {
+    pieces.push_back({cursor, segment.endMs, segmentIndex});
+  }
+
+  // A colliding key can only be a single-point span; the wider piece wins
+  for (const TrackSpan &piece : pieces) {
+    covered.insert_or_assign(piece.startMs, piece);
+  }
+}
+
+} // namespace
+
+std::shared_ptr<const TrackSet>
+TrackSet::build(const QStringList &names, const QVector<TrackStorePtr> &tracks) {
+  std::shared_ptr<TrackSet> set(new TrackSet);
+  for (int i = 0; i < tracks.size(); ++i) {
+    if (tracks[i] && !tracks[i]->isEmpty()) {
+      set->addSource(i < names.size() ? names[i] : QString(), tracks[i]);
+    }
+  }
+  set->resolveOverlaps();
+  set->buildResolvedTrack();
+
+  if (set->m_sources.size() > 1) {
+    qInfo() << "Track set:" << set->m_sources.size() << "source(s),"
+            << set->m_segments.size() << "segment(s)," << set->m_spans.size()
+            << "span(s)," << set->shadowedSourceCount()
+            << "source(s) fully overlapped";
+  }
+  return set;
+}
+
+std::shared_ptr<const TrackSet> TrackSet::fromTrack(TrackStorePtr track,
+                                                    const QString &name) {
+  return build({name}, {std::move(track)});
+}
+
+void TrackSet::addSource(const QString &name, TrackStorePtr track) {
+  const int sourceIndex = static_cast<int>(m_sources.size());
+  const std::vector<qint64> &times = track->timesMs();
+  const std::vector<int> &starts = track->segmentStarts();
+  for (size_t k = 0; k < starts.size(); ++k) {
+    const int first = starts[k];
+    const int last = k + 1 < starts.size() ? starts[k + 1] - 1 : track->size() - 1;
+    m_segments.push_back({sourceIndex, first, last, times[first], times[last]});
+  }
+
+  // A track without intervals says nothing about its accuracy
+  const qint64 medianMs = track->stats().medianIntervalMs;
+  const qint64 typicalMs =
+      medianMs > 0 ? medianMs : std::numeric_limits<qint64>::max();
+  m_sources.push_back({name, std::move(track), typicalMs});
+}
+
+void TrackSet::resolveOverlaps() {
+  // Best segments claim their time ranges first
+  std::vector<int> order(m_segments.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](int a, int b) {
+    const TrackSource &sa = m_sources[m_segments[a].source];
+    const TrackSource &sb = m_sources[m_segments[b].source];
+    if (sa.typicalIntervalMs != sb.typicalIntervalMs)
+      return sa.typicalIntervalMs < sb.typicalIntervalMs;
+    if (sa.track->size() != sb.track->size())
+      return sa.track->size() > sb.track->size();
+    if (m_segments[a].source != m_segments[b].source)
+      return m_segments[a].source < m_segments[b].source;
+    return m_segments[a].startMs < m_segments[b].startMs;
+  });
+
+  std::map<qint64, TrackSpan> covered;
+  for (int segmentIndex : order) {
+    coverUncovered(covered, m_segments[segmentIndex], segmentIndex);
+  }
+
+  m_spans.reserve(covered.size());
+  m_spanStartsMs.reserve(covered.size());
+  for (const auto &[startMs, span] : covered) {
+    m_spans.push_back(span);
+    m_spanStartsMs.push_back(startMs);
+  }
+}
+
+void TrackSet::buildResolvedTrack() {
+  if (m_sources.size() <= 1) {
+    m_resolved = m_sources.empty() ? std::make_shared<const TrackStore>()
+                                   : m_sources.front().track;
+    return;
+  }
+
+  size_t totalPoints = 0;
+  for (const TrackSource &source : m_sources) {
+    totalPoints += source.track->size();
+  }
+
+  auto resolved = std::make_shared<TrackStore>();
+  resolved->reserve(static_cast<int>(totalPoints));
+  qint64 lastMs = std::numeric_limits<qint64>::min();
+  qint64 lastSpanEndMs = lastMs;
+  for (const TrackSpan &span : m_spans) {
+    const TrackSegment &segment = segmentOf(span);
+    const TrackStore &track = trackOf(segment);
+    const std::vector<qint64> &times = track.timesMs();
+    auto begin = std::lower_bound(times.begin() + segment.first,
+                                  times.begin() + segment.last + 1,
+                                  span.startMs);
+    auto end = std::upper_bound(begin, times.begin() + segment.last + 1,
+                                span.endMs);
+    // Spans that touch continue a segment; uncovered time is a gap
+    if (span.startMs > lastSpanEndMs) {
+      resolved->beginSegment();
+    }
+    lastSpanEndMs = span.endMs;
+    for (auto it = begin; it != end; ++it) {
+      const int i = static_cast<int>(it - times.begin());
+      if (times[i] < lastMs)
+        continue;
+      resolved->append(times[i], track.latitude(i), track.longitude(i),
+                       track.elevation(i));
+      lastMs = times[i];
+    }
+  }
+  resolved->finalize();
+  m_resolved = std::move(resolved);
+}
+
+int TrackSet::findSpan(qint64 timeMs) const {
+  auto it = std::upper_bound(m_spanStartsMs.begin(), m_spanStartsMs.end(),
+                             timeMs);
+  return static_cast<int>(it - m_spanStartsMs.begin()) - 1;
+}
+
+int TrackSet::shadowedSourceCount() const {
+  std::vector<bool> used(m_sources.size(), false);
+  for (const TrackSpan &span : m_spans) {
+    used[segmentOf(span).source] = true;
+  }
+  return static_cast<int>(std::count(used.begin(), used.end(), false));
+}
+
+} // namespace lyp
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "models/track_store.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+namespace lyp {
+
+/**
+ * @brief One loaded track, typically one GPX file.
+ */
+struct TrackSource {
+  QString name;               // File path, for logging
+  TrackStorePtr track;        // Sorted by time, never empty
+  qint64 typicalIntervalMs;   // Median point spacing; smaller ranks higher
+};
+
+/**
+ * @brief Contiguous run of one source's points without long gaps.
+ */
+struct TrackSegment {
+  int source;     // Index into TrackSet::sources()
+  int first;      // Point index range [first, last] in the source track
+  int last;
+  qint64 startMs; // Times of the first and last point
+  qint64 endMs;
+};
+
+/**
+ * @brief Time range served by a single segment after overlaps are resolved.
+ */
+struct TrackSpan {
+  qint64 startMs;
+  qint64 endMs;
+  int segment;    // Index into TrackSet::segments()
+};
+
+/**
+ * @brief Several tracks combined into one timeline.
+ *
+ * Each source contributes its segments (see TrackStore). Where segments overlap
+ * in time, the one from the more accurate source (closer sampling, then
+ * more points, then load order) owns the overlap, so duplicate files and
+ * coarser devices are shadowed rather than interleaved. The result is a
+ * sorted list of spans that touch only at their end points; a lookup is a
+ * binary search over span start times, O(log S) in the number of spans.
+ */
+class TrackSet {
+public:
+  /**
+   * @brief Build a set from parsed tracks.
+   * @param names Source names (e.g. file paths), parallel to `tracks`
+   * @param tracks Tracks sorted by time; null and empty tracks are ignored
+   */
+  static std::shared_ptr<const TrackSet>
+  build(const QStringList &names, const QVector<TrackStorePtr> &tracks);
+
+  /**
+   * @brief Wrap a single track.
+   */
+  static std::shared_ptr<const TrackSet> fromTrack(TrackStorePtr track,
+                                                   const QString &name = {});
+
+  bool isEmpty() const { return m_spans.empty(); }
+
+  const std::vector<TrackSource> &sources() const { return m_sources; }
+  const std::vector<TrackSegment> &segments() const { return m_segments; }
+  const std::vector<TrackSpan> &spans() const { return m_spans; }
+
+  const TrackSegment &segmentOf(const TrackSpan &span) const {
+    return m_segments[span.segment];
+  }
+  const TrackStore &trackOf(const TrackSegment &segment) const {
+    return *m_sources[segment.source].track;
+  }
+
+  /**
+   * @brief Index of the last span starting at or before a time.
+   * @param timeMs UTC time in milliseconds since epoch
+   * @return Span index, or -1 if the time is before the first span
+   */
+  int findSpan(qint64 timeMs) const;
+
+  /**
+   * @brief Time of the first and last point in the set.
+   */
+  qint64 startMs() const { return m_spans.front().startMs; }
+  qint64 endMs() const { return m_spans.back().endMs; }
+
+  /**
+   * @brief Points of all spans, in time order, as one track.
+   *
+   * Shadowed points are left out. For a single source this is the source
+   * track itself. Used for display, statistics and offset search.
+   */
+  TrackStorePtr resolvedTrack() const { return m_resolved; }
+
+  /**
+   * @brief Sources that own no span, i.e. fully covered by better ones.
+   */
+  int shadowedSourceCount() const;
+
+private:
+  TrackSet() = default;
+
+  void addSource(const QString &name, TrackStorePtr track);
+  void resolveOverlaps();
+  void buildResolvedTrack();
+
+  std::vector<TrackSource> m_sources;
+  std::vector<TrackSegment> m_segments;
+  std::vector<TrackSpan> m_spans;
+  std::vector<qint64> m_spanStartsMs; // Parallel to m_spans, for lookups
+  TrackStorePtr m_resolved;
+};
+
+/**
+ * @brief Shared, immutable handle to a track set.
+ */
+using TrackSetPtr = std::shared_ptr<const TrackSet>;
+
+} // namespace lyp
@@ -0,0 +1,128 @@
+#include "track_simplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace lyp {
+
+namespace {
+
+/**
+ * @brief Squared distance from point p to segment (a, b) in degree space.
+ */
+double segmentDistanceSq(double px, double py, double ax, double ay,
+                         double bx, double by) {
+  const double dx = bx - ax;
+  const double dy = by - ay;
+  const double lengthSq = dx * dx + dy * dy;
+  double t = 0.0;
+  if (lengthSq > 0.0) {
+    t = std::clamp(((px - ax) * dx + (py - ay) * dy) / lengthSq, 0.0, 1.0);
+  }
+  const double ex = px - (ax + t * dx);
+  const double ey = py - (ay + t * dy);
+  return ex * ex + ey * ey;
+}
+
+} // namespace
+
+std::vector<int> TrackSimplifier::simplify(const TrackStore &track,
+                                           double toleranceDegrees) {
+  const int count = track.size();
+  if (count <= 2) {
+    std::vector<int> all(count);
+    for (int i = 0; i < count; ++i) {
+      all[i] = i;
+    }
+    return all;
+  }
+
+  const std::vector<double> &lats = track.latitudes();
+  const std::vector<double> &lons = track.longitudes();
+  const double toleranceSq = toleranceDegrees * toleranceDegrees;
+
+  std::vector<char> keep(count, 0);
+  keep[0] = 1;
+  keep[count - 1] = 1;
+
+  // Iterative Douglas-Peucker; an explicit stack avoids deep recursion on
+  // long, nearly straight tracks
+  std::vector<std::pair<int, int>> stack;
+  stack.emplace_back(0, count - 1);
+  while (!stack.empty()) {
+    const auto [first, last] = stack.back();
+    stack.pop_back();
+
+    double maxDistSq = -1.0;
+    int farthest = -1;
+    for (int i = first + 1; i < last; ++i) {
+      const double distSq = segmentDistanceSq(lons[i], lats[i], lons[first],
+                                              lats[first], lons[last],
+                                              lats[last]);
+      if (distSq > maxDistSq) {
+        maxDistSq = distSq;
+        farthest = i;
+      }
+    }
+
+    if (farthest >= 0 && maxDistSq > toleranceSq) {
+      keep[farthest] = 1;
+      stack.emplace_back(first, farthest);
+      stack.emplace_back(farthest, last);
+    }
+  }
+
+  std::vector<int> indices;
+  for (int i = 0; i < count; ++i) {
+    if (keep[i]) {
+      indices.push_back(i);
+    }
+  }
+  return indices;
+}
+
+std::vector<int> TrackSimplifier::simplifyForZoom(const TrackStore &track,
+                                                  int zoomLevel,
+                                                  int maxVertices) {
+  double tolerance = toleranceForZoom(zoomLevel);
+  std::vector<int> indices = simplify(track, tolerance);
+
+  // Coarsen until the vertex budget is met
+  while (static_cast<int>(indices.size()) > maxVertices) {
+    tolerance *= 2.0;
+    indices = simplify(track, tolerance);
+  }
+  return indices;
+}
+
+std::vector<int> TrackSimplifier::decimate(const TrackStore &track,
+                                           int maxVertices) {
+  const int count = track.size();
+  const int kept = std::min(count, std::max(2, maxVertices));
+  std::vector<int> indices;
+  if (count == 0) {
+    return indices;
+  }
+  if (kept >= count) {
+    indices.resize(count);
+    for (int i = 0; i < count; ++i) {
+      indices[i] = i;
+    }
+    return indices;
+  }
+
+  indices.reserve(kept);
+  const double stride = static_cast<double>(count - 1) / (kept - 1);
+  for (int i = 0; i < kept; ++i) {
+    indices.push_back(static_cast<int>(std::lround(i * stride)));
+  }
+  return indices;
+}
+
+double TrackSimplifier::toleranceForZoom(int zoomLevel) {
+  zoomLevel = std::clamp(zoomLevel, 0, 22);
+  // 360 degrees span 256 * 2^zoom pixels; half a pixel of error is invisible
+  return 0.5 * 360.0 / (256.0 * std::ldexp(1.0, zoomLevel));
+}
+
+} // namespace lyp
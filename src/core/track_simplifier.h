@@ -0,0 +1,62 @@
+#pragma once
+
+#include "models/track_store.h"
+#include <vector>
+
+namespace lyp {
+
+/**
+ * @brief Douglas-Peucker simplification of tracks for display.
+ *
+ * Works on raw degrees (good enough for on-screen tolerances) and returns
+ * indices into the input track, so callers decide how to materialize the
+ * simplified polyline.
+ */
+class TrackSimplifier {
+public:
+  /**
+   * @brief Default cap on vertices per simplified track.
+   */
+  static constexpr int kDefaultMaxVertices = 5000;
+
+  /**
+   * @brief Simplify a track with a fixed tolerance.
+   * @param track Track to simplify
+   * @param toleranceDegrees Maximum perpendicular error, in degrees
+   * @return Indices of the kept points, ascending; first and last always kept
+   */
+  static std::vector<int> simplify(const TrackStore &track,
+                                   double toleranceDegrees);
+
+  /**
+   * @brief Simplify a track for display at a map zoom level.
+   *
+   * The tolerance is about half a screen pixel at that zoom; it is raised
+   * further if needed to stay within maxVertices.
+   * @param track Track to simplify
+   * @param zoomLevel Web map zoom level (0 = whole world in 256 px)
+   * @param maxVertices Upper bound on returned indices
+   * @return Indices of the kept points, ascending
+   */
+  static std::vector<int>
+  simplifyForZoom(const TrackStore &track, int zoomLevel,
+                  int maxVertices = kDefaultMaxVertices);
+
+  /**
+   * @brief Pick evenly spaced points for a quick preview.
+   *
+   * O(maxVertices) regardless of track length, so it is cheap enough to run
+   * on the GUI thread while the real simplification happens elsewhere.
+   * @param track Track to sample
+   * @param maxVertices Upper bound on returned indices
+   * @return Indices of the kept points, ascending; first and last always kept
+   */
+  static std::vector<int> decimate(const TrackStore &track, int maxVertices);
+
+  /**
+   * @brief Tolerance in degrees corresponding to half a pixel at a zoom.
+   */
+  static double toleranceForZoom(int zoomLevel);
+};
+
+} // namespace lyp
@@ -0,0 +1,118 @@
+#include "watch_daemon.h"
+#include "folder_watcher.h"
+#include "models/photo_list_model.h"
+#include <QDebug>
+
+namespace lyp {
+
+WatchDaemon::WatchDaemon(PhotoProcessor *processor,
+                         const ProcessingSettings &settings, QObject *parent)
+    : QObject(parent), m_processor(processor), m_settings(settings),
+      m_watcher(new FolderWatcher(this)) {
+  // Idle stage threads, and with them the exiftool sessions, never expire
+  m_processor->setStageThreadExpiry(-1);
+  // Arrivals are reported once, so batches can share one journal until a
+  // track reload changes its fingerprint
+  m_processor->setKeepJournalOpen(true);
+
+  connect(m_watcher, &FolderWatcher::filesArrived, this,
+          &WatchDaemon::enqueue);
+  connect(m_watcher, &FolderWatcher::filesChanged, this, [this]() {
+    // A running batch keeps the track it started with
+    m_reloadRequested = true;
+    if (!m_batch) {
+      reloadTrack();
+    }
+  });
+  connect(m_processor, &PhotoProcessor::photosScanComplete, this,
+          &WatchDaemon::onScanComplete);
+  connect(m_processor, &PhotoProcessor::processingComplete, this,
+          &WatchDaemon::onProcessingComplete);
+}
+
+WatchDaemon::~WatchDaemon() {
+  if (m_batch) {
+    m_processor->cancelScan();
+    m_processor->stopProcessing();
+  }
+}
+
+bool WatchDaemon::start(const QStringList &directories,
+                        const QStringList &gpxFiles, bool includeExisting) {
+  m_gpxFiles = gpxFiles;
+  m_watcher->watchFiles(gpxFiles);
+  return m_watcher->watchDirectories(directories, includeExisting);
+}
+
+void WatchDaemon::enqueue(const QStringList &filePaths) {
+  m_queue.append(filePaths);
+  if (!m_batch) {
+    startBatch();
+  }
+}
+
+void WatchDaemon::startBatch() {
+  if (m_batch || m_queue.isEmpty())
+    return;
+
+  // Everything that arrived while the last batch ran goes in one batch
+  const QStringList paths = m_queue;
+  m_queue.clear();
+  m_batch = std::make_unique<PhotoListModel>();
+  m_processor->scanPhotos(paths, m_batch.get());
+}
+
+void WatchDaemon::onScanComplete() {
+  if (!m_batch || m_processor->isProcessing())
+    return;
+  m_processor->processPhotos(m_batch.get(), m_settings);
+}
+
+void WatchDaemon::onProcessingComplete() {
+  if (!m_batch)
+    return;
+
+  const std::unique_ptr<PhotoListModel> batch = std::move(m_batch);
+  for (const PhotoItem &photo : batch->photos()) {
+    // Left pending when the run had no track or was stopped
+    const bool waiting =
+        !m_gpxFiles.isEmpty() &&
+        (photo.state == PhotoState::Pending || isAfterTrack(photo));
+    if (waiting) {
+      m_waiting.append(photo.filePath);
+    }
+    emit photoFinished(photo, waiting);
+  }
+
+  if (m_reloadRequested) {
+    reloadTrack();
+  } else {
+    startBatch();
+  }
+}
+
+void WatchDaemon::reloadTrack() {
+  m_reloadRequested = false;
+  if (m_processor->reloadGpxFiles(m_gpxFiles)) {
+    emit trackReloaded(m_processor->track()->size());
+
+    // Held-back photos get another chance ahead of newer arrivals
+    if (!m_waiting.isEmpty()) {
+      qInfo() << "Retrying" << m_waiting.size()
+              << "photo(s) against the reloaded track";
+      m_queue = m_waiting + m_queue;
+      m_waiting.clear();
+    }
+  }
+  startBatch();
+}
+
+bool WatchDaemon::isAfterTrack(const PhotoItem &photo) const {
+  const TrackSetPtr tracks = m_processor->trackSet();
+  if (photo.state != PhotoState::Skipped || !photo.captureTime.isValid() ||
+      !tracks || tracks->isEmpty())
+    return false;
+  return photo.captureTime.toMSecsSinceEpoch() > tracks->endMs();
+}
+
+} // namespace lyp
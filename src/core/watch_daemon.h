@@ -0,0 +1,90 @@
+#pragma once
+
+#include "core/photo_processor.h"
+#include "models/photo_item.h"
+#include <QObject>
+#include <QStringList>
+#include <memory>
+
+namespace lyp {
+
+class FolderWatcher;
+class PhotoListModel;
+
+/**
+ * @brief Geotags photos as they arrive in watched folders.
+ *
+ * Photos reported by a FolderWatcher are scanned and processed in small
+ * batches through one PhotoProcessor, so the loaded track and its index,
+ * the stage threads and their exiftool sessions are kept from one photo to
+ * the next instead of being set up again. Photos taken after the end of the
+ * track are held back; when a GPX file changes, e.g. because the logger is
+ * still recording, the track is reloaded and they are tried again.
+ */
+class WatchDaemon : public QObject {
+  Q_OBJECT
+
+public:
+  /**
+   * @param processor Processor with the GPX files loaded; must outlive the
+   *        daemon and not be used for anything else while it runs
+   * @param settings Settings for every batch
+   */
+  WatchDaemon(PhotoProcessor *processor, const ProcessingSettings &settings,
+              QObject *parent = nullptr);
+  ~WatchDaemon() override;
+
+  /**
+   * @brief Start geotagging the photos that arrive in directories.
+   * @param directories Directories to watch, with their subdirectories
+   * @param gpxFiles The loaded GPX files; the track is reloaded when one
+   *        changes (empty = never reload)
+   * @param includeExisting Also process photos already there
+   * @return false if a directory could not be watched
+   */
+  bool start(const QStringList &directories, const QStringList &gpxFiles,
+             bool includeExisting);
+
+  /**
+   * @brief The folder watcher, e.g. to change its settle time.
+   */
+  FolderWatcher *watcher() const { return m_watcher; }
+
+  /**
+   * @brief Number of photos held back until the track covers them.
+   */
+  int waitingCount() const { return m_waiting.size(); }
+
+signals:
+  /**
+   * @brief Emitted for each photo of a finished batch.
+   * @param photo The photo in its final state
+   * @param waiting Whether it is held back for a longer track
+   */
+  void photoFinished(const PhotoItem &photo, bool waiting);
+
+  /**
+   * @brief Emitted after the track was reloaded.
+   * @param trackpointCount Trackpoints now loaded
+   */
+  void trackReloaded(int trackpointCount);
+
+private:
+  void enqueue(const QStringList &filePaths);
+  void startBatch();
+  void onScanComplete();
+  void onProcessingComplete();
+  void reloadTrack();
+  bool isAfterTrack(const PhotoItem &photo) const;
+
+  PhotoProcessor *m_processor;
+  const ProcessingSettings m_settings;
+  FolderWatcher *m_watcher;
+  QStringList m_gpxFiles;
+  QStringList m_queue;   // Arrived photos not yet in a batch
+  QStringList m_waiting; // Photos after the end of the track
+  std::unique_ptr<PhotoListModel> m_batch; // Being scanned or processed
+  bool m_reloadRequested = false;
+};
+
+} // namespace lyp
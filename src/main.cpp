@@ -1,3 +1,4 @@
+#include "core/perf_trace.h"
 #include "ui/main_window.h"
 #include <QApplication>
 #include <QDebug>
@@ -10,6 +11,9 @@ int main(int argc, char* argv[])
     app.setApplicationVersion("1.0.0");
     app.setOrganizationName("LocateYourPhoto");
     
+    // LYP_PERF=1 logs per-stage timings after each run
+    lyp::PerfTrace::enableFromEnvironment();
+    
     lyp::MainWindow mainWindow;
     mainWindow.show();
     
@@ -24,9 +24,11 @@ struct PhotoItem {
     QString filePath;
     QString fileName;
     QDateTime captureTime;
+    std::optional<qint64> rawCaptureMs; // EXIF time read as UTC, no offset (set at scan)
     bool hasExistingGps = false;
     PhotoState state = PhotoState::Pending;
     QString errorMessage;
+    bool gpsWritten = false;            // A run (not a dry run) wrote the matched position
     
     // Matched GPS coordinates (set after processing)
     std::optional<double> matchedLat;
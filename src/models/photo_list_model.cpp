@@ -1,8 +1,22 @@
 #include "photo_list_model.h"
+#include "core/perf_trace.h"
+#include <algorithm>
 
 namespace lyp {
 
-PhotoListModel::PhotoListModel(QObject *parent) : QAbstractListModel(parent) {}
+namespace {
+
+// Coalescing interval for in-place updates (~30 Hz)
+constexpr int kFlushIntervalMs = 33;
+
+} // namespace
+
+PhotoListModel::PhotoListModel(QObject *parent) : QAbstractListModel(parent) {
+  m_flushTimer.setSingleShot(true);
+  m_flushTimer.setInterval(kFlushIntervalMs);
+  connect(&m_flushTimer, &QTimer::timeout, this,
+          &PhotoListModel::flushUpdates);
+}
 
 int PhotoListModel::rowCount(const QModelIndex &parent) const {
   if (parent.isValid())
@@ -61,6 +75,7 @@ QHash<int, QByteArray> PhotoListModel::roleNames() const {
 void PhotoListModel::addPhoto(const PhotoItem &photo) {
   beginInsertRows(QModelIndex(), m_photos.size(), m_photos.size());
   m_photos.append(photo);
+  m_pathIndex.insert(photo.filePath);
   endInsertRows();
   emit photoAdded(m_photos.size() - 1);
 }
@@ -72,6 +87,9 @@ void PhotoListModel::addPhotos(const QVector<PhotoItem> &photos) {
   beginInsertRows(QModelIndex(), m_photos.size(),
                   m_photos.size() + photos.size() - 1);
   m_photos.append(photos);
+  for (const PhotoItem &photo : photos) {
+    m_pathIndex.insert(photo.filePath);
+  }
   endInsertRows();
 
   for (int i = m_photos.size() - photos.size(); i < m_photos.size(); ++i) {
@@ -83,7 +101,11 @@ void PhotoListModel::removePhoto(int index) {
   if (index < 0 || index >= m_photos.size())
     return;
 
+  // Pending row numbers refer to the layout before the removal
+  flushUpdates();
+
   beginRemoveRows(QModelIndex(), index, index);
+  m_pathIndex.remove(m_photos[index].filePath);
   m_photos.removeAt(index);
   endRemoveRows();
 }
@@ -91,6 +113,9 @@ void PhotoListModel::removePhoto(int index) {
 void PhotoListModel::clear() {
   beginResetModel();
   m_photos.clear();
+  m_pathIndex.clear();
+  m_dirtyRows.clear();
+  m_flushTimer.stop();
   endResetModel();
 }
 
@@ -112,16 +137,51 @@ void PhotoListModel::resetAllStates() {
     m_photos[i].matchedLon.reset();
     m_photos[i].matchedElevation.reset();
   }
+  m_dirtyRows.clear();
+  m_flushTimer.stop();
+  if (m_photos.isEmpty())
+    return;
   emit dataChanged(createIndex(0, 0), createIndex(m_photos.size() - 1, 0));
 }
 
-bool PhotoListModel::containsFile(const QString &filePath) const {
-  for (const PhotoItem &photo : m_photos) {
-    if (photo.filePath == filePath) {
-      return true;
+void PhotoListModel::markDirty(int index) {
+  if (index < 0 || index >= m_photos.size())
+    return;
+
+  m_dirtyRows.append(index);
+  if (!m_flushTimer.isActive()) {
+    m_flushTimer.start();
+  }
+}
+
+void PhotoListModel::flushUpdates() {
+  m_flushTimer.stop();
+  if (m_dirtyRows.isEmpty())
+    return;
+
+  ScopedTimer timer(PerfStage::ModelUpdate);
+  QVector<int> rows;
+  rows.swap(m_dirtyRows);
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  // One signal per contiguous run of rows
+  int first = rows.first();
+  int last = first;
+  for (int i = 1; i <= rows.size(); ++i) {
+    if (i < rows.size() && rows[i] == last + 1) {
+      last = rows[i];
+      continue;
+    }
+    emit dataChanged(createIndex(first, 0), createIndex(last, 0));
+    if (i < rows.size()) {
+      first = last = rows[i];
     }
   }
-  return false;
+}
+
+bool PhotoListModel::containsFile(const QString &filePath) const {
+  return m_pathIndex.contains(filePath);
 }
 
 } // namespace lyp
@@ -2,12 +2,18 @@
 
 #include "models/photo_item.h"
 #include <QAbstractListModel>
+#include <QSet>
+#include <QTimer>
 #include <QVector>
 
 namespace lyp {
 
 /**
  * @brief Qt model for the photo list view.
+ *
+ * Bulk writers mutate rows in place through photoAt() and call markDirty();
+ * dirty rows are announced as contiguous dataChanged ranges at most once per
+ * frame instead of one signal per change.
  */
 class PhotoListModel : public QAbstractListModel {
   Q_OBJECT
@@ -41,6 +47,17 @@ public:
   // Update photo state after processing
   void updatePhoto(int index, const PhotoItem &photo);
 
+  /**
+   * @brief Schedule a change notification for a row edited in place.
+   * @param index Row modified through photoAt()
+   */
+  void markDirty(int index);
+
+  /**
+   * @brief Emit pending dataChanged ranges now.
+   */
+  void flushUpdates();
+
   // Reset all photos to pending state (for reprocessing)
   void resetAllStates();
 
@@ -50,7 +67,7 @@ public:
   int count() const { return m_photos.size(); }
 
   /**
-   * @brief Check if a file path is already in the model.
+   * @brief Check if a file path is already in the model. O(1).
    */
   bool containsFile(const QString &filePath) const;
 
@@ -60,6 +77,9 @@ signals:
 
 private:
   QVector<PhotoItem> m_photos;
+  QSet<QString> m_pathIndex; // File paths of m_photos, for duplicate checks
+  QVector<int> m_dirtyRows;  // Rows awaiting dataChanged, unsorted
+  QTimer m_flushTimer;
 };
 
 } // namespace lyp
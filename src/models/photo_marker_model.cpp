@@ -0,0 +1,198 @@
+#include "photo_marker_model.h"
+#include "photo_list_model.h"
+#include <QHash>
+#include <cmath>
+
+namespace lyp {
+
+namespace {
+
+// Screen-space size of a cluster cell
+constexpr double kClusterCellPixels = 48.0;
+
+// Coalesce bursts of updates into one regrouping
+constexpr int kReclusterDelayMs = 100;
+
+} // namespace
+
+PhotoMarkerModel::PhotoMarkerModel(QObject *parent)
+    : QIdentityProxyModel(parent) {
+  m_reclusterTimer.setSingleShot(true);
+  m_reclusterTimer.setInterval(kReclusterDelayMs);
+  connect(&m_reclusterTimer, &QTimer::timeout, this,
+          &PhotoMarkerModel::recluster);
+}
+
+void PhotoMarkerModel::setPhotoModel(PhotoListModel *model) {
+  if (m_photoModel) {
+    disconnect(m_photoModel, nullptr, this, nullptr);
+  }
+
+  m_photoModel = model;
+  setSourceModel(model);
+
+  if (model) {
+    // Coordinates or membership changed; cluster heads may move
+    connect(model, &QAbstractItemModel::dataChanged, this,
+            &PhotoMarkerModel::scheduleRecluster);
+    connect(model, &QAbstractItemModel::rowsInserted, this,
+            &PhotoMarkerModel::onRowsInserted);
+    connect(model, &QAbstractItemModel::rowsRemoved, this,
+            &PhotoMarkerModel::onRowsMoved);
+    connect(model, &QAbstractItemModel::modelReset, this,
+            &PhotoMarkerModel::onRowsMoved);
+  }
+  onRowsMoved();
+}
+
+QVariant PhotoMarkerModel::data(const QModelIndex &index, int role) const {
+  if (role < MarkerLatitudeRole || !m_photoModel || !index.isValid()) {
+    return QIdentityProxyModel::data(index, role);
+  }
+
+  const int row = index.row();
+  if (row >= m_photoModel->count()) {
+    return QVariant();
+  }
+  const PhotoItem &photo = m_photoModel->photos()[row];
+
+  // Rows added since the last regrouping show as standalone markers
+  const bool clustered =
+      isClustering() && row < static_cast<int>(m_clusterSize.size());
+
+  switch (role) {
+  case MarkerLatitudeRole:
+    return clustered && m_clusterSize[row] > 1 ? m_clusterLat[row]
+                                               : photo.matchedLat.value_or(0.0);
+  case MarkerLongitudeRole:
+    return clustered && m_clusterSize[row] > 1 ? m_clusterLon[row]
+                                               : photo.matchedLon.value_or(0.0);
+  case MarkerVisibleRole:
+    return photo.hasMatchedCoordinates() &&
+           (!clustered || m_clusterSize[row] > 0);
+  case ClusterSizeRole:
+    return clustered ? m_clusterSize[row] : 1;
+  default:
+    return QVariant();
+  }
+}
+
+QHash<int, QByteArray> PhotoMarkerModel::roleNames() const {
+  QHash<int, QByteArray> names = QIdentityProxyModel::roleNames();
+  names.insert(MarkerLatitudeRole, "markerLatitude");
+  names.insert(MarkerLongitudeRole, "markerLongitude");
+  names.insert(MarkerVisibleRole, "markerVisible");
+  names.insert(ClusterSizeRole, "clusterSize");
+  return names;
+}
+
+void PhotoMarkerModel::setZoomLevel(int zoomLevel) {
+  if (zoomLevel == m_zoomLevel)
+    return;
+
+  const bool wasClustering = isClustering();
+  m_zoomLevel = zoomLevel;
+  if (wasClustering || isClustering()) {
+    recluster();
+  }
+}
+
+void PhotoMarkerModel::scheduleRecluster() {
+  if (isClustering() && !m_reclusterTimer.isActive()) {
+    m_reclusterTimer.start();
+  }
+}
+
+void PhotoMarkerModel::onRowsInserted(const QModelIndex &, int first) {
+  // Appended rows leave the earlier ones where they were
+  if (first < static_cast<int>(m_clusterSize.size())) {
+    m_rowsMoved = true;
+  }
+  scheduleRecluster();
+}
+
+void PhotoMarkerModel::onRowsMoved() {
+  m_rowsMoved = true;
+  scheduleRecluster();
+}
+
+void PhotoMarkerModel::recluster() {
+  m_reclusterTimer.stop();
+
+  // Kept to notify only rows whose marker changed
+  const std::vector<int> oldSize = std::move(m_clusterSize);
+  const std::vector<double> oldLat = std::move(m_clusterLat);
+  const std::vector<double> oldLon = std::move(m_clusterLon);
+
+  const int count = m_photoModel ? m_photoModel->count() : 0;
+  m_clusterSize.assign(count, 1);
+  m_clusterLat.assign(count, 0.0);
+  m_clusterLon.assign(count, 0.0);
+
+  if (isClustering()) {
+    const double cellDegrees =
+        kClusterCellPixels * 360.0 / (256.0 * std::ldexp(1.0, m_zoomLevel));
+
+    // Grid cell -> row of the photo representing it
+    QHash<quint64, int> heads;
+    heads.reserve(count);
+    const QVector<PhotoItem> &photos = m_photoModel->photos();
+    for (int row = 0; row < count; ++row) {
+      const PhotoItem &photo = photos[row];
+      if (!photo.hasMatchedCoordinates()) {
+        continue;
+      }
+
+      const auto cellX = static_cast<qint32>(
+          std::floor(photo.matchedLon.value() / cellDegrees));
+      const auto cellY = static_cast<qint32>(
+          std::floor(photo.matchedLat.value() / cellDegrees));
+      const quint64 key = (quint64(quint32(cellX)) << 32) | quint32(cellY);
+
+      auto it = heads.constFind(key);
+      if (it == heads.constEnd()) {
+        heads.insert(key, row);
+        m_clusterLat[row] = photo.matchedLat.value();
+        m_clusterLon[row] = photo.matchedLon.value();
+        continue;
+      }
+
+      // Fold into the head as a running centroid
+      const int head = it.value();
+      const int size = ++m_clusterSize[head];
+      m_clusterLat[head] += (photo.matchedLat.value() - m_clusterLat[head]) / size;
+      m_clusterLon[head] += (photo.matchedLon.value() - m_clusterLon[head]) / size;
+      m_clusterSize[row] = 0;
+    }
+  }
+
+  // Changes to a photo's own position arrive through the source model; only
+  // cluster membership and centroids are compared here. Rows beyond the old
+  // arrays were shown as standalone markers
+  const QList<int> roles = {MarkerLatitudeRole, MarkerLongitudeRole,
+                            MarkerVisibleRole, ClusterSizeRole};
+  const int oldCount = static_cast<int>(oldSize.size());
+  const auto changed = [&](int row) {
+    if (m_rowsMoved)
+      return true;
+    const int before = row < oldCount ? oldSize[row] : 1;
+    const int after = m_clusterSize[row];
+    return before != after ||
+           (after > 1 && (oldLat[row] != m_clusterLat[row] ||
+                          oldLon[row] != m_clusterLon[row]));
+  };
+  for (int row = 0; row < count;) {
+    if (!changed(row)) {
+      ++row;
+      continue;
+    }
+    const int first = row;
+    while (row < count && changed(row)) {
+      ++row;
+    }
+    emit dataChanged(index(first, 0), index(row - 1, 0), roles);
+  }
+  m_rowsMoved = false;
+}
+
+} // namespace lyp
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QIdentityProxyModel>
+#include <QTimer>
+#include <vector>
+
+namespace lyp {
+
+class PhotoListModel;
+
+/**
+ * @brief Map marker view of a PhotoListModel.
+ *
+ * Rows map one-to-one to photo indices and share the source model's
+ * storage, so updates arrive as (range) dataChanged signals instead of
+ * per-marker searches in QML. At low zoom levels nearby markers are
+ * grouped on a screen-space grid: the first photo of each cell represents
+ * the cluster and the others are hidden.
+ */
+class PhotoMarkerModel : public QIdentityProxyModel {
+  Q_OBJECT
+
+public:
+  enum Roles {
+    MarkerLatitudeRole = Qt::UserRole + 100,
+    MarkerLongitudeRole,
+    MarkerVisibleRole,
+    ClusterSizeRole
+  };
+
+  /**
+   * @brief Zoom levels below this cluster markers.
+   */
+  static constexpr int kClusterMaxZoom = 14;
+
+  explicit PhotoMarkerModel(QObject *parent = nullptr);
+
+  void setPhotoModel(PhotoListModel *model);
+  PhotoListModel *photoModel() const { return m_photoModel; }
+
+  QVariant data(const QModelIndex &index,
+                int role = Qt::DisplayRole) const override;
+  QHash<int, QByteArray> roleNames() const override;
+
+  /**
+   * @brief Set the current integer map zoom (called from QML).
+   */
+  Q_INVOKABLE void setZoomLevel(int zoomLevel);
+
+private:
+  void scheduleRecluster();
+  void onRowsInserted(const QModelIndex &parent, int first);
+  void onRowsMoved();
+  void recluster();
+  bool isClustering() const { return m_zoomLevel < kClusterMaxZoom; }
+
+  PhotoListModel *m_photoModel = nullptr;
+  int m_zoomLevel = kClusterMaxZoom;
+
+  // Per row: 0 = hidden inside a cluster, n >= 1 = marker for n photos
+  std::vector<int> m_clusterSize;
+  std::vector<double> m_clusterLat;
+  std::vector<double> m_clusterLon;
+  // Rows moved since the last regrouping, so its arrays no longer line up
+  bool m_rowsMoved = false;
+  QTimer m_reclusterTimer;
+};
+
+} // namespace lyp
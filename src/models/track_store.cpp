@@ -0,0 +1,230 @@
+#include "track_store.h"
+#include <QDateTime>
+#include <QTimeZone>
+#include <algorithm>
+#include <numeric>
+
+namespace lyp {
+
+namespace {
+
+// A pause longer than this, and kPauseFactor median intervals, ends a segment
+constexpr qint64 kMinPauseMs = 60 * 1000;
+constexpr qint64 kPauseFactor = 10;
+
+qint64 median(std::vector<qint64>& values)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+} // namespace
+
+void TrackStore::reserve(int count)
+{
+    m_timesMs.reserve(count);
+    m_latitudes.reserve(count);
+    m_longitudes.reserve(count);
+    m_elevations.reserve(count);
+    m_elevationValid.reserve((count + 63) / 64);
+    m_segmentStartBits.reserve((count + 63) / 64);
+}
+
+void TrackStore::append(qint64 timeMs, double latitude, double longitude,
+                        std::optional<double> elevation)
+{
+    const int index = size();
+    m_timesMs.push_back(timeMs);
+    m_latitudes.push_back(latitude);
+    m_longitudes.push_back(longitude);
+    m_elevations.push_back(static_cast<float>(elevation.value_or(0.0)));
+    
+    if ((index & 63) == 0) {
+        m_elevationValid.push_back(0);
+        m_segmentStartBits.push_back(0);
+    }
+    if (elevation.has_value()) {
+        m_elevationValid[index >> 6] |= quint64(1) << (index & 63);
+    }
+    if (index == 0) {
+        // Until finalize(), the whole track is one segment
+        m_segmentStartBits[0] = 1;
+        m_segmentStarts.assign(1, 0);
+    }
+}
+
+void TrackStore::beginSegment()
+{
+    m_recordedStarts.push_back(size());
+}
+
+void TrackStore::sortByTime()
+{
+    if (std::is_sorted(m_timesMs.begin(), m_timesMs.end())) {
+        return;
+    }
+    
+    std::vector<int> order(m_timesMs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_timesMs[a] < m_timesMs[b];
+    });
+    
+    TrackStore sorted;
+    sorted.reserve(size());
+    for (int index : order) {
+        sorted.append(m_timesMs[index], m_latitudes[index],
+                      m_longitudes[index], elevation(index));
+    }
+    *this = std::move(sorted);
+}
+
+void TrackStore::finalize()
+{
+    const int count = size();
+    std::vector<int> starts;
+    starts.swap(m_recordedStarts);
+    if (count == 0) {
+        return;
+    }
+    if (starts.empty() || starts.front() != 0) {
+        starts.insert(starts.begin(), 0);
+    }
+    
+    // Time range of each recorded segment, taken before sorting
+    std::vector<std::pair<qint64, qint64>> ranges;
+    for (size_t k = 0; k < starts.size(); ++k) {
+        const int from = starts[k];
+        const int to = k + 1 < starts.size() ? starts[k + 1] : count;
+        if (from >= to) {
+            continue; // Empty <trkseg>
+        }
+        auto [lowest, highest] = std::minmax_element(m_timesMs.begin() + from,
+                                                     m_timesMs.begin() + to);
+        ranges.emplace_back(*lowest, *highest);
+    }
+    
+    sortByTime();
+    
+    // Join recorded segments that overlap in time
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<std::pair<qint64, qint64>> joined;
+    for (const auto& range : ranges) {
+        if (!joined.empty() && range.first <= joined.back().second) {
+            joined.back().second = std::max(joined.back().second, range.second);
+        } else {
+            joined.push_back(range);
+        }
+    }
+    
+    // Every point lies in one joined range; a new range starts a segment
+    std::fill(m_segmentStartBits.begin(), m_segmentStartBits.end(), 0);
+    m_segmentStartBits[0] = 1;
+    size_t range = 0;
+    for (int i = 1; i < count; ++i) {
+        const size_t previous = range;
+        while (m_timesMs[i] > joined[range].second) {
+            ++range;
+        }
+        if (range != previous) {
+            m_segmentStartBits[i >> 6] |= quint64(1) << (i & 63);
+        }
+    }
+    
+    splitAtPauses();
+    computeStats();
+}
+
+void TrackStore::splitAtPauses()
+{
+    const int count = size();
+    std::vector<qint64> intervals;
+    intervals.reserve(count);
+    for (int i = 1; i < count; ++i) {
+        if (!startsSegment(i) && m_timesMs[i] > m_timesMs[i - 1]) {
+            intervals.push_back(m_timesMs[i] - m_timesMs[i - 1]);
+        }
+    }
+    const qint64 pauseMs = std::max(kMinPauseMs, median(intervals) * kPauseFactor);
+    
+    for (int i = 1; i < count; ++i) {
+        if (m_timesMs[i] - m_timesMs[i - 1] > pauseMs) {
+            m_segmentStartBits[i >> 6] |= quint64(1) << (i & 63);
+        }
+    }
+}
+
+void TrackStore::computeStats()
+{
+    const int count = size();
+    m_stats = TrackStats();
+    m_segmentStarts.clear();
+    
+    std::vector<qint64> intervals;
+    intervals.reserve(count);
+    qint64 totalMs = 0;
+    for (int i = 0; i < count; ++i) {
+        if (startsSegment(i)) {
+            m_segmentStarts.push_back(i);
+            if (i > 0) {
+                m_stats.longestGapMs = std::max(m_stats.longestGapMs,
+                                                m_timesMs[i] - m_timesMs[i - 1]);
+            }
+        } else if (m_timesMs[i] > m_timesMs[i - 1]) {
+            intervals.push_back(m_timesMs[i] - m_timesMs[i - 1]);
+            totalMs += intervals.back();
+        }
+    }
+    
+    m_stats.segmentCount = static_cast<int>(m_segmentStarts.size());
+    if (!intervals.empty()) {
+        m_stats.averageIntervalSeconds = totalMs / 1000.0 / intervals.size();
+    }
+    m_stats.medianIntervalMs = median(intervals);
+}
+
+void TrackStore::assign(const qint64* timesMs, const double* latitudes,
+                        const double* longitudes, const float* elevations,
+                        const quint64* elevationValid, const quint64* segmentStarts,
+                        int count)
+{
+    const int words = (count + 63) / 64;
+    m_timesMs.assign(timesMs, timesMs + count);
+    m_latitudes.assign(latitudes, latitudes + count);
+    m_longitudes.assign(longitudes, longitudes + count);
+    m_elevations.assign(elevations, elevations + count);
+    m_elevationValid.assign(elevationValid, elevationValid + words);
+    m_segmentStartBits.assign(segmentStarts, segmentStarts + words);
+    m_recordedStarts.clear();
+    if (count > 0) {
+        m_segmentStartBits[0] |= 1;
+    }
+    computeStats();
+}
+
+TrackPoint TrackStore::pointAt(int index) const
+{
+    TrackPoint point;
+    point.timestamp = QDateTime::fromMSecsSinceEpoch(m_timesMs[index], QTimeZone::utc());
+    point.latitude = m_latitudes[index];
+    point.longitude = m_longitudes[index];
+    point.elevation = elevation(index);
+    return point;
+}
+
+size_t TrackStore::memoryUsage() const
+{
+    return m_timesMs.capacity() * sizeof(qint64)
+         + m_latitudes.capacity() * sizeof(double)
+         + m_longitudes.capacity() * sizeof(double)
+         + m_elevations.capacity() * sizeof(float)
+         + m_elevationValid.capacity() * sizeof(quint64)
+         + m_segmentStartBits.capacity() * sizeof(quint64)
+         + m_segmentStarts.capacity() * sizeof(int);
+}
+
+} // namespace lyp
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "models/track_point.h"
+#include <QtGlobal>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace lyp {
+
+/**
+ * @brief Track statistics, computed once by TrackStore::finalize().
+ */
+struct TrackStats {
+    int segmentCount = 0;               // Gaps are segmentCount - 1
+    qint64 medianIntervalMs = 0;        // Point spacing within segments; 0 if none
+    double averageIntervalSeconds = 0.0;
+    qint64 longestGapMs = 0;            // Longest break between segments
+};
+
+/**
+ * @brief Compact, structure-of-arrays storage for a GPS track.
+ *
+ * Times are kept as UTC epoch milliseconds in one contiguous array so
+ * lookups are cache-friendly; elevation validity is a bitmap instead of a
+ * per-point std::optional. Once built, a store is shared read-only through
+ * TrackStorePtr between the parser, matcher and map without deep copies.
+ *
+ * Points are grouped into segments: runs recorded without interruption.
+ * A segment ends where a GPX <trkseg> ends (unless another one overlaps it
+ * in time) or at a pause much longer than the usual point spacing, such as
+ * a tunnel or a switched-off device. Segment starts are a bitmap, so
+ * checking whether two neighbouring points straddle a gap is O(1).
+ */
+class TrackStore {
+public:
+    TrackStore() = default;
+    
+    /**
+     * @brief Reserve space for a number of points.
+     */
+    void reserve(int count);
+    
+    /**
+     * @brief Append a trackpoint.
+     * @param timeMs UTC time in milliseconds since epoch
+     * @param latitude Latitude in degrees
+     * @param longitude Longitude in degrees
+     * @param elevation Elevation in metres (optional)
+     */
+    void append(qint64 timeMs, double latitude, double longitude,
+                std::optional<double> elevation = std::nullopt);
+    
+    /**
+     * @brief Start a new recorded segment (e.g. a GPX <trkseg>) with the
+     *        next appended point.
+     */
+    void beginSegment();
+    
+    /**
+     * @brief Stable-sort all points by time. No-op if already sorted.
+     *
+     * Does not touch segments; use finalize() after appending.
+     */
+    void sortByTime();
+    
+    /**
+     * @brief Sort by time, then compute segments and statistics.
+     *
+     * Call once after the last append. Recorded segments that overlap in
+     * time are joined; long pauses then split segments further.
+     */
+    void finalize();
+    
+    /**
+     * @brief Replace the contents with raw column data.
+     *
+     * Used to load serialized tracks; each pointer must hold `count` entries
+     * (the bitmaps hold (count + 63) / 64 words). Points must be sorted and
+     * the statistics are recomputed from the segment bitmap.
+     */
+    void assign(const qint64* timesMs, const double* latitudes,
+                const double* longitudes, const float* elevations,
+                const quint64* elevationValid, const quint64* segmentStarts,
+                int count);
+    
+    int size() const { return static_cast<int>(m_timesMs.size()); }
+    bool isEmpty() const { return m_timesMs.empty(); }
+    
+    /**
+     * @brief Sorted point times in UTC epoch milliseconds.
+     */
+    const std::vector<qint64>& timesMs() const { return m_timesMs; }
+    const std::vector<double>& latitudes() const { return m_latitudes; }
+    const std::vector<double>& longitudes() const { return m_longitudes; }
+    const std::vector<float>& elevations() const { return m_elevations; }
+    const std::vector<quint64>& elevationValidBits() const { return m_elevationValid; }
+    const std::vector<quint64>& segmentStartBits() const { return m_segmentStartBits; }
+    
+    qint64 timeMs(int index) const { return m_timesMs[index]; }
+    double latitude(int index) const { return m_latitudes[index]; }
+    double longitude(int index) const { return m_longitudes[index]; }
+    
+    bool hasElevation(int index) const {
+        return (m_elevationValid[index >> 6] >> (index & 63)) & 1u;
+    }
+    
+    std::optional<double> elevation(int index) const {
+        if (!hasElevation(index)) {
+            return std::nullopt;
+        }
+        return m_elevations[index];
+    }
+    
+    /**
+     * @brief Check if a point begins a segment, i.e. follows a gap.
+     *
+     * Point 0 always does. Neighbours i - 1 and i may only be interpolated
+     * if point i does not.
+     */
+    bool startsSegment(int index) const {
+        return (m_segmentStartBits[index >> 6] >> (index & 63)) & 1u;
+    }
+    
+    /**
+     * @brief Index of the first point of each segment, ascending.
+     */
+    const std::vector<int>& segmentStarts() const { return m_segmentStarts; }
+    
+    /**
+     * @brief Statistics from the last finalize() or assign().
+     */
+    const TrackStats& stats() const { return m_stats; }
+    
+    /**
+     * @brief Materialize a single point, e.g. for display or logging.
+     */
+    TrackPoint pointAt(int index) const;
+    
+    /**
+     * @brief Approximate heap memory used by the store, in bytes.
+     */
+    size_t memoryUsage() const;
+
+private:
+    void splitAtPauses();
+    void computeStats();
+    
+    std::vector<qint64> m_timesMs;
+    std::vector<double> m_latitudes;
+    std::vector<double> m_longitudes;
+    std::vector<float> m_elevations;
+    std::vector<quint64> m_elevationValid; // One bit per point
+    std::vector<quint64> m_segmentStartBits; // One bit per point
+    std::vector<int> m_segmentStarts;
+    std::vector<int> m_recordedStarts;     // beginSegment() marks until finalize()
+    TrackStats m_stats;
+};
+
+/**
+ * @brief Shared, immutable handle to a track.
+ */
+using TrackStorePtr = std::shared_ptr<const TrackStore>;
+
+} // namespace lyp
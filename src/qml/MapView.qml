@@ -6,8 +6,6 @@ import QtPositioning
 Item {
     id: root
     
-    property var trackPoints: []
-    property var photoMarkers: []
     property int highlightedIndex: -1
     
     // Map plugin (OpenStreetMap)
@@ -57,56 +55,76 @@ Item {
         
         property geoCoordinate startCentroid
         
-        // GPS Track polyline
+        // Integer zoom used to pick the simplified track level
+        property int trackZoom: Math.floor(zoomLevel)
+        onTrackZoomChanged: {
+            refreshTrack();
+            photoMarkerModel.setZoomLevel(trackZoom);
+        }
+        Component.onCompleted: photoMarkerModel.setZoomLevel(trackZoom)
+        
+        // GPS Track polyline; the path is set from C++ per zoom level
         MapPolyline {
             id: trackLine
             line.width: 3
             line.color: "#3388ff"
-            path: {
-                var coords = [];
-                for (var i = 0; i < root.trackPoints.length; i++) {
-                    var pt = root.trackPoints[i];
-                    coords.push(QtPositioning.coordinate(pt.latitude, pt.longitude));
-                }
-                return coords;
-            }
         }
         
-        // Photo markers
+        // Photo markers; one row per photo, clustered at low zoom
         MapItemView {
-            model: ListModel { id: markerModel }
+            model: photoMarkerModel
             delegate: MapQuickItem {
-                coordinate: QtPositioning.coordinate(model.latitude, model.longitude)
+                visible: model.markerVisible
+                coordinate: QtPositioning.coordinate(model.markerLatitude, model.markerLongitude)
                 anchorPoint.x: markerIcon.width / 2
                 anchorPoint.y: markerIcon.height
                 
                 sourceItem: Rectangle {
                     id: markerIcon
-                    width: 24
-                    height: 24
-                    radius: 12
-                    color: getStateColor(model.state)
+                    width: model.clusterSize > 1 ? 32 : 24
+                    height: width
+                    radius: width / 2
+                    color: model.clusterSize > 1 ? "#3388ff" : getStateColor(model.state)
                     border.width: model.index === root.highlightedIndex ? 3 : 1
                     border.color: model.index === root.highlightedIndex ? "#ff0" : "#fff"
                     
                     Text {
                         anchors.centerIn: parent
-                        text: "📷"
+                        text: model.clusterSize > 1 ? model.clusterSize : "📷"
+                        color: "#fff"
                         font.pixelSize: 12
+                        font.bold: model.clusterSize > 1
                     }
                     
-                    MouseArea {
-                        anchors.fill: parent
-                        onClicked: {
-                            mapPanel.photoMarkerClicked(model.index);
-                        }
-                    }
-                    
-                    // Tooltip
+                    // Tooltip; the thumbnail is only requested while it is shown
                     ToolTip {
                         id: tooltip
                         visible: mouseArea.containsMouse
-                        text: model.fileName || ""
+                        text: model.clusterSize > 1
+                              ? qsTr("%1 photos").arg(model.clusterSize)
+                              : (model.fileName || "")
+                        
+                        contentItem: Column {
+                            spacing: 4
+                            
+                            Image {
+                                anchors.horizontalCenter: parent.horizontalCenter
+                                visible: status === Image.Ready
+                                asynchronous: true
+                                sourceSize.width: 160
+                                sourceSize.height: 160
+                                source: tooltip.visible && model.clusterSize <= 1 && model.filePath
+                                        ? "image://thumbnails/" + encodeURIComponent(model.filePath)
+                                        : ""
+                            }
+                            
+                            Text {
+                                anchors.horizontalCenter: parent.horizontalCenter
+                                text: tooltip.text
+                                color: tooltip.palette.toolTipText
+                                font: tooltip.font
+                            }
+                        }
                     }
                     
                     MouseArea {
@@ -197,44 +215,29 @@ Item {
         }
     }
     
-    // JavaScript functions called from C++
-    function setTrackPoints(points) {
-        root.trackPoints = points;
-        if (points.length > 0) {
+    Connections {
+        target: mapPanel
+        function onTrackChanged() {
             centerOnTrack();
+            refreshTrack();
         }
-    }
-    
-    function addPhotoMarker(marker) {
-        markerModel.append(marker);
-    }
-    
-    function updatePhotoMarker(marker) {
-        for (var i = 0; i < markerModel.count; i++) {
-            if (markerModel.get(i).index === marker.index) {
-                markerModel.set(i, marker);
-                break;
-            }
+        // A detailed level replaced the preview; keep the view where it is
+        function onTrackPathsUpdated() {
+            refreshTrack();
         }
     }
     
-    function clearPhotoMarkers() {
-        markerModel.clear();
+    function refreshTrack() {
+        trackLine.setPath(mapPanel.trackPath(map.trackZoom));
     }
     
+    // JavaScript functions called from C++
     function centerOnTrack() {
-        if (root.trackPoints.length === 0) return;
+        var bounds = mapPanel.trackBounds();
+        if (bounds.minLat === undefined) return;
         
-        var minLat = 90, maxLat = -90;
-        var minLon = 180, maxLon = -180;
-        
-        for (var i = 0; i < root.trackPoints.length; i++) {
-            var pt = root.trackPoints[i];
-            minLat = Math.min(minLat, pt.latitude);
-            maxLat = Math.max(maxLat, pt.latitude);
-            minLon = Math.min(minLon, pt.longitude);
-            maxLon = Math.max(maxLon, pt.longitude);
-        }
+        var minLat = bounds.minLat, maxLat = bounds.maxLat;
+        var minLon = bounds.minLon, maxLon = bounds.maxLon;
         
         var centerLat = (minLat + maxLat) / 2;
         var centerLon = (minLon + maxLon) / 2;
@@ -251,16 +254,12 @@ Item {
         else map.zoomLevel = 16;
     }
     
-    function highlightPhoto(index) {
+    function highlightPhoto(index, latitude, longitude, hasCoordinates) {
         root.highlightedIndex = index;
         
         // Center on the photo
-        for (var i = 0; i < markerModel.count; i++) {
-            if (markerModel.get(i).index === index) {
-                var marker = markerModel.get(i);
-                map.center = QtPositioning.coordinate(marker.latitude, marker.longitude);
-                break;
-            }
+        if (hasCoordinates) {
+            map.center = QtPositioning.coordinate(latitude, longitude);
         }
     }
 }
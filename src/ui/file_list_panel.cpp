@@ -1,4 +1,5 @@
 #include "file_list_panel.h"
+#include "thumbnail_cache.h"
 #include "models/photo_list_model.h"
 #include <QAction>
 #include <QDragEnterEvent>
@@ -22,6 +23,11 @@ class PhotoItemDelegate : public QStyledItemDelegate {
 public:
   using QStyledItemDelegate::QStyledItemDelegate;
 
+  // Thumbnail box at the left of each row
+  static constexpr int kThumbnailBox = 36;
+
+  void setThumbnailCache(ThumbnailCache *cache) { m_thumbnails = cache; }
+
   void paint(QPainter *painter, const QStyleOptionViewItem &option,
              const QModelIndex &index) const override {
     QStyleOptionViewItem opt = option;
@@ -75,8 +81,26 @@ public:
                       Qt::AlignVCenter | Qt::AlignLeft, stateChar);
     painter->restore();
 
+    // Only painted rows ask for thumbnails, so off-screen rows cost nothing
+    int textLeft = 24;
+    if (m_thumbnails) {
+      const QRect box(opt.rect.left() + 22,
+                      opt.rect.top() + (opt.rect.height() - kThumbnailBox) / 2,
+                      kThumbnailBox, kThumbnailBox);
+      const QImage thumbnail = m_thumbnails->thumbnail(
+          index.data(PhotoListModel::FilePathRole).toString());
+      if (!thumbnail.isNull()) {
+        const QSize size =
+            thumbnail.size().scaled(box.size(), Qt::KeepAspectRatio);
+        QRect target(QPoint(0, 0), size);
+        target.moveCenter(box.center());
+        painter->drawImage(target, thumbnail);
+      }
+      textLeft = box.right() + 6;
+    }
+
     // Draw filename
-    QRect textRect = opt.rect.adjusted(24, 0, -80, -14);
+    QRect textRect = opt.rect.adjusted(textLeft, 0, -80, -14);
     painter->drawText(textRect, Qt::AlignVCenter | Qt::AlignLeft, fileName);
 
     // Draw error message or status on second line
@@ -87,7 +111,7 @@ public:
       QFont smallFont = painter->font();
       smallFont.setPointSize(8);
       painter->setFont(smallFont);
-      QRect errorRect = opt.rect.adjusted(24, 14, -4, 0);
+      QRect errorRect = opt.rect.adjusted(textLeft, 14, -4, 0);
       QString elidedError = painter->fontMetrics().elidedText(
           errorMsg, Qt::ElideRight, errorRect.width());
       painter->drawText(errorRect, Qt::AlignVCenter | Qt::AlignLeft,
@@ -114,6 +138,9 @@ public:
     Q_UNUSED(index)
     return QSize(200, 40); // Taller to show error message
   }
+
+private:
+  ThumbnailCache *m_thumbnails = nullptr;
 };
 
 FileListPanel::FileListPanel(QWidget *parent) : QWidget(parent) {
@@ -170,7 +197,7 @@ void FileListPanel::setupWorkflowPanel(QLayout *parentLayout) {
   m_addPhotosButton = new QPushButton("Add...", this);
   m_addPhotosButton->setMaximumWidth(80);
   m_addPhotosButton->setToolTip(
-      "Add photos from file dialog or drag & drop below");
+      "Add photos from file dialog or drag & drop files or folders below");
   connect(m_addPhotosButton, &QPushButton::clicked, this,
           &FileListPanel::addPhotosRequested);
   step2Layout->addWidget(m_addPhotosButton);
@@ -247,6 +274,14 @@ void FileListPanel::setupSettingsPanel(QLayout *parentLayout) {
           QOverload<double>::of(&QDoubleSpinBox::valueChanged), this,
           [this](double) { m_timezoneHintLabel->setVisible(false); });
   timeLayout->addWidget(m_timeOffsetSpinBox);
+
+  m_suggestOffsetButton = new QPushButton("Suggest", this);
+  m_suggestOffsetButton->setMaximumWidth(70);
+  m_suggestOffsetButton->setToolTip(
+      "Pick the timezone that best aligns photo times with the GPX track.");
+  connect(m_suggestOffsetButton, &QPushButton::clicked, this,
+          &FileListPanel::suggestOffsetRequested);
+  timeLayout->addWidget(m_suggestOffsetButton);
   timeLayout->addStretch();
   layout->addLayout(timeLayout);
 
@@ -304,7 +339,8 @@ void FileListPanel::setupPhotoList(QLayout *parentLayout) {
 
   // List view
   m_listView = new QListView(this);
-  m_listView->setItemDelegate(new PhotoItemDelegate(m_listView));
+  m_delegate = new PhotoItemDelegate(m_listView);
+  m_listView->setItemDelegate(m_delegate);
   m_listView->setSelectionMode(QAbstractItemView::ExtendedSelection);
   m_listView->setDragDropMode(QAbstractItemView::DropOnly);
   m_listView->setAcceptDrops(true);
@@ -326,6 +362,10 @@ double FileListPanel::timeOffsetHours() const {
   return m_timeOffsetSpinBox->value();
 }
 
+void FileListPanel::setTimeOffsetHours(double hours) {
+  m_timeOffsetSpinBox->setValue(hours);
+}
+
 bool FileListPanel::isDryRun() const { return m_dryRunCheck->isChecked(); }
 
 bool FileListPanel::isOverwriteGps() const {
@@ -374,6 +414,14 @@ void FileListPanel::setModel(PhotoListModel *model) {
           &FileListPanel::updatePhotoCount);
 }
 
+void FileListPanel::setThumbnailCache(ThumbnailCache *cache) {
+  m_delegate->setThumbnailCache(cache);
+  // Repaints are coalesced, so a burst of thumbnails costs one paint
+  connect(cache, &ThumbnailCache::thumbnailReady, m_listView->viewport(),
+          [this]() { m_listView->viewport()->update(); });
+  m_listView->viewport()->update();
+}
+
 void FileListPanel::onSelectionChanged() {
   QModelIndexList selected = m_listView->selectionModel()->selectedIndexes();
   if (!selected.isEmpty()) {
@@ -464,6 +512,7 @@ void FileListPanel::dragMoveEvent(QDragMoveEvent *event) {
 
 void FileListPanel::dropEvent(QDropEvent *event) {
   QStringList filePaths;
+  QStringList directories;
 
   for (const QUrl &url : event->mimeData()->urls()) {
     if (url.isLocalFile()) {
@@ -471,12 +520,19 @@ void FileListPanel::dropEvent(QDropEvent *event) {
       QFileInfo info(path);
       if (info.isFile()) {
         filePaths.append(path);
+      } else if (info.isDir()) {
+        directories.append(path);
       }
     }
   }
 
   if (!filePaths.isEmpty()) {
     emit photosDropped(filePaths);
+  }
+  if (!directories.isEmpty()) {
+    emit foldersDropped(directories);
+  }
+  if (!filePaths.isEmpty() || !directories.isEmpty()) {
     event->acceptProposedAction();
   }
 }
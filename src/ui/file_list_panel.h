@@ -10,7 +10,9 @@
 
 namespace lyp {
 
+class PhotoItemDelegate;
 class PhotoListModel;
+class ThumbnailCache;
 
 /**
  * @brief Left panel with workflow-guided UI showing steps, settings, and photo
@@ -25,8 +27,15 @@ public:
   void setModel(PhotoListModel *model);
   PhotoListModel *model() const { return m_model; }
 
+  /**
+   * @brief Show thumbnails in the photo list.
+   * @param cache Thumbnail cache (not owned)
+   */
+  void setThumbnailCache(ThumbnailCache *cache);
+
   // Settings accessors
   double timeOffsetHours() const;
+  void setTimeOffsetHours(double hours);
   bool isDryRun() const;
   bool isOverwriteGps() const;
 
@@ -38,11 +47,13 @@ signals:
   void gpxLoadRequested();
   void addPhotosRequested();
   void photosDropped(const QStringList &filePaths);
+  void foldersDropped(const QStringList &directories);
   void photoSelectionChanged(int index);
   void processRequested();
   void photosCleared();
   void moreSettingsRequested();
   void settingsChanged();
+  void suggestOffsetRequested();
 
 protected:
   void dragEnterEvent(QDragEnterEvent *event) override;
@@ -77,12 +88,14 @@ private:
   QGroupBox *m_settingsGroup;
   QLabel *m_timezoneHintLabel;
   QDoubleSpinBox *m_timeOffsetSpinBox;
+  QPushButton *m_suggestOffsetButton;
   QCheckBox *m_dryRunCheck;
   QCheckBox *m_overwriteGpsCheck;
   QPushButton *m_moreSettingsButton;
 
   // Photo list
   QListView *m_listView;
+  PhotoItemDelegate *m_delegate;
   QPushButton *m_clearButton;
   QLabel *m_statusLabel;
 
@@ -1,15 +1,19 @@
 #include "main_window.h"
+#include "core/batch_journal.h"
 #include "core/exif_handler.h"
 #include "core/exiftool_writer.h"
 #include "core/photo_processor.h"
 #include "file_list_panel.h"
 #include "map_panel.h"
+#include "thumbnail_cache.h"
 #include "models/photo_list_model.h"
 #include <QAction>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDialog>
 #include <QDialogButtonBox>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFormLayout>
@@ -18,6 +22,7 @@
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QSettings>
+#include <QSpinBox>
 #include <QStatusBar>
 
 namespace lyp {
@@ -33,19 +38,33 @@ MainWindow::MainWindow(QWidget *parent)
           &MainWindow::onGpxLoaded);
   connect(m_processor, &PhotoProcessor::gpxLoadError, this,
           &MainWindow::onGpxLoadError);
+  connect(m_processor, &PhotoProcessor::gpxLoadProgress, this,
+          [this](int filesDone, int fileCount) {
+            if (m_processor->isProcessing())
+              return;
+            // A single file has no useful fraction; show a busy bar
+            m_progressBar->setVisible(true);
+            m_progressBar->setMaximum(fileCount > 1 ? fileCount : 0);
+            m_progressBar->setValue(filesDone);
+          });
   connect(m_processor, &PhotoProcessor::photosScanComplete, this,
           &MainWindow::onPhotosScanComplete);
-  connect(m_processor, &PhotoProcessor::photoProcessed, this,
-          &MainWindow::onPhotoProcessed);
+  connect(m_processor, &PhotoProcessor::scanProgress, this,
+          [this](int current, int total) {
+            m_statusLabel->setText(QString("Scanning photos... %1 of %2")
+                                       .arg(current)
+                                       .arg(total));
+          });
   connect(m_processor, &PhotoProcessor::processingComplete, this,
           &MainWindow::onProcessingComplete);
   connect(m_processor, &PhotoProcessor::progressUpdated, this,
           &MainWindow::onProgressUpdated);
 
-  // Connect model to map panel
-  connect(m_photoModel, &PhotoListModel::photoUpdated, [this](int index) {
-    m_mapPanel->updatePhotoMarker(index, m_photoModel->photos()[index]);
-  });
+  // Re-match in memory once the offset spin box settles
+  m_previewTimer.setSingleShot(true);
+  m_previewTimer.setInterval(150);
+  connect(&m_previewTimer, &QTimer::timeout, this,
+          &MainWindow::onPreviewMatches);
 }
 
 MainWindow::~MainWindow() = default;
@@ -65,10 +84,18 @@ void MainWindow::setupUi() {
 
   // Right panel (map) - 70% width
   m_mapPanel = new MapPanel(this);
+  m_mapPanel->setPhotoModel(m_photoModel);
   m_splitter->addWidget(m_mapPanel);
 
   m_splitter->setSizes({350, 850});
 
+  // Children are destroyed in creation order, so the panels go first
+  m_thumbnails = new ThumbnailCache(this);
+  m_thumbnails->setDiskCacheDirectory(
+      ThumbnailCache::defaultDiskCacheDirectory());
+  m_fileListPanel->setThumbnailCache(m_thumbnails);
+  m_mapPanel->setThumbnailCache(m_thumbnails);
+
   // Status bar
   m_statusLabel = new QLabel("Ready — Load a GPX file to begin", this);
   statusBar()->addWidget(m_statusLabel, 1);
@@ -85,14 +112,20 @@ void MainWindow::setupUi() {
           &MainWindow::onAddPhotos);
   connect(m_fileListPanel, &FileListPanel::photosDropped, this,
           &MainWindow::onPhotosDropped);
+  connect(m_fileListPanel, &FileListPanel::foldersDropped, this,
+          &MainWindow::onFoldersDropped);
   connect(m_fileListPanel, &FileListPanel::photoSelectionChanged, this,
           &MainWindow::onPhotoSelectionChanged);
   connect(m_fileListPanel, &FileListPanel::processRequested, this,
           &MainWindow::onProcessPhotos);
-  connect(m_fileListPanel, &FileListPanel::photosCleared, m_mapPanel,
-          &MapPanel::clearPhotoMarkers);
+  connect(m_fileListPanel, &FileListPanel::photosCleared, m_processor,
+          &PhotoProcessor::cancelScan);
   connect(m_fileListPanel, &FileListPanel::moreSettingsRequested, this,
           &MainWindow::onMoreSettings);
+  connect(m_fileListPanel, &FileListPanel::settingsChanged, this,
+          [this]() { m_previewTimer.start(); });
+  connect(m_fileListPanel, &FileListPanel::suggestOffsetRequested, this,
+          &MainWindow::onSuggestOffset);
 }
 
 void MainWindow::setupMenus() {
@@ -107,6 +140,25 @@ void MainWindow::setupMenus() {
   addPhotosAction->setShortcut(QKeySequence("Ctrl+O"));
   connect(addPhotosAction, &QAction::triggered, this, &MainWindow::onAddPhotos);
 
+  QAction *addFolderAction = fileMenu->addAction("Add &Folder...");
+  addFolderAction->setShortcut(QKeySequence("Ctrl+Shift+O"));
+  connect(addFolderAction, &QAction::triggered, this, &MainWindow::onAddFolder);
+
+  fileMenu->addSeparator();
+
+  QAction *stopAction = fileMenu->addAction("S&top Processing");
+  stopAction->setShortcut(QKeySequence(Qt::Key_Escape));
+  connect(stopAction, &QAction::triggered, this, [this]() {
+    if (m_processor->isLoadingGpx()) {
+      m_processor->cancelGpxLoad();
+      if (!m_processor->isProcessing()) {
+        m_progressBar->setVisible(false);
+        m_statusLabel->setText("GPX loading cancelled");
+      }
+    }
+    m_processor->stopProcessing();
+  });
+
   fileMenu->addSeparator();
 
   QAction *quitAction = fileMenu->addAction("&Quit");
@@ -162,6 +214,33 @@ void MainWindow::createSettingsDialog() {
       "Always interpolate between trackpoints regardless of time difference.");
   layout->addRow(forceCheck);
 
+  auto *workerSpin = new QSpinBox(&dialog);
+  workerSpin->setRange(0, 64);
+  workerSpin->setSpecialValueText("Auto");
+  workerSpin->setValue(m_workerCount);
+  workerSpin->setToolTip("Number of threads reading and writing photos each.\n"
+                         "Raise for photos on network storage.\n0 = "
+                         "Automatic (one per CPU core).");
+  layout->addRow("Worker Threads:", workerSpin);
+
+  auto *outputCombo = new QComboBox(&dialog);
+  outputCombo->addItem("Embed in photo");
+  outputCombo->addItem("XMP sidecar (.xmp)");
+  outputCombo->setCurrentIndex(m_writeSidecar ? 1 : 0);
+  outputCombo->setToolTip("Where GPS data is written.\nXMP sidecar leaves the "
+                          "photo untouched and writes a small .xmp file next "
+                          "to it,\nwhich is much faster for large RAW files.");
+  layout->addRow("Output:", outputCombo);
+
+  auto *journalCheck =
+      new QCheckBox("Keep a resume journal and audit log", &dialog);
+  journalCheck->setChecked(m_useJournal);
+  journalCheck->setToolTip(
+      "Log every photo written, and skip photos an interrupted run with the "
+      "same settings\nalready finished. The journal is kept in the "
+      "application data directory.");
+  layout->addRow(journalCheck);
+
   auto *buttonBox = new QDialogButtonBox(
       QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
   connect(buttonBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
@@ -171,6 +250,10 @@ void MainWindow::createSettingsDialog() {
   if (dialog.exec() == QDialog::Accepted) {
     m_maxTimeDiff = maxTimeDiffSpin->value();
     m_forceInterpolate = forceCheck->isChecked();
+    m_workerCount = workerSpin->value();
+    m_writeSidecar = outputCombo->currentIndex() == 1;
+    m_useJournal = journalCheck->isChecked();
+    m_previewTimer.start();
   }
 }
 
@@ -181,6 +264,13 @@ ProcessingSettings MainWindow::getSettings() const {
   settings.overwriteExistingGps = m_fileListPanel->isOverwriteGps();
   settings.forceInterpolate = m_forceInterpolate;
   settings.dryRun = m_fileListPanel->isDryRun();
+  settings.workerCount = m_workerCount;
+  settings.outputMode =
+      m_writeSidecar ? OutputMode::XmpSidecar : OutputMode::EmbedInFile;
+  settings.traceFilePath = qEnvironmentVariable("LYP_PERF_TRACE");
+  if (m_useJournal) {
+    settings.journalFilePath = BatchJournal::defaultFilePath();
+  }
   return settings;
 }
 
@@ -190,8 +280,8 @@ void MainWindow::onLoadGpx() {
 
   if (!filePath.isEmpty()) {
     m_gpxFileName = QFileInfo(filePath).fileName();
-    m_statusLabel->setText("Loading GPX file...");
-    m_processor->loadGpxFile(filePath);
+    m_statusLabel->setText("Loading GPX file... (Esc to cancel)");
+    m_processor->loadGpxFilesAsync({filePath});
   }
 }
 
@@ -213,18 +303,42 @@ void MainWindow::onAddPhotos() {
   }
 }
 
+void MainWindow::onAddFolder() {
+  QString directory =
+      QFileDialog::getExistingDirectory(this, "Add Folder", QString());
+
+  if (!directory.isEmpty()) {
+    onFoldersDropped({directory});
+  }
+}
+
 void MainWindow::onPhotosDropped(const QStringList &filePaths) {
   m_statusLabel->setText("Scanning photos...");
   m_processor->scanPhotos(filePaths, m_photoModel);
 }
 
+void MainWindow::onFoldersDropped(const QStringList &directories) {
+  m_statusLabel->setText("Searching folders for photos...");
+  m_processor->scanDirectories(directories, m_photoModel);
+}
+
 void MainWindow::onProcessPhotos() {
+  if (m_processor->isProcessing()) {
+    return;
+  }
+
   if (!m_processor->hasGpxLoaded()) {
     QMessageBox::warning(this, "No GPX Loaded",
                          "Please load a GPX trace file first.");
     return;
   }
 
+  if (m_processor->isLoadingGpx()) {
+    QMessageBox::warning(this, "GPX Loading",
+                         "Please wait for the GPX trace to finish loading.");
+    return;
+  }
+
   if (m_photoModel->count() == 0) {
     QMessageBox::warning(this, "No Photos", "Please add photos to process.");
     return;
@@ -241,6 +355,11 @@ void MainWindow::onProcessPhotos() {
     const PhotoItem &photo = m_photoModel->photos()[i];
     FormatInfo info = ExifHandler::getFormatInfo(photo.filePath);
 
+    // Sidecars never touch the photo, so only unreadable formats matter
+    if (m_writeSidecar && info.level != FormatSupportLevel::Minimal) {
+      continue;
+    }
+
     if (info.level == FormatSupportLevel::NeedsExifTool) {
       exiftoolFiles.append(photo.fileName);
       formatWarnings[photo.fileName] = info.warning;
@@ -387,7 +506,6 @@ void MainWindow::onProcessPhotos() {
   // Reset all photo states before reprocessing
   m_photoModel->resetAllStates();
 
-  m_mapPanel->clearPhotoMarkers();
   m_progressBar->setVisible(true);
   m_progressBar->setMaximum(m_photoModel->count());
   m_progressBar->setValue(0);
@@ -396,19 +514,70 @@ void MainWindow::onProcessPhotos() {
   m_processor->processPhotos(m_photoModel, getSettings());
 }
 
+void MainWindow::onPreviewMatches() {
+  if (m_processor->isProcessing() || m_processor->isScanning() ||
+      !m_processor->hasGpxLoaded() || m_photoModel->count() == 0) {
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  const ProcessingSettings settings = getSettings();
+  const int matched = m_processor->previewMatches(m_photoModel, settings);
+  m_statusLabel->setText(QString("Preview at %1 h: %2 of %3 photos matched "
+                                 "(%4 ms)")
+                             .arg(settings.timeOffsetHours, 0, 'f', 1)
+                             .arg(matched)
+                             .arg(m_photoModel->count())
+                             .arg(timer.elapsed()));
+}
+
+void MainWindow::onSuggestOffset() {
+  if (!m_processor->hasGpxLoaded() || m_photoModel->count() == 0) {
+    QMessageBox::warning(this, "Suggest Timezone",
+                         "Load a GPX trace and add photos first.");
+    return;
+  }
+
+  // Half-hour steps over every real-world UTC offset
+  const auto suggestion = m_processor->suggestTimeOffset(
+      m_photoModel, getSettings(), -12.0, 14.0, 0.5);
+  if (!suggestion || suggestion->matchedCount == 0) {
+    m_statusLabel->setText("No timezone lines the photos up with the track");
+    return;
+  }
+
+  // Preview right away instead of through the debounce timer, so the
+  // suggestion stays in the status bar
+  m_fileListPanel->setTimeOffsetHours(suggestion->timeOffsetHours);
+  m_previewTimer.stop();
+  m_processor->previewMatches(m_photoModel, getSettings());
+  m_statusLabel->setText(QString("Suggested timezone %1 h: %2 of %3 photos "
+                                 "within the time threshold")
+                             .arg(suggestion->timeOffsetHours, 0, 'f', 1)
+                             .arg(suggestion->matchedCount)
+                             .arg(suggestion->photoCount));
+}
+
 void MainWindow::onPhotoSelectionChanged(int index) {
   m_mapPanel->highlightPhoto(index);
 }
 
 void MainWindow::onGpxLoaded(int trackpointCount) {
+  if (!m_processor->isProcessing()) {
+    m_progressBar->setVisible(false);
+  }
   m_statusLabel->setText(
       QString("GPX loaded: %1 trackpoints").arg(trackpointCount));
   m_fileListPanel->setGpxStatus(m_gpxFileName, trackpointCount);
-  m_mapPanel->setTrack(m_processor->trackpoints());
+  m_mapPanel->setTrack(m_processor->track());
   m_mapPanel->centerOnTrack();
 }
 
 void MainWindow::onGpxLoadError(const QString &error) {
+  if (!m_processor->isProcessing()) {
+    m_progressBar->setVisible(false);
+  }
   m_statusLabel->setText("Failed to load GPX");
   m_fileListPanel->clearGpxStatus();
   QMessageBox::warning(this, "GPX Load Error", error);
@@ -418,14 +587,6 @@ void MainWindow::onPhotosScanComplete(int count) {
   m_statusLabel->setText(QString("%1 photos added").arg(count));
 }
 
-void MainWindow::onPhotoProcessed(int index, bool success) {
-  Q_UNUSED(success)
-  const PhotoItem &photo = m_photoModel->photos()[index];
-  if (photo.hasMatchedCoordinates()) {
-    m_mapPanel->addPhotoMarker(photo);
-  }
-}
-
 void MainWindow::onProcessingComplete(int successCount, int totalCount) {
   m_progressBar->setVisible(false);
   bool isDryRun = m_fileListPanel->isDryRun();
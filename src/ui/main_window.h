@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include <QProgressBar>
 #include <QSplitter>
+#include <QTimer>
 
 namespace lyp {
 
@@ -11,6 +12,7 @@ class FileListPanel;
 class MapPanel;
 class PhotoProcessor;
 class PhotoListModel;
+class ThumbnailCache;
 struct ProcessingSettings;
 
 /**
@@ -26,16 +28,19 @@ public:
 private slots:
   void onLoadGpx();
   void onAddPhotos();
+  void onAddFolder();
   void onPhotosDropped(const QStringList &filePaths);
+  void onFoldersDropped(const QStringList &directories);
   void onProcessPhotos();
   void onPhotoSelectionChanged(int index);
   void onMoreSettings();
+  void onSuggestOffset();
+  void onPreviewMatches();
 
   // Processor signals
   void onGpxLoaded(int trackpointCount);
   void onGpxLoadError(const QString &error);
   void onPhotosScanComplete(int count);
-  void onPhotoProcessed(int index, bool success);
   void onProcessingComplete(int successCount, int totalCount);
   void onProgressUpdated(int current, int total);
 
@@ -51,14 +56,19 @@ private:
   MapPanel *m_mapPanel;
   QProgressBar *m_progressBar;
   QLabel *m_statusLabel;
+  QTimer m_previewTimer; // Debounces re-matching while settings change
 
   // Core components
   PhotoProcessor *m_processor;
   PhotoListModel *m_photoModel;
+  ThumbnailCache *m_thumbnails; // Created after the panels that use it
 
   // Advanced settings (not in panel)
   double m_maxTimeDiff = 0.0; // 0 = auto
   bool m_forceInterpolate = false;
+  int m_workerCount = 0; // 0 = one per CPU core
+  bool m_writeSidecar = false; // XMP sidecar instead of embedding
+  bool m_useJournal = true; // Resume journal and audit log
 
   // Store GPX filename for display
   QString m_gpxFileName;
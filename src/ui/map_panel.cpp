@@ -1,20 +1,56 @@
 #include "map_panel.h"
+#include "thumbnail_provider.h"
+#include "core/perf_trace.h"
+#include "core/track_simplifier.h"
+#include "models/photo_list_model.h"
 #include <QVBoxLayout>
 #include <QQmlContext>
 #include <QQmlEngine>
 #include <QQuickItem>
-#include <QVariantList>
 #include <QVariantMap>
 #include <QDebug>
+#include <algorithm>
 
 namespace lyp {
 
+namespace {
+
+// Tracks up to this size are simplified synchronously; it takes a few ms
+constexpr int kSyncSimplifyPoints = 50000;
+
+// Vertices in the preview path shown while a level is computed
+constexpr int kPreviewVertices = 1000;
+
+QGeoPath toGeoPath(const TrackStore& track, const std::vector<int>& indices)
+{
+    QList<QGeoCoordinate> coordinates;
+    coordinates.reserve(static_cast<int>(indices.size()));
+    for (int index : indices) {
+        coordinates.append(QGeoCoordinate(track.latitude(index),
+                                          track.longitude(index)));
+    }
+    return QGeoPath(coordinates);
+}
+
+} // namespace
+
 MapPanel::MapPanel(QWidget* parent)
     : QWidget(parent)
+    , m_pathPool(new QThreadPool(this))
+    , m_markerModel(new PhotoMarkerModel(this))
 {
+    // One level at a time is plenty; it keeps the workers free for photos
+    m_pathPool->setMaxThreadCount(1);
     setupUi();
 }
 
+MapPanel::~MapPanel()
+{
+    // Queued results for a destroyed panel are discarded by Qt
+    m_pathPool->clear();
+    m_pathPool->waitForDone();
+}
+
 void MapPanel::setupUi()
 {
     auto* layout = new QVBoxLayout(this);
@@ -23,6 +59,7 @@ void MapPanel::setupUi()
     m_quickWidget = new QQuickWidget(this);
     m_quickWidget->setResizeMode(QQuickWidget::SizeRootObjectToView);
     m_quickWidget->engine()->rootContext()->setContextProperty("mapPanel", this);
+    m_quickWidget->engine()->rootContext()->setContextProperty("photoMarkerModel", m_markerModel);
     m_quickWidget->setSource(QUrl("qrc:/src/qml/MapView.qml"));
     
     // Check for errors
@@ -35,87 +72,101 @@ void MapPanel::setupUi()
     layout->addWidget(m_quickWidget);
 }
 
-void MapPanel::setTrack(const QVector<TrackPoint>& trackpoints)
+void MapPanel::setTrack(TrackStorePtr track)
 {
-    m_trackpoints = trackpoints;
+    m_track = std::move(track);
     updateTrackInQml();
 }
 
 void MapPanel::updateTrackInQml()
 {
-    QVariantList points;
-    for (const TrackPoint& tp : m_trackpoints) {
-        QVariantMap point;
-        point["latitude"] = tp.latitude;
-        point["longitude"] = tp.longitude;
-        if (tp.elevation.has_value()) {
-            point["elevation"] = tp.elevation.value();
-        }
-        points.append(point);
-    }
+    // Levels still being computed belong to the previous track
+    ++m_trackGeneration;
+    m_pathPool->clear();
+    m_pendingZoomLevels.clear();
+    m_trackPathCache.clear();
+    m_previewPath = QGeoPath();
+    m_trackBounds.clear();
     
-    QQuickItem* rootObject = m_quickWidget->rootObject();
-    if (rootObject) {
-        QMetaObject::invokeMethod(rootObject, "setTrackPoints",
-                                  Q_ARG(QVariant, QVariant::fromValue(points)));
+    if (m_track && !m_track->isEmpty()) {
+        m_previewPath = toGeoPath(*m_track,
+            TrackSimplifier::decimate(*m_track, kPreviewVertices));
+
+        const auto [minLat, maxLat] = std::minmax_element(
+            m_track->latitudes().begin(), m_track->latitudes().end());
+        const auto [minLon, maxLon] = std::minmax_element(
+            m_track->longitudes().begin(), m_track->longitudes().end());
+        m_trackBounds["minLat"] = *minLat;
+        m_trackBounds["maxLat"] = *maxLat;
+        m_trackBounds["minLon"] = *minLon;
+        m_trackBounds["maxLon"] = *maxLon;
     }
+    
+    emit trackChanged();
 }
 
-void MapPanel::addPhotoMarker(const PhotoItem& photo)
+QGeoPath MapPanel::trackPath(int zoomLevel)
 {
-    m_photoMarkers.append(photo);
+    if (!m_track || m_track->isEmpty()) {
+        return QGeoPath();
+    }
     
-    if (photo.hasMatchedCoordinates()) {
-        QQuickItem* rootObject = m_quickWidget->rootObject();
-        if (rootObject) {
-            QVariantMap marker;
-            marker["index"] = m_photoMarkers.size() - 1;
-            marker["latitude"] = photo.matchedLat.value();
-            marker["longitude"] = photo.matchedLon.value();
-            marker["fileName"] = photo.fileName;
-            marker["state"] = static_cast<int>(photo.state);
-            
-            QMetaObject::invokeMethod(rootObject, "addPhotoMarker",
-                                      Q_ARG(QVariant, QVariant::fromValue(marker)));
-        }
+    auto it = m_trackPathCache.constFind(zoomLevel);
+    if (it != m_trackPathCache.constEnd()) {
+        return it.value();
+    }
+    
+    if (m_track->size() <= kSyncSimplifyPoints) {
+        QGeoPath path = toGeoPath(*m_track,
+            TrackSimplifier::simplifyForZoom(*m_track, zoomLevel));
+        m_trackPathCache.insert(zoomLevel, path);
+        return path;
     }
+    
+    // Simplify in the background and show the preview meanwhile
+    if (!m_pendingZoomLevels.contains(zoomLevel)) {
+        m_pendingZoomLevels.insert(zoomLevel);
+        const TrackStorePtr track = m_track;
+        const quint64 generation = m_trackGeneration;
+        m_pathPool->start([this, track, generation, zoomLevel]() {
+            QGeoPath path = toGeoPath(*track,
+                TrackSimplifier::simplifyForZoom(*track, zoomLevel));
+            QMetaObject::invokeMethod(this, [this, generation, zoomLevel, path]() {
+                onTrackPathReady(generation, zoomLevel, path);
+            }, Qt::QueuedConnection);
+        });
+    }
+    return m_previewPath;
 }
 
-void MapPanel::updatePhotoMarker(int index, const PhotoItem& photo)
+void MapPanel::onTrackPathReady(quint64 generation, int zoomLevel, const QGeoPath& path)
 {
-    if (index >= 0 && index < m_photoMarkers.size()) {
-        m_photoMarkers[index] = photo;
-        
-        if (photo.hasMatchedCoordinates()) {
-            QQuickItem* rootObject = m_quickWidget->rootObject();
-            if (rootObject) {
-                QVariantMap marker;
-                marker["index"] = index;
-                marker["latitude"] = photo.matchedLat.value();
-                marker["longitude"] = photo.matchedLon.value();
-                marker["fileName"] = photo.fileName;
-                marker["state"] = static_cast<int>(photo.state);
-                
-                QMetaObject::invokeMethod(rootObject, "updatePhotoMarker",
-                                          Q_ARG(QVariant, QVariant::fromValue(marker)));
-            }
-        }
+    if (generation != m_trackGeneration) {
+        return;
     }
+    
+    m_pendingZoomLevels.remove(zoomLevel);
+    m_trackPathCache.insert(zoomLevel, path);
+    emit trackPathsUpdated();
 }
 
-void MapPanel::clearPhotoMarkers()
+void MapPanel::setPhotoModel(PhotoListModel* model)
 {
-    m_photoMarkers.clear();
-    QQuickItem* rootObject = m_quickWidget->rootObject();
-    if (rootObject) {
-        QMetaObject::invokeMethod(rootObject, "clearPhotoMarkers");
-    }
+    m_markerModel->setPhotoModel(model);
+}
+
+void MapPanel::setThumbnailCache(ThumbnailCache* cache)
+{
+    // The engine owns the provider
+    m_quickWidget->engine()->addImageProvider("thumbnails",
+                                              new ThumbnailImageProvider(cache));
 }
 
 void MapPanel::centerOnTrack()
 {
     QQuickItem* rootObject = m_quickWidget->rootObject();
     if (rootObject) {
+        ScopedTimer timer(PerfStage::QmlInvoke);
         QMetaObject::invokeMethod(rootObject, "centerOnTrack");
     }
 }
@@ -123,10 +174,20 @@ void MapPanel::centerOnTrack()
 void MapPanel::highlightPhoto(int index)
 {
     QQuickItem* rootObject = m_quickWidget->rootObject();
-    if (rootObject) {
-        QMetaObject::invokeMethod(rootObject, "highlightPhoto",
-                                  Q_ARG(QVariant, index));
+    PhotoListModel* photos = m_markerModel->photoModel();
+    if (!rootObject || !photos || index < 0 || index >= photos->count()) {
+        return;
     }
+    
+    // Direct row lookup; the photo index is the marker row
+    const PhotoItem& photo = photos->photos()[index];
+    const bool hasCoordinates = photo.hasMatchedCoordinates();
+    ScopedTimer timer(PerfStage::QmlInvoke);
+    QMetaObject::invokeMethod(rootObject, "highlightPhoto",
+                              Q_ARG(QVariant, index),
+                              Q_ARG(QVariant, photo.matchedLat.value_or(0.0)),
+                              Q_ARG(QVariant, photo.matchedLon.value_or(0.0)),
+                              Q_ARG(QVariant, hasCoordinates));
 }
 
 } // namespace lyp
@@ -1,45 +1,52 @@
 #pragma once
 
-#include "models/track_point.h"
-#include "models/photo_item.h"
+#include "models/track_store.h"
+#include "models/photo_marker_model.h"
+#include <QGeoPath>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
 #include <QWidget>
 #include <QQuickWidget>
-#include <QVector>
+#include <QVariantMap>
 
 namespace lyp {
 
+class ThumbnailCache;
+
 /**
  * @brief Right panel showing the map with GPS trace and photo markers.
+ *
+ * The track is handed to QML as a simplified QGeoPath per zoom level,
+ * computed on first use and cached, instead of one JS object per point.
+ * Large tracks are simplified on a background thread; until a level is
+ * ready QML gets a coarse, evenly sampled preview path.
+ * Photo markers come from a PhotoMarkerModel over the photo list.
  */
 class MapPanel : public QWidget {
     Q_OBJECT
 
 public:
     explicit MapPanel(QWidget* parent = nullptr);
+    ~MapPanel() override;
     
     /**
      * @brief Set the GPS track to display.
-     * @param trackpoints Vector of trackpoints
-     */
-    void setTrack(const QVector<TrackPoint>& trackpoints);
-    
-    /**
-     * @brief Add a photo marker to the map.
-     * @param photo Photo item with matched coordinates
+     * @param track Shared track
      */
-    void addPhotoMarker(const PhotoItem& photo);
+    void setTrack(TrackStorePtr track);
     
     /**
-     * @brief Update a photo marker on the map.
-     * @param index Photo index
-     * @param photo Photo item with updated state
+     * @brief Set the photo list whose matched coordinates are shown as markers.
+     * @param model Photo list model (not owned)
      */
-    void updatePhotoMarker(int index, const PhotoItem& photo);
+    void setPhotoModel(PhotoListModel* model);
     
     /**
-     * @brief Clear all photo markers.
+     * @brief Show thumbnails in the photo marker popups.
+     * @param cache Thumbnail cache (not owned; must outlive the panel)
      */
-    void clearPhotoMarkers();
+    void setThumbnailCache(ThumbnailCache* cache);
     
     /**
      * @brief Center map on the track.
@@ -51,17 +58,48 @@ public:
      * @param index Photo index to highlight
      */
     void highlightPhoto(int index);
+    
+    /**
+     * @brief Simplified track polyline for a zoom level (called from QML).
+     * @param zoomLevel Integer map zoom level
+     * @return Cached path with at most a few thousand vertices, or the
+     *         coarse preview while the level is still being computed
+     */
+    Q_INVOKABLE QGeoPath trackPath(int zoomLevel);
+    
+    /**
+     * @brief Bounding box of the track (called from QML).
+     * @return Map with minLat, maxLat, minLon, maxLon; empty without a track
+     */
+    Q_INVOKABLE QVariantMap trackBounds() const { return m_trackBounds; }
 
 signals:
     void photoMarkerClicked(int index);
+    
+    /**
+     * @brief Emitted when the track changes and QML should refetch paths.
+     */
+    void trackChanged();
+    
+    /**
+     * @brief Emitted when a detailed path replaces the preview.
+     */
+    void trackPathsUpdated();
 
 private:
     void setupUi();
     void updateTrackInQml();
+    void onTrackPathReady(quint64 generation, int zoomLevel, const QGeoPath& path);
     
     QQuickWidget* m_quickWidget;
-    QVector<TrackPoint> m_trackpoints;
-    QVector<PhotoItem> m_photoMarkers;
+    TrackStorePtr m_track;
+    QHash<int, QGeoPath> m_trackPathCache;
+    QGeoPath m_previewPath;
+    QSet<int> m_pendingZoomLevels;
+    quint64 m_trackGeneration = 0;
+    QThreadPool* m_pathPool;
+    QVariantMap m_trackBounds;
+    PhotoMarkerModel* m_markerModel;
 };
 
 } // namespace lyp
@@ -0,0 +1,239 @@
+#include "thumbnail_cache.h"
+#include "core/exif_handler.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTransform>
+
+namespace lyp {
+
+namespace {
+
+// About 600 thumbnails at full size
+constexpr qint64 kDefaultMemoryBudget = 64 * 1024 * 1024;
+
+// Part of the disk cache key; bumped when thumbnails come out differently
+constexpr int kDiskCacheVersion = 2;
+
+QImage scaledThumbnail(const QImage &image) {
+  if (image.width() <= ThumbnailCache::kThumbnailSize &&
+      image.height() <= ThumbnailCache::kThumbnailSize)
+    return image;
+  return image.scaled(ThumbnailCache::kThumbnailSize,
+                      ThumbnailCache::kThumbnailSize, Qt::KeepAspectRatio,
+                      Qt::SmoothTransformation);
+}
+
+/**
+ * @brief Turn an image upright according to an EXIF orientation (1-8).
+ */
+QImage applyOrientation(const QImage &image, int orientation) {
+  QTransform transform;
+  switch (orientation) {
+  case 2:
+    return image.mirrored(true, false);
+  case 3:
+    transform.rotate(180);
+    break;
+  case 4:
+    return image.mirrored(false, true);
+  case 5: // Transpose
+    transform.rotate(90);
+    return image.transformed(transform).mirrored(true, false);
+  case 6:
+    transform.rotate(90);
+    break;
+  case 7: // Transverse
+    transform.rotate(270);
+    return image.transformed(transform).mirrored(true, false);
+  case 8:
+    transform.rotate(270);
+    break;
+  default:
+    return image;
+  }
+  return image.transformed(transform);
+}
+
+/**
+ * @brief Decode an image file at reduced size (JPEG scales while decoding).
+ */
+QImage decodeScaled(const QString &filePath) {
+  QImageReader reader(filePath);
+  reader.setAutoTransform(true);
+  const QSize size = reader.size();
+  if (size.isValid()) {
+    reader.setScaledSize(size.scaled(ThumbnailCache::kThumbnailSize,
+                                     ThumbnailCache::kThumbnailSize,
+                                     Qt::KeepAspectRatio));
+  }
+  return reader.read();
+}
+
+} // namespace
+
+ThumbnailCache::ThumbnailCache(QObject *parent) : QObject(parent) {
+  m_images.setMaxCost(kDefaultMemoryBudget);
+  // Thumbnails are cosmetic; leave the cores to photo processing
+  m_pool.setMaxThreadCount(2);
+  m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+ThumbnailCache::~ThumbnailCache() {
+  clear();
+  m_pool.waitForDone();
+}
+
+QString ThumbnailCache::defaultDiskCacheDirectory() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/thumbnails";
+}
+
+void ThumbnailCache::setDiskCacheDirectory(const QString &directory) {
+  if (!directory.isEmpty()) {
+    QDir().mkpath(directory);
+  }
+  QMutexLocker locker(&m_mutex);
+  m_diskDirectory = directory;
+}
+
+void ThumbnailCache::setMemoryBudget(qint64 bytes) {
+  QMutexLocker locker(&m_mutex);
+  m_images.setMaxCost(bytes);
+}
+
+void ThumbnailCache::clear() {
+  QMutexLocker locker(&m_mutex);
+  m_images.clear();
+  m_missing.clear();
+  m_queue.clear();
+  m_queued.clear();
+}
+
+QImage ThumbnailCache::thumbnail(const QString &filePath) {
+  QMutexLocker locker(&m_mutex);
+  if (const QImage *image = m_images.object(filePath))
+    return *image;
+  if (m_missing.contains(filePath) || m_queued.contains(filePath))
+    return QImage();
+
+  m_queue.push_back(filePath);
+  m_queued.insert(filePath);
+  if (static_cast<int>(m_queue.size()) > kMaxQueued) {
+    m_queued.remove(m_queue.front());
+    m_queue.pop_front();
+  }
+  locker.unlock();
+
+  m_pool.start([this]() { runNext(); });
+  return QImage();
+}
+
+void ThumbnailCache::runNext() {
+  QString filePath;
+  {
+    QMutexLocker locker(&m_mutex);
+    // Dropped requests leave surplus tasks behind; they find nothing
+    if (m_queue.empty())
+      return;
+    filePath = m_queue.back();
+    m_queue.pop_back();
+  }
+
+  load(filePath);
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_queued.remove(filePath);
+  }
+  emit thumbnailReady(filePath);
+}
+
+QImage ThumbnailCache::load(const QString &filePath) {
+  QString diskPath;
+  {
+    QMutexLocker locker(&m_mutex);
+    if (const QImage *image = m_images.object(filePath))
+      return *image;
+    if (m_missing.contains(filePath))
+      return QImage();
+    if (!m_diskDirectory.isEmpty()) {
+      diskPath = diskCachePath(filePath);
+    }
+  }
+
+  QImage image;
+  if (!diskPath.isEmpty()) {
+    image = loadFromDisk(diskPath);
+  }
+  if (image.isNull()) {
+    image = extract(filePath);
+    if (!image.isNull() && !diskPath.isEmpty()) {
+      saveToDisk(diskPath, image);
+    }
+  }
+
+  QMutexLocker locker(&m_mutex);
+  if (image.isNull()) {
+    m_missing.insert(filePath);
+  } else {
+    m_images.insert(filePath, new QImage(image), image.sizeInBytes());
+  }
+  return image;
+}
+
+QImage ThumbnailCache::extract(const QString &filePath) {
+  MetadataSession session(filePath);
+  const QByteArray preview = session.embeddedPreview(kThumbnailSize);
+  if (!preview.isEmpty()) {
+    // Previews are stored unrotated; decodeScaled() orients by itself
+    const QImage image = QImage::fromData(preview);
+    if (!image.isNull())
+      return applyOrientation(scaledThumbnail(image), session.orientation());
+  }
+
+  // Never decode RAW sensor data for a thumbnail
+  if (ExifHandler::isRawFormat(filePath))
+    return QImage();
+  return decodeScaled(filePath);
+}
+
+QString ThumbnailCache::diskCachePath(const QString &filePath) const {
+  // Size and mtime in the key retire thumbnails of edited files
+  const QFileInfo info(filePath);
+  const QByteArray key = filePath.toUtf8() + '|' +
+                         QByteArray::number(info.size()) + '|' +
+                         QByteArray::number(
+                             info.lastModified().toMSecsSinceEpoch()) +
+                         '|' + QByteArray::number(kDiskCacheVersion);
+  const QByteArray hash =
+      QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+  return m_diskDirectory + '/' + QString::fromLatin1(hash) + ".jpg";
+}
+
+QImage ThumbnailCache::loadFromDisk(const QString &path) const {
+  if (!QFileInfo::exists(path))
+    return QImage();
+  return QImage(path);
+}
+
+void ThumbnailCache::saveToDisk(const QString &path,
+                                const QImage &image) const {
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+  if (!image.save(&buffer, "JPG", 85))
+    return;
+
+  QSaveFile file(path);
+  if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size()) {
+    file.commit();
+  }
+}
+
+} // namespace lyp
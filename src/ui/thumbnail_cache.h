@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <deque>
+
+namespace lyp {
+
+/**
+ * @brief Photo thumbnails for the file list and the map popups.
+ *
+ * Thumbnails come from the preview JPEG embedded in the file (exiv2
+ * PreviewManager); RAW image data is never decoded. Plain JPEG, PNG and
+ * TIFF files without a preview are decoded at reduced size instead.
+ *
+ * Finished thumbnails live in a memory LRU bounded by bytes and, if a
+ * directory is set, as small JPEGs on disk keyed by path, size and mtime.
+ * Requests are served newest first by low-priority background threads, and
+ * only the most recent few are kept, so fast scrolling does not pile up
+ * work for rows that are long gone. All functions are thread-safe.
+ */
+class ThumbnailCache : public QObject {
+  Q_OBJECT
+
+public:
+  // Longest edge of a thumbnail in pixels
+  static constexpr int kThumbnailSize = 160;
+
+  // Queued requests beyond this are dropped, oldest first
+  static constexpr int kMaxQueued = 64;
+
+  explicit ThumbnailCache(QObject *parent = nullptr);
+  ~ThumbnailCache() override;
+
+  /**
+   * @brief Cached thumbnail, or a null image after queueing it.
+   *
+   * Never blocks on I/O; thumbnailReady() is emitted once it is loaded.
+   * @param filePath Photo path
+   */
+  QImage thumbnail(const QString &filePath);
+
+  /**
+   * @brief Load a thumbnail on the calling thread, through the caches.
+   * @param filePath Photo path
+   * @return Thumbnail, or a null image if the file has none
+   */
+  QImage load(const QString &filePath);
+
+  /**
+   * @brief Keep thumbnails on disk as well (empty = memory only).
+   */
+  void setDiskCacheDirectory(const QString &directory);
+
+  /**
+   * @brief Bound the memory LRU.
+   */
+  void setMemoryBudget(qint64 bytes);
+
+  /**
+   * @brief Forget queued requests and in-memory thumbnails.
+   */
+  void clear();
+
+  /**
+   * @brief Default disk cache directory in the user cache location.
+   */
+  static QString defaultDiskCacheDirectory();
+
+signals:
+  /**
+   * @brief Emitted from a worker thread once a queued request is done,
+   *        whether or not the file had a thumbnail.
+   */
+  void thumbnailReady(const QString &filePath);
+
+private:
+  void runNext();
+  QString diskCachePath(const QString &filePath) const;
+  QImage loadFromDisk(const QString &path) const;
+  void saveToDisk(const QString &path, const QImage &image) const;
+
+  /**
+   * @brief Extract and scale the thumbnail from the photo itself.
+   */
+  static QImage extract(const QString &filePath);
+
+  mutable QMutex m_mutex;
+  QCache<QString, QImage> m_images; // Cost is bytes
+  QSet<QString> m_missing;          // Files without any thumbnail
+  std::deque<QString> m_queue;      // Newest at the back
+  QSet<QString> m_queued;           // Queued or being loaded
+  QString m_diskDirectory;
+  QThreadPool m_pool;
+};
+
+} // namespace lyp
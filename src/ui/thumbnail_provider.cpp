@@ -0,0 +1,25 @@
+#include "thumbnail_provider.h"
+#include "thumbnail_cache.h"
+#include <QUrl>
+
+namespace lyp {
+
+ThumbnailImageProvider::ThumbnailImageProvider(ThumbnailCache *cache)
+    : QQuickImageProvider(QQuickImageProvider::Image), m_cache(cache) {}
+
+QImage ThumbnailImageProvider::requestImage(const QString &id, QSize *size,
+                                            const QSize &requestedSize) {
+  QImage image = m_cache->load(QUrl::fromPercentEncoding(id.toUtf8()));
+  if (!image.isNull() && requestedSize.isValid() &&
+      (image.width() > requestedSize.width() ||
+       image.height() > requestedSize.height())) {
+    image = image.scaled(requestedSize, Qt::KeepAspectRatio,
+                         Qt::SmoothTransformation);
+  }
+  if (size) {
+    *size = image.size();
+  }
+  return image;
+}
+
+} // namespace lyp
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QQuickImageProvider>
+
+namespace lyp {
+
+class ThumbnailCache;
+
+/**
+ * @brief Serves "image://thumbnails/<percent-encoded path>" to QML.
+ *
+ * In QML the id is built with encodeURIComponent(filePath).
+ *
+ * QML calls requestImage() on its image loader thread when the Image is
+ * asynchronous, so a cache miss never blocks the map.
+ */
+class ThumbnailImageProvider : public QQuickImageProvider {
+public:
+  /**
+   * @param cache Shared thumbnail cache (not owned; must outlive the engine)
+   */
+  explicit ThumbnailImageProvider(ThumbnailCache *cache);
+
+  QImage requestImage(const QString &id, QSize *size,
+                      const QSize &requestedSize) override;
+
+private:
+  ThumbnailCache *m_cache;
+};
+
+} // namespace lyp